@@ -10,6 +10,7 @@
 #include "../src/Texture.h"
 #include "../src/Entity.h"
 #include "../src/Config.h"
+#include "../src/GLStateCache.h"
 
 using namespace std;
 
@@ -56,7 +57,7 @@ void particleGen::gpuSetup() {
 
 	//generate the VAO
    glGenVertexArrays(1, &vertArrObj);
-   glBindVertexArray(vertArrObj);
+   GLStateCache::bindVertexArray(vertArrObj);
 
    //generate vertex buffer to hand off to OGL - using instancing
    glGenBuffers(1, &vertBuffObj);
@@ -98,7 +99,7 @@ void particleGen::drawMe(std::shared_ptr<Program> prog) {
     glEnable(GL_DEPTH_TEST);
     glDepthMask(GL_FALSE);
 
-    glBindVertexArray(vertArrObj);
+    GLStateCache::bindVertexArray(vertArrObj);
 
     // COLOR BUF
     int h_col = prog->getAttribute("vertColor");
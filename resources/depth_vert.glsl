@@ -1,11 +1,77 @@
 #version 410 core
 
+#define MAX_BONES 200
+
 layout(location = 0) in vec3 vertPos;
 
 uniform mat4 LP;
 uniform mat4 LV;
+
+// Permutations (see ShaderFeature in Program.h): SKINNED, INSTANCED, BAKED
+#ifdef INSTANCED
+// Per-instance model matrix for batched static props (locations 7-10)
+layout(location = 7) in mat4 instanceM;
+#else
 uniform mat4 M;
+#endif
+
+#ifdef SKINNED
+layout(location = 3) in ivec4 boneIds;
+layout(location = 4) in vec4 weights;
+#ifdef BAKED
+// Baked clip, see AnimationBaker.h: one row per frame, 3 texels (matrix rows)
+// per bone. Each instance plays it from its own time offset.
+uniform sampler2D bakedBones;
+uniform float bakedTime; // seconds
+uniform float bakedFrameRate;
+layout(location = 11) in float instanceTimeOffset;
+
+mat4 boneMatrix(int id) {
+  int frames = textureSize(bakedBones, 0).y;
+  float frame = (bakedTime + instanceTimeOffset) * bakedFrameRate;
+  float t = fract(frame);
+  int a = int(mod(floor(frame), float(frames)));
+  int b = (a + 1) % frames; // the clip loops, the last frame blends into the first
+  int texel = clamp(id, 0, MAX_BONES - 1) * 3;
+  vec4 r0 = mix(texelFetch(bakedBones, ivec2(texel, a), 0), texelFetch(bakedBones, ivec2(texel, b), 0), t);
+  vec4 r1 = mix(texelFetch(bakedBones, ivec2(texel + 1, a), 0), texelFetch(bakedBones, ivec2(texel + 1, b), 0), t);
+  vec4 r2 = mix(texelFetch(bakedBones, ivec2(texel + 2, a), 0), texelFetch(bakedBones, ivec2(texel + 2, b), 0), t);
+  return mat4(vec4(r0.x, r1.x, r2.x, 0.0), vec4(r0.y, r1.y, r2.y, 0.0),
+              vec4(r0.z, r1.z, r2.z, 0.0), vec4(r0.w, r1.w, r2.w, 1.0));
+}
+#else
+// Frame's bone palette, see BonePalette.h: 3 texels (matrix rows) per bone,
+// this draw's bones start at boneBase
+uniform samplerBuffer bonePalette;
+uniform int boneBase;
+
+mat4 boneMatrix(int id) {
+  int texel = (boneBase + clamp(id, 0, MAX_BONES - 1)) * 3;
+  vec4 r0 = texelFetch(bonePalette, texel);
+  vec4 r1 = texelFetch(bonePalette, texel + 1);
+  vec4 r2 = texelFetch(bonePalette, texel + 2);
+  return mat4(vec4(r0.x, r1.x, r2.x, 0.0), vec4(r0.y, r1.y, r2.y, 0.0),
+              vec4(r0.z, r1.z, r2.z, 0.0), vec4(r0.w, r1.w, r2.w, 1.0));
+}
+#endif
+#endif
 
 void main() { // transform into light space
-  gl_Position = LP * LV * M * vec4(vertPos.xyz, 1.0);
-}
\ No newline at end of file
+#ifdef INSTANCED
+  mat4 model = instanceM;
+#else
+  mat4 model = M;
+#endif
+  vec4 pos = vec4(vertPos.xyz, 1.0);
+#ifdef SKINNED
+  // same palette blend as shadow_vert.glsl, so shadows follow the animation
+  mat4 skin = boneMatrix(boneIds.x) * weights.x
+            + boneMatrix(boneIds.y) * weights.y
+            + boneMatrix(boneIds.z) * weights.z
+            + boneMatrix(boneIds.w) * weights.w;
+  if (dot(weights, vec4(1.0)) >= 0.001) {
+    pos = skin * pos;
+  }
+#endif
+  gl_Position = LP * LV * model * pos;
+}
@@ -4,8 +4,20 @@ layout(location = 0) in vec3 vertPos;
 
 uniform mat4 LP;
 uniform mat4 LV;
+
+// Permutations (see ShaderFeature in Program.h): INSTANCED
+#ifdef INSTANCED
+// Per-instance model matrix for batched static props (locations 7-10)
+layout(location = 7) in mat4 instanceM;
+#else
 uniform mat4 M;
+#endif
 
 void main() {// transform into light space
-  gl_Position = LP * LV * M * vec4(vertPos.xyz, 1.0);
+#ifdef INSTANCED
+  mat4 model = instanceM;
+#else
+  mat4 model = M;
+#endif
+  gl_Position = LP * LV * model * vec4(vertPos.xyz, 1.0);
 }
\ No newline at end of file
@@ -4,9 +4,19 @@ layout(location = 0) in vec3 vertPos;
 layout(location = 1) in vec4 vertColor;
 layout(location = 2) in float vertScale;
 
-uniform mat4 P;
+// Shared per-frame data, see FrameData in UniformBlocks.h
+layout(std140) uniform FrameData {
+	mat4 P;
+	mat4 V;
+	mat4 LV;
+	vec3 lightDir;
+	float exposure;
+	vec3 lightColor;
+	float saturation;
+	vec3 cameraPos;
+};
+
 uniform mat4 M;
-uniform mat4 V;
 
 //replace with an attribute
 // uniform vec3 pColor;
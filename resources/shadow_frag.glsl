@@ -6,25 +6,35 @@
 uniform sampler2D uMaps[6]; // 0=albedo,1=spec,2=rough,3=metal,4=normal,5=emission
 uniform sampler2D shadowDepth;
 
-// PBR mat properties
-uniform vec3 MatAlbedo;
-uniform float MatRough;
-uniform float MatMetal;
-uniform vec3 MatEmit;
-
-uniform bool hasMaterial;
-
-uniform vec3 lightColor;
-uniform vec3 lightDir;
-uniform vec3 cameraPos;
+// PBR mat properties, see MaterialData in UniformBlocks.h
+layout(std140) uniform MaterialData {
+	vec3 MatAlbedo;
+	float MatRough;
+	vec3 MatEmit;
+	float MatMetal;
+};
+
+// Permutations (see ShaderFeature in Program.h): MATERIAL, TEX_ONLY
+#ifdef MATERIAL
+const bool hasMaterial = true;
+#else
+const bool hasMaterial = false;
+#endif
+
+// Shared per-frame data, see FrameData in UniformBlocks.h
+layout(std140) uniform FrameData {
+	mat4 P;
+	mat4 V;
+	mat4 LV;
+	vec3 lightDir;
+	float exposure;
+	vec3 lightColor;
+	float saturation;
+	vec3 cameraPos;
+};
 
 uniform float enemyAlpha;
 
-uniform bool texOnly;
-
-uniform float exposure;
-uniform float saturation;
-
 in pass_struct {
    vec3 fPos;
    vec3 fragNor;
@@ -136,7 +146,8 @@ void main() {
                  );
     }
 
-    if (texOnly) {
+#ifdef TEX_ONLY
+    {
         albedo = texture(uMaps[0], info_struct.vTexCoord).rgb;
         spec   = texture(uMaps[1], info_struct.vTexCoord).rgb;
         rough  = texture(uMaps[2], info_struct.vTexCoord).r;
@@ -147,6 +158,7 @@ void main() {
                  );
         emit   = texture(uMaps[5], info_struct.vTexCoord).rgb;
     }
+#endif
 
     // build base reflectivity using the specular tint map
     vec3  F0 = mix(spec, albedo, metal);
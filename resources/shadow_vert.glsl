@@ -3,24 +3,72 @@
 #define MAX_BONES 200
 #define MAX_BONE_INFLUENCE 4
 
+// Compact vertex layout, see VertexFormats.h
 layout(location = 0) in vec3 vertPos;
-layout(location = 1) in vec3 vertNor;
-layout(location = 2) in vec2 vertTex;
+layout(location = 1) in vec2 vertNorOct;  // octahedral normal, snorm16
+layout(location = 2) in vec2 vertTex;     // half floats
 layout(location = 3) in ivec4 boneIds;
-layout(location = 4) in vec4 weights;
-layout(location = 5) in vec3 vertTan;
-layout(location = 6) in vec3 vertBitan;
-
-uniform mat4 P;
-uniform mat4 V;
+layout(location = 4) in vec4 weights;     // unorm8
+layout(location = 5) in vec4 vertTanOct;  // octahedral tangent in xy, bitangent sign in z
+
+// Shared per-frame data, see FrameData in UniformBlocks.h
+layout(std140) uniform FrameData {
+	mat4 P;
+	mat4 V;
+	mat4 LV; // Light view-projection matrix
+	vec3 lightDir; // Light direction
+	float exposure;
+	vec3 lightColor;
+	float saturation;
+	vec3 cameraPos;
+};
+
+// Permutations (see ShaderFeature in Program.h): SKINNED, INSTANCED, BAKED
+#ifdef INSTANCED
+// Per-instance model matrix for batched static props (locations 7-10)
+layout(location = 7) in mat4 instanceM;
+#else
 uniform mat4 M;
-uniform mat4 LV; // Light view-projection matrix
-
-uniform vec3 lightDir; // Light direction
-
-uniform mat4 finalBonesMatrices[MAX_BONES];
-
-uniform bool hasBones;
+#endif
+
+#ifdef SKINNED
+#ifdef BAKED
+// Baked clip, see AnimationBaker.h: one row per frame, 3 texels (matrix rows)
+// per bone. Each instance plays it from its own time offset.
+uniform sampler2D bakedBones;
+uniform float bakedTime; // seconds
+uniform float bakedFrameRate;
+layout(location = 11) in float instanceTimeOffset;
+
+mat4 boneMatrix(int id) {
+	int frames = textureSize(bakedBones, 0).y;
+	float frame = (bakedTime + instanceTimeOffset) * bakedFrameRate;
+	float t = fract(frame);
+	int a = int(mod(floor(frame), float(frames)));
+	int b = (a + 1) % frames; // the clip loops, the last frame blends into the first
+	int texel = clamp(id, 0, MAX_BONES - 1) * 3;
+	vec4 r0 = mix(texelFetch(bakedBones, ivec2(texel, a), 0), texelFetch(bakedBones, ivec2(texel, b), 0), t);
+	vec4 r1 = mix(texelFetch(bakedBones, ivec2(texel + 1, a), 0), texelFetch(bakedBones, ivec2(texel + 1, b), 0), t);
+	vec4 r2 = mix(texelFetch(bakedBones, ivec2(texel + 2, a), 0), texelFetch(bakedBones, ivec2(texel + 2, b), 0), t);
+	return mat4(vec4(r0.x, r1.x, r2.x, 0.0), vec4(r0.y, r1.y, r2.y, 0.0),
+	            vec4(r0.z, r1.z, r2.z, 0.0), vec4(r0.w, r1.w, r2.w, 1.0));
+}
+#else
+// Frame's bone palette, see BonePalette.h: 3 texels (matrix rows) per bone,
+// this draw's bones start at boneBase
+uniform samplerBuffer bonePalette;
+uniform int boneBase;
+
+mat4 boneMatrix(int id) {
+	int texel = (boneBase + clamp(id, 0, MAX_BONES - 1)) * 3;
+	vec4 r0 = texelFetch(bonePalette, texel);
+	vec4 r1 = texelFetch(bonePalette, texel + 1);
+	vec4 r2 = texelFetch(bonePalette, texel + 2);
+	return mat4(vec4(r0.x, r1.x, r2.x, 0.0), vec4(r0.y, r1.y, r2.y, 0.0),
+	            vec4(r0.z, r1.z, r2.z, 0.0), vec4(r0.w, r1.w, r2.w, 1.0));
+}
+#endif
+#endif
 
 out pass_struct {
 	vec3 fPos;		// World space position
@@ -32,49 +80,62 @@ out pass_struct {
 	mat3 TBN;
 } info_struct;
 
-void main() {
-	vec4 finalPosition = vec4(0.0);
-	vec3 finalNormal = vec3(0.0);
-
-	if (hasBones == true) {
-		for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
-			if(boneIds[i] == -1) {
-				continue;
-			}
-			if(boneIds[i] >= MAX_BONES) {
-				finalPosition = vec4(vertPos, 1.0f);
-				break;
-			}
-			mat4 boneTransform = finalBonesMatrices[boneIds[i]];
-			finalPosition += boneTransform * vec4(vertPos, 1.0f) * weights[i];
-			finalNormal += mat3(boneTransform) * vertNor * weights[i];
-		}
-
-		if (length(finalPosition) < 0.001) {
-			finalPosition = vec4(vertPos, 1.0f);
-		}
+vec2 signNotZero(vec2 v) {
+	return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 octDecode(vec2 e) {
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0) {
+		v.xy = (1.0 - abs(v.yx)) * signNotZero(v.xy);
 	}
-	else {
-		finalPosition = vec4(vertPos, 1.0f);
-		finalNormal = vertNor;
+	return normalize(v);
+}
+
+void main() {
+	vec3 vertNor = octDecode(vertNorOct);
+	vec3 vertTan = octDecode(vertTanOct.xy);
+	vec3 vertBitan = cross(vertNor, vertTan) * (vertTanOct.z < 0.0 ? -1.0 : 1.0);
+
+#ifdef INSTANCED
+	mat4 model = instanceM;
+#else
+	mat4 model = M;
+#endif
+
+#ifdef SKINNED
+	// unused influences have a weight of 0, ids are clamped instead of tested
+	mat4 skin = boneMatrix(boneIds.x) * weights.x
+	          + boneMatrix(boneIds.y) * weights.y
+	          + boneMatrix(boneIds.z) * weights.z
+	          + boneMatrix(boneIds.w) * weights.w;
+	// vertices without influences stay in bind pose
+	if (dot(weights, vec4(1.0)) < 0.001) {
+		skin = mat4(1.0);
 	}
+	vec4 finalPosition = skin * vec4(vertPos, 1.0);
+	vec3 finalNormal = mat3(skin) * vertNor;
+#else
+	vec4 finalPosition = vec4(vertPos, 1.0);
+	vec3 finalNormal = vertNor;
+#endif
 
-	info_struct.fPos = (M * finalPosition).xyz; // the position in world coordinates
-	info_struct.fragNor = normalize((M * vec4(finalNormal, 0.0)).xyz); // the normal in world coordinates
-	info_struct.viewPos = (V * M * finalPosition).xyz; // the position in view coordinates
+	info_struct.fPos = (model * finalPosition).xyz; // the position in world coordinates
+	info_struct.fragNor = normalize((model * vec4(finalNormal, 0.0)).xyz); // the normal in world coordinates
+	info_struct.viewPos = (V * model * finalPosition).xyz; // the position in view coordinates
 
 	info_struct.vTexCoord = vertTex; // pass through the texture coordinates to be interpolated
 
-	info_struct.fPosLS = LV * M * finalPosition; // The vertex in light space
+	info_struct.fPosLS = LV * model * finalPosition; // The vertex in light space
 
 	info_struct.vColor = vec3(max(dot(info_struct.fragNor, normalize(lightDir)), 0)); // a color that could be blended - or be shading
 
 	mat3 TBN = mat3(
-		normalize(mat3(M) * vertTan),
-		normalize(mat3(M) * vertBitan),
-		normalize(mat3(M) * vertNor)
+		normalize(mat3(model) * vertTan),
+		normalize(mat3(model) * vertBitan),
+		normalize(mat3(model) * vertNor)
 	);
 	info_struct.TBN = TBN; // Pass to fragment shader
 
-	gl_Position = P * V * M * finalPosition; // Final vertex position
+	gl_Position = P * V * model * finalPosition; // Final vertex position
 }
@@ -0,0 +1,69 @@
+#include "AnimatedCrowd.h"
+#include "GLStateCache.h"
+
+#include <cstddef>
+
+AnimatedCrowd::~AnimatedCrowd() {
+    if (instanceVBO != 0) {
+        glDeleteBuffers(1, &instanceVBO);
+    }
+}
+
+void AnimatedCrowd::add(const glm::mat4& M, float timeOffset) {
+    instances.push_back({ M, timeOffset });
+}
+
+void AnimatedCrowd::draw(const std::shared_ptr<Program>& prog, float time, int lod) {
+    if (!prog || !model || !baked.valid() || instances.empty()) {
+        return;
+    }
+    if (!prog->supports(FEATURE_SKINNED) || !prog->supports(FEATURE_INSTANCED) || !prog->supports(FEATURE_BAKED)) {
+        return; // no permutation could animate the instances
+    }
+
+    if (instanceVBO == 0) {
+        glGenBuffers(1, &instanceVBO);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STREAM_DRAW);
+
+    unsigned previous = prog->getFeatures();
+    unsigned crowdFeatures = previous | FEATURE_SKINNED | FEATURE_INSTANCED | FEATURE_BAKED;
+    prog->bind();
+    prog->setFeatures(crowdFeatures);
+    prog->setUniform(UniformId::bakedTime, time);
+    prog->setUniform(UniformId::bakedFrameRate, baked.frameRate);
+    GLStateCache::bindTexture(AnimationBaker::TEXTURE_UNIT, baked.texture);
+
+    for (const auto& mesh : model->meshes) {
+        // static submeshes are drawn unskinned, still instanced
+        prog->setFeatures(mesh.featuresFor(crowdFeatures));
+        mesh.bindState();
+        // the instance attributes are VAO state, so point them per mesh
+        for (GLuint col = 0; col < 4; ++col) {
+            GLuint loc = INSTANCE_MATRIX_LOCATION + col;
+            glEnableVertexAttribArray(loc);
+            glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                (void*)(offsetof(Instance, M) + col * sizeof(glm::vec4)));
+            glVertexAttribDivisor(loc, 1);
+        }
+        glEnableVertexAttribArray(INSTANCE_TIME_LOCATION);
+        glVertexAttribPointer(INSTANCE_TIME_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(Instance),
+            (void*)offsetof(Instance, timeOffset));
+        glVertexAttribDivisor(INSTANCE_TIME_LOCATION, 1);
+
+        const ArenaRange& range = mesh.lodRange(lod);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, range.indexType, range.indexOffset(),
+            (GLsizei)instances.size(), range.baseVertex);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // leave the instance attributes off so plain draws fall back to M
+    for (const auto& mesh : model->meshes) {
+        GLStateCache::bindVertexArray(mesh.VAO);
+        for (GLuint loc = INSTANCE_MATRIX_LOCATION; loc <= INSTANCE_TIME_LOCATION; ++loc) {
+            glDisableVertexAttribArray(loc);
+        }
+    }
+    prog->setFeatures(previous);
+}
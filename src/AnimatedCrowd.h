@@ -0,0 +1,49 @@
+#ifndef ANIMATED_CROWD_H
+#define ANIMATED_CROWD_H
+
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "AnimationBaker.h"
+#include "AssimpModel.h"
+#include "Program.h"
+
+// Many copies of one skinned model playing a baked clip (AnimationBaker), each
+// from its own time offset. draw() is one instanced draw per mesh: the model
+// matrices go to attribute locations 7-10 as in DrawQueue, the time offsets
+// to location 11, and the BAKED permutation animates every instance on the GPU.
+// The crowd doesn't own the model or the baked texture.
+class AnimatedCrowd {
+public:
+    static constexpr GLuint INSTANCE_MATRIX_LOCATION = 7;
+    static constexpr GLuint INSTANCE_TIME_LOCATION = 11;
+
+    AnimatedCrowd(const AssimpModel* model, const BakedBoneTexture& baked) : model(model), baked(baked) {}
+    ~AnimatedCrowd();
+
+    AnimatedCrowd(const AnimatedCrowd&) = delete;
+    AnimatedCrowd& operator=(const AnimatedCrowd&) = delete;
+
+    // timeOffset in seconds, so instances don't walk in lockstep
+    void add(const glm::mat4& M, float timeOffset);
+    void clear() { instances.clear(); }
+    int size() const { return (int)instances.size(); }
+
+    // time in seconds; every other uniform must already be set on prog, which
+    // needs the SKINNED, INSTANCED and BAKED permutations
+    void draw(const std::shared_ptr<Program>& prog, float time, int lod = 0);
+
+private:
+    struct Instance {
+        glm::mat4 M;
+        float timeOffset;
+    };
+
+    const AssimpModel* model;
+    BakedBoneTexture baked;
+    std::vector<Instance> instances;
+    GLuint instanceVBO = 0;
+};
+
+#endif // ANIMATED_CROWD_H
@@ -1,12 +1,39 @@
 #include "Animation.h"
+#include "ModelCache.h"
+#include "Config.h"
+#include "AssetRegistry.h"
 // #include <assimp/Importer.hpp>
 
-Animation::Animation(const std::string& animationPath, AssimpModel* model, int animationIndex) {
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
+Animation::Animation(const std::string& animationPath, AssimpModel* model, int animationIndex)
+    : Animation(animationPath, model->GetBoneInfoMap(), model->GetBoneCounter(), animationIndex) {
+}
+
+Animation::Animation(const std::string& animationPath, std::map<std::string, BoneInfo>& boneInfoMap, int& boneCounter,
+    int animationIndex) {
+    // the model baked every animation of its file, no need to import it again
+    BakedModel baked;
+    if (Config::USE_MODEL_CACHE && ModelCache::load(animationPath, baked, false)) {
+        if (animationIndex < 0 || animationIndex >= (int)baked.animations.size()) {
+            std::cout << "Invalid animation index: " << animationIndex << std::endl;
+            return;
+        }
+        const BakedAnimation& animation = baked.animations[animationIndex];
+        std::cout << "Animation name: " << animation.name << " (cached)" << std::endl;
+        m_Duration = animation.duration;
+        m_TicksPerSecond = animation.ticksPerSecond;
+        m_GlobalInverseTransform = baked.globalInverseTransform;
+        m_RootNode = std::move(baked.rootNode);
+        ReadMissingBones(animation, boneInfoMap, boneCounter);
+        CompileSkeleton();
+        return;
+    }
+
+    // same import as the model when it was just loaded from this file
+    std::shared_ptr<ImportedScene> imported = AssetRegistry::scene(animationPath);
+    const aiScene* scene = imported->scene();
     assert(scene && scene->mRootNode);
-    auto animation = scene->mAnimations[animationIndex];
-    if (animationIndex < 0 || animationIndex >= scene->mNumAnimations) {
+    const aiAnimation* animation = imported->animation(animationIndex);
+    if (!animation) {
         std::cout << "Invalid animation index: " << animationIndex << std::endl;
         return;
     }
@@ -17,7 +44,8 @@ Animation::Animation(const std::string& animationPath, AssimpModel* model, int a
     globalTransformation = globalTransformation.Inverse();
     m_GlobalInverseTransform = AssimpGLMHelpers::ConvertMatrixToGLMFormat(globalTransformation);
     ReadHierarchyData(m_RootNode, scene->mRootNode);
-    ReadMissingBones(animation, *model);
+    ReadMissingBones(ModelCache::bakeAnimation(animation), boneInfoMap, boneCounter);
+    CompileSkeleton();
   
     if (verbose_debug) {
         std::cout << "Root transform (bind pose):\n";
@@ -52,11 +80,7 @@ Bone* Animation::FindBone(const std::string& name) {
     }
 }
 
-void Animation::ReadMissingBones(const aiAnimation* animation, AssimpModel& model) {
-    int size = animation->mNumChannels;
-
-    auto& boneInfoMap = model.GetBoneInfoMap();
-    int& boneCount = model.GetBoneCounter();
+void Animation::ReadMissingBones(const BakedAnimation& animation, std::map<std::string, BoneInfo>& boneInfoMap, int& boneCount) {
 
     //Testing For Bone Offset Matricies
     if (verbose_debug){
@@ -74,19 +98,58 @@ void Animation::ReadMissingBones(const aiAnimation* animation, AssimpModel& mode
 
 
     // reading channels
-    for (int i = 0; i < size; i++) {
-        auto channel = animation->mChannels[i];
-        std::string boneName = channel->mNodeName.data;
+    for (const auto& channel : animation.channels) {
+        const std::string& boneName = channel.name;
         if (boneInfoMap.find(boneName) == boneInfoMap.end()) {
             boneInfoMap[boneName].id = boneCount;
             boneCount++;
         }
-        m_Bones.push_back(new Bone(channel->mNodeName.data, boneInfoMap[channel->mNodeName.data].id, channel));
+        m_Bones.push_back(new Bone(boneName, boneInfoMap[boneName].id, channel.positions, channel.rotations, channel.scales));
+        if (Config::ANIMATION_RESAMPLE_HZ > 0.0f && !Config::ANIMATION_SOA_CLIPS) {
+            m_Bones.back()->Resample(ResampleStep());
+        }
     }
 
     m_BoneInfoMap = boneInfoMap;
 }
 
+float Animation::ResampleStep() const {
+    // same default rate as Animator when the file has none
+    float ticksPerSecond = m_TicksPerSecond > 0 ? (float)m_TicksPerSecond : 25.0f;
+    float hz = Config::ANIMATION_RESAMPLE_HZ > 0.0f ? Config::ANIMATION_RESAMPLE_HZ : 60.0f;
+    return ticksPerSecond / hz;
+}
+
+void Animation::CompileSkeleton() {
+    std::vector<std::string> channelNames;
+    for (const Bone* bone : m_Bones) {
+        channelNames.push_back(bone->GetBoneName());
+    }
+    m_Skeleton = Skeleton::compile(m_RootNode, m_BoneInfoMap, channelNames);
+    m_ReducedSkeleton = m_Skeleton.reduced(Config::ANIMATION_REDUCED_BONE_DEPTH);
+    if (!Config::ANIMATION_SOA_CLIPS) {
+        return;
+    }
+    m_Clip.build(m_Bones, ResampleStep(), m_Duration);
+    if (Config::ANIMATION_COMPRESSION) {
+        size_t sourceBytes = 0;
+        for (const Bone* bone : m_Bones) {
+            sourceBytes += bone->KeyBytes();
+        }
+        size_t frameBytes = m_Clip.byteSize();
+        if (m_Clip.compress(Config::ANIMATION_POSITION_TOLERANCE, Config::ANIMATION_ROTATION_TOLERANCE,
+                Config::ANIMATION_SCALE_TOLERANCE)) {
+            std::cout << "Animation clip: " << m_Clip.channelCount() << " channels, " << m_Clip.keyCount()
+                << "/" << m_Clip.frameCount() << " frames kept, " << m_Clip.byteSize() / 1024.0f << " KB (keys "
+                << sourceBytes / 1024.0f << " KB, frames " << frameBytes / 1024.0f << " KB)" << std::endl;
+        }
+    }
+    // the clip has everything the Animator samples
+    for (Bone* bone : m_Bones) {
+        bone->ReleaseKeys();
+    }
+}
+
 void Animation::ReadHierarchyData(AssimpNodeData& dest, const aiNode* src) {
     assert(src);
 
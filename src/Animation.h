@@ -9,6 +9,10 @@
 #include "Bone.h"
 #include <functional>
 #include "AssimpModel.h"
+#include "Skeleton.h"
+#include "AnimationClip.h"
+
+struct BakedAnimation;
 
 struct AssimpNodeData
 {
@@ -24,25 +28,43 @@ class Animation
         Animation() = default;
 
         Animation(const std::string& animationPath, AssimpModel* model, int animationIndex);
+        // Same without a model: channels missing from boneInfoMap are added to
+        // it, numbered from boneCounter (tools/AnimationBenchmark has no GL)
+        Animation(const std::string& animationPath, std::map<std::string, BoneInfo>& boneInfoMap, int& boneCounter,
+            int animationIndex);
         ~Animation();
         Bone* FindBone(const std::string& name);
+        // Read only, Animators playing this animation at once share it
+        const Bone* GetBone(int channel) const { return m_Bones[channel]; }
+        int GetChannelCount() const { return (int)m_Bones.size(); }
+        // Flattened hierarchy the Animator evaluates, built with the animation
+        inline const Skeleton& GetSkeleton() const { return m_Skeleton; }
+        // Same hierarchy cut to Config::ANIMATION_REDUCED_BONE_DEPTH, for far animation LODs
+        inline const Skeleton& GetReducedSkeleton() const { return m_ReducedSkeleton; }
+        // Every channel in SoA frames, empty unless Config::ANIMATION_SOA_CLIPS
+        inline const AnimationClip& GetClip() const { return m_Clip; }
         inline float GetTicksPerSecond() { return m_TicksPerSecond; }
         inline float GetDuration() { return m_Duration; }
         inline const AssimpNodeData& GetRootNode() { return m_RootNode; }
         inline const std::map<std::string, BoneInfo>& GetBoneIDMap() { return m_BoneInfoMap; }
         glm::mat4 GetGlobalInverseTransform() { return m_GlobalInverseTransform; }
-        
+
+        static void ReadHierarchyData(AssimpNodeData& dest, const aiNode* src);
 
         // void setAnimation(int animIndex, AssimpModel* model);
     private:
-        void ReadMissingBones(const aiAnimation* animation, AssimpModel& model);
-        void ReadHierarchyData(AssimpNodeData& dest, const aiNode* src);
+        void ReadMissingBones(const BakedAnimation& animation, std::map<std::string, BoneInfo>& boneInfoMap, int& boneCount);
+        void CompileSkeleton();
+        float ResampleStep() const;
         float m_Duration;
         int m_TicksPerSecond;
         std::vector<Bone*> m_Bones;
         AssimpNodeData m_RootNode;
         std::map<std::string, BoneInfo> m_BoneInfoMap;
         glm::mat4 m_GlobalInverseTransform;
+        Skeleton m_Skeleton;
+        Skeleton m_ReducedSkeleton;
+        AnimationClip m_Clip;
         const bool verbose_debug = true;
 
         // struct AnimationData
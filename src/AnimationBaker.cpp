@@ -0,0 +1,76 @@
+#include "AnimationBaker.h"
+#include "Animation.h"
+#include "Animator.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+BakedBoneTexture AnimationBaker::bake(Animation* animation, float frameRate) {
+    BakedBoneTexture baked;
+    if (!animation || frameRate <= 0.0f) {
+        return baked;
+    }
+
+    Animator animator(animation);
+    int bones = animator.GetPaletteSize();
+    float tickRate = animation->GetTicksPerSecond() > 0 ? animation->GetTicksPerSecond() : 25.0f; // as Animator::Advance
+    float seconds = animation->GetDuration() / tickRate;
+    if (bones <= 0 || seconds <= 0.0f) {
+        std::cerr << "AnimationBaker: nothing to bake" << std::endl;
+        return baked;
+    }
+
+    // the shader wraps the last frame into the first, so the loop has no seam
+    int frames = std::max(1, (int)std::lround(seconds * frameRate));
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if (bones * TEXELS_PER_BONE > maxSize || frames > maxSize) {
+        std::cerr << "AnimationBaker: " << bones << " bones x " << frames << " frames exceed the "
+            << maxSize << " texel texture limit" << std::endl;
+        return baked;
+    }
+
+    std::vector<glm::mat4> palette(bones);
+    std::vector<float> texels((size_t)frames * bones * TEXELS_PER_BONE * 4);
+    float* dst = texels.data();
+    for (int frame = 0; frame < frames; ++frame) {
+        std::fill(palette.begin(), palette.end(), glm::mat4(1.0f)); // slots without a bone stay identity
+        animator.Evaluate(palette.data());
+        for (const glm::mat4& m : palette) {
+            for (int row = 0; row < TEXELS_PER_BONE; ++row) {
+                *dst++ = m[0][row];
+                *dst++ = m[1][row];
+                *dst++ = m[2][row];
+                *dst++ = m[3][row];
+            }
+        }
+        animator.Advance(1.0f / frameRate);
+    }
+
+    glGenTextures(1, &baked.texture);
+    GLStateCache::bindTexture(TEXTURE_UNIT, baked.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, bones * TEXELS_PER_BONE, frames, 0, GL_RGBA, GL_FLOAT, texels.data());
+
+    baked.frames = frames;
+    baked.bones = bones;
+    baked.frameRate = frameRate;
+    std::cout << "Baked animation: " << bones << " bones x " << frames << " frames at " << frameRate
+        << " Hz (" << texels.size() * sizeof(float) / 1024 << " KB)" << std::endl;
+    return baked;
+}
+
+void AnimationBaker::release(BakedBoneTexture& baked) {
+    if (baked.texture != 0) {
+        GLStateCache::invalidate();
+        glDeleteTextures(1, &baked.texture);
+    }
+    baked = BakedBoneTexture();
+}
@@ -0,0 +1,36 @@
+#ifndef ANIMATION_BAKER_H
+#define ANIMATION_BAKER_H
+
+#include <glad/glad.h>
+
+#include "Config.h"
+
+class Animation;
+
+// One looping clip sampled at a fixed rate into an RGBA32F texture: a row per
+// frame, and per bone the top three rows of its palette matrix (3 texels, as
+// in BonePalette). The BAKED shader permutation reads it with texelFetch and
+// blends the two frames around its time, so instances of the clip cost no
+// Animator work and no bone uploads.
+struct BakedBoneTexture {
+    GLuint texture = 0;
+    int frames = 0;
+    int bones = 0;
+    float frameRate = 0.0f; // frames per second of playback
+
+    bool valid() const { return texture != 0; }
+};
+
+namespace AnimationBaker {
+    // Unit the crowd draw binds the baked texture to
+    constexpr int TEXTURE_UNIT = 12;
+    constexpr int TEXELS_PER_BONE = 3;
+
+    // Evaluates the whole clip on the CPU once, needs the GL context.
+    // An invalid result when the animation is empty or too big for a texture.
+    BakedBoneTexture bake(Animation* animation, float frameRate = Config::BAKED_ANIMATION_HZ);
+
+    void release(BakedBoneTexture& baked);
+}
+
+#endif // ANIMATION_BAKER_H
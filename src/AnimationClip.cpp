@@ -0,0 +1,516 @@
+#include "AnimationClip.h"
+#include "Bone.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANIMATION_CLIP_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // Runtime rotation blend, the compressor checks its error against it
+    glm::quat blendRotation(const glm::quat& a, const glm::quat& b, float f) {
+        glm::quat q = glm::dot(a, b) >= AnimationClip::NLERP_MIN_DOT ? a * (1.0f - f) + b * f : glm::slerp(a, b, f);
+        return glm::normalize(q);
+    }
+
+    // Smallest three: the largest component is dropped (and made positive so it
+    // can be rebuilt from the others), the rest fit in [-1/sqrt2, 1/sqrt2] and
+    // get 15 bits each. The 2 bit index rides in the top bits of the first two words.
+    const float SMALLEST_THREE_RANGE = 0.70710678f;
+
+    void encodeRotation(const glm::quat& q, uint16_t* out) {
+        float c[4] = { q.x, q.y, q.z, q.w };
+        int largest = 0;
+        for (int i = 1; i < 4; ++i) {
+            if (std::fabs(c[i]) > std::fabs(c[largest])) largest = i;
+        }
+        float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+        uint16_t words[3];
+        for (int i = 0, w = 0; i < 4; ++i) {
+            if (i == largest) continue;
+            float v = (c[i] * sign / SMALLEST_THREE_RANGE) * 0.5f + 0.5f;
+            words[w++] = (uint16_t)std::lround(std::min(std::max(v, 0.0f), 1.0f) * 32767.0f);
+        }
+        out[0] = (uint16_t)(((largest >> 1) << 15) | words[0]);
+        out[1] = (uint16_t)(((largest & 1) << 15) | words[1]);
+        out[2] = words[2];
+    }
+
+    glm::quat decodeRotation(const uint16_t* in) {
+        int largest = ((in[0] >> 15) << 1) | (in[1] >> 15);
+        float small[3] = {
+            ((in[0] & 0x7fff) / 32767.0f * 2.0f - 1.0f) * SMALLEST_THREE_RANGE,
+            ((in[1] & 0x7fff) / 32767.0f * 2.0f - 1.0f) * SMALLEST_THREE_RANGE,
+            ((in[2] & 0x7fff) / 32767.0f * 2.0f - 1.0f) * SMALLEST_THREE_RANGE,
+        };
+        float c[4];
+        float sum = 0.0f;
+        for (int i = 0, w = 0; i < 4; ++i) {
+            if (i == largest) continue;
+            c[i] = small[w++];
+            sum += c[i] * c[i];
+        }
+        c[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+        return glm::quat(c[3], c[0], c[1], c[2]);
+    }
+
+    uint16_t quantize(float v, float min, float step) {
+        if (step <= 0.0f) return 0;
+        return (uint16_t)std::lround(std::min(std::max((v - min) / step, 0.0f), 65535.0f));
+    }
+
+    // TRS of one channel in an SoA frame
+    struct ChannelPose {
+        glm::vec3 position, scale;
+        glm::quat rotation;
+    };
+}
+
+void AnimationClip::build(const std::vector<Bone*>& bones, float step, float duration) {
+    channels = (int)bones.size();
+    padded = padTo(channels);
+    frames = std::max(2, (int)std::ceil(duration / step) + 1);
+    invStep = 1.0f / step;
+    data.assign((size_t)frames * COMPONENTS * padded, 0.0f);
+
+    std::vector<glm::quat> previous(channels);
+    std::vector<BoneCursor> cursors(channels);
+    for (int f = 0; f < frames; ++f) {
+        float* dst = frame(f);
+        float t = f * step;
+        for (int c = 0; c < channels; ++c) {
+            glm::vec3 p, s;
+            glm::quat q;
+            bones[c]->Sample(t, cursors[c], p, q, s);
+            // keep neighbouring frames in one hemisphere, so the runtime
+            // blend never needs a sign flip
+            if (f > 0 && glm::dot(q, previous[c]) < 0.0f) {
+                q = -q;
+            }
+            previous[c] = q;
+
+            dst[PX * padded + c] = p.x;
+            dst[PY * padded + c] = p.y;
+            dst[PZ * padded + c] = p.z;
+            dst[RX * padded + c] = q.x;
+            dst[RY * padded + c] = q.y;
+            dst[RZ * padded + c] = q.z;
+            dst[RW * padded + c] = q.w;
+            dst[SX * padded + c] = s.x;
+            dst[SY * padded + c] = s.y;
+            dst[SZ * padded + c] = s.z;
+        }
+        // padding lanes are identities, harmless to evaluate
+        for (int c = channels; c < padded; ++c) {
+            dst[RW * padded + c] = 1.0f;
+            dst[SX * padded + c] = 1.0f;
+            dst[SY * padded + c] = 1.0f;
+            dst[SZ * padded + c] = 1.0f;
+        }
+    }
+}
+
+bool AnimationClip::compress(float positionTolerance, float rotationTolerance, float scaleTolerance) {
+    if (frames == 0 || compressed() || frames > 65536) {
+        return false;
+    }
+    auto pose = [&](int f, int c) {
+        const float* src = frame(f);
+        auto at = [&](Component k) { return src[k * padded + c]; };
+        ChannelPose p;
+        p.position = glm::vec3(at(PX), at(PY), at(PZ));
+        p.rotation = glm::quat(at(RW), at(RX), at(RY), at(RZ));
+        p.scale = glm::vec3(at(SX), at(SY), at(SZ));
+        return p;
+    };
+    // |dot| of two unit quaternions within rotationTolerance radians of each other
+    const float minRotationDot = std::cos(rotationTolerance * 0.5f);
+    auto within = [&](const glm::vec3& a, const glm::vec3& b, float tolerance) {
+        glm::vec3 d(a.x - b.x, a.y - b.y, a.z - b.z);
+        return d.x * d.x + d.y * d.y + d.z * d.z <= tolerance * tolerance;
+    };
+    auto withinRotation = [&](const glm::quat& a, const glm::quat& b) {
+        return std::fabs(glm::dot(a, b)) >= minRotationDot;
+    };
+
+    // tracks that stay put are stored once
+    formats.assign(channels, ChannelFormat());
+    for (int c = 0; c < channels; ++c) {
+        ChannelPose first = pose(0, c);
+        for (int f = 1; f < frames; ++f) {
+            ChannelPose p = pose(f, c);
+            if (!within(p.position, first.position, positionTolerance)) formats[c].animated |= ANIMATED_POSITION;
+            if (!withinRotation(p.rotation, first.rotation)) formats[c].animated |= ANIMATED_ROTATION;
+            if (!within(p.scale, first.scale, scaleTolerance)) formats[c].animated |= ANIMATED_SCALE;
+        }
+    }
+
+    // greedy key reduction: stretch each span while every animated track of
+    // every channel still interpolates the frames inside it
+    auto spanFits = [&](int start, int end) {
+        for (int c = 0; c < channels; ++c) {
+            int animated = formats[c].animated;
+            if (!animated) continue;
+            ChannelPose a = pose(start, c);
+            ChannelPose b = pose(end, c);
+            for (int f = start + 1; f < end; ++f) {
+                float t = (float)(f - start) / (float)(end - start);
+                ChannelPose p = pose(f, c);
+                if ((animated & ANIMATED_POSITION) && !within(glm::mix(a.position, b.position, t), p.position, positionTolerance)) return false;
+                if ((animated & ANIMATED_ROTATION) && !withinRotation(blendRotation(a.rotation, b.rotation, t), p.rotation)) return false;
+                if ((animated & ANIMATED_SCALE) && !within(glm::mix(a.scale, b.scale, t), p.scale, scaleTolerance)) return false;
+            }
+        }
+        return true;
+    };
+    std::vector<int> kept = { 0 };
+    for (int start = 0; start < frames - 1;) {
+        int end = start + 1;
+        while (end + 1 < frames && spanFits(start, end + 1)) {
+            ++end;
+        }
+        kept.push_back(end);
+        start = end;
+    }
+
+    // per channel ranges and word offsets
+    keyStride = 0;
+    for (int c = 0; c < channels; ++c) {
+        ChannelFormat& format = formats[c];
+        format.offset = keyStride;
+        auto range = [&](Component first, float* min, float* step) {
+            for (int k = 0; k < 3; ++k) {
+                float lo = frame(0)[(first + k) * padded + c];
+                float hi = lo;
+                for (int f : kept) {
+                    float v = frame(f)[(first + k) * padded + c];
+                    lo = std::min(lo, v);
+                    hi = std::max(hi, v);
+                }
+                min[k] = lo;
+                step[k] = (hi - lo) / 65535.0f;
+            }
+        };
+        if (format.animated & ANIMATED_POSITION) {
+            range(PX, format.positionMin, format.positionStep);
+            keyStride += 3;
+        }
+        if (format.animated & ANIMATED_ROTATION) keyStride += 3;
+        if (format.animated & ANIMATED_SCALE) {
+            range(SX, format.scaleMin, format.scaleStep);
+            keyStride += 3;
+        }
+    }
+
+    keyFrames.assign(kept.begin(), kept.end());
+    keyData.assign(kept.size() * keyStride, 0);
+    for (size_t k = 0; k < kept.size(); ++k) {
+        uint16_t* dst = &keyData[k * keyStride];
+        for (int c = 0; c < channels; ++c) {
+            const ChannelFormat& format = formats[c];
+            ChannelPose p = pose(kept[k], c);
+            uint16_t* words = dst + format.offset;
+            if (format.animated & ANIMATED_POSITION) {
+                for (int i = 0; i < 3; ++i) {
+                    *words++ = quantize((&p.position.x)[i], format.positionMin[i], format.positionStep[i]);
+                }
+            }
+            if (format.animated & ANIMATED_ROTATION) {
+                encodeRotation(p.rotation, words);
+                words += 3;
+            }
+            if (format.animated & ANIMATED_SCALE) {
+                for (int i = 0; i < 3; ++i) {
+                    *words++ = quantize((&p.scale.x)[i], format.scaleMin[i], format.scaleStep[i]);
+                }
+            }
+        }
+    }
+
+    // frame 0 doubles as the constant frame, animated tracks get overwritten
+    constantFrame.assign(frame(0), frame(0) + COMPONENTS * padded);
+    std::vector<float>().swap(data);
+    return true;
+}
+
+size_t AnimationClip::byteSize() const {
+    return data.size() * sizeof(float) + constantFrame.size() * sizeof(float)
+        + formats.size() * sizeof(ChannelFormat)
+        + (keyFrames.size() + keyData.size()) * sizeof(uint16_t);
+}
+
+void AnimationClip::decodeKey(int key, float* dst) const {
+    const uint16_t* src = &keyData[(size_t)key * keyStride];
+    for (int c = 0; c < channels; ++c) {
+        const ChannelFormat& format = formats[c];
+        const uint16_t* words = src + format.offset;
+        if (format.animated & ANIMATED_POSITION) {
+            for (int i = 0; i < 3; ++i) {
+                dst[(PX + i) * padded + c] = format.positionMin[i] + *words++ * format.positionStep[i];
+            }
+        }
+        if (format.animated & ANIMATED_ROTATION) {
+            glm::quat q = decodeRotation(words);
+            words += 3;
+            dst[RX * padded + c] = q.x;
+            dst[RY * padded + c] = q.y;
+            dst[RZ * padded + c] = q.z;
+            dst[RW * padded + c] = q.w;
+        }
+        if (format.animated & ANIMATED_SCALE) {
+            for (int i = 0; i < 3; ++i) {
+                dst[(SX + i) * padded + c] = format.scaleMin[i] + *words++ * format.scaleStep[i];
+            }
+        }
+    }
+}
+
+void AnimationClip::framesAround(float time, const float*& a, const float*& b, float& f) const {
+    float x = std::max(time, 0.0f) * invStep;
+    if (!compressed()) {
+        int i = std::min((int)x, frames - 2);
+        f = std::min(std::max(x - (float)i, 0.0f), 1.0f);
+        a = frame(i);
+        b = frame(i + 1);
+        return;
+    }
+
+    // kept keys around x; always at least the first and last frame
+    int last = (int)keyFrames.size() - 2;
+    int k = (int)(std::upper_bound(keyFrames.begin(), keyFrames.end(), x,
+        [](float v, uint16_t frame) { return v < (float)frame; }) - keyFrames.begin()) - 1;
+    k = std::min(std::max(k, 0), last);
+    float span = (float)(keyFrames[k + 1] - keyFrames[k]);
+    f = std::min(std::max((x - keyFrames[k]) / span, 0.0f), 1.0f);
+
+    // per thread, so animators on worker threads can share a clip
+    thread_local std::vector<float> scratch;
+    size_t frameFloats = (size_t)COMPONENTS * padded;
+    scratch.resize(frameFloats * 2);
+    float* keyA = scratch.data();
+    float* keyB = keyA + frameFloats;
+    std::memcpy(keyA, constantFrame.data(), frameFloats * sizeof(float));
+    std::memcpy(keyB, constantFrame.data(), frameFloats * sizeof(float));
+    decodeKey(k, keyA);
+    decodeKey(k + 1, keyB);
+    a = keyA;
+    b = keyB;
+}
+
+#ifdef ANIMATION_CLIP_SSE
+namespace {
+    // LANES channels of a pose, one register per component
+    struct PoseLanes {
+        __m128 p[3], q[4], s[3];
+    };
+
+    PoseLanes loadLanes(const float* pose, int padded, int first) {
+        PoseLanes l;
+        for (int i = 0; i < 3; ++i) {
+            l.p[i] = _mm_loadu_ps(pose + (AnimationClip::PX + i) * padded + first);
+            l.s[i] = _mm_loadu_ps(pose + (AnimationClip::SX + i) * padded + first);
+        }
+        for (int i = 0; i < 4; ++i) {
+            l.q[i] = _mm_loadu_ps(pose + (AnimationClip::RX + i) * padded + first);
+        }
+        return l;
+    }
+
+    void storeLanes(const PoseLanes& l, float* pose, int padded, int first) {
+        for (int i = 0; i < 3; ++i) {
+            _mm_storeu_ps(pose + (AnimationClip::PX + i) * padded + first, l.p[i]);
+            _mm_storeu_ps(pose + (AnimationClip::SX + i) * padded + first, l.s[i]);
+        }
+        for (int i = 0; i < 4; ++i) {
+            _mm_storeu_ps(pose + (AnimationClip::RX + i) * padded + first, l.q[i]);
+        }
+    }
+
+    PoseLanes blendLanes(const float* a, const float* b, float f, int padded, int first) {
+        const __m128 vf = _mm_set1_ps(f);
+        const __m128 one = _mm_set1_ps(1.0f);
+        PoseLanes la = loadLanes(a, padded, first);
+        PoseLanes lb = loadLanes(b, padded, first);
+        auto lerp = [&](__m128 va, __m128 vb) { return _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), vf)); };
+
+        PoseLanes out;
+        for (int i = 0; i < 3; ++i) {
+            out.p[i] = lerp(la.p[i], lb.p[i]);
+            out.s[i] = lerp(la.s[i], lb.s[i]);
+        }
+
+        // shortest arc: flip b on lanes in the other hemisphere. Frames of one
+        // clip already share a hemisphere, poses of different clips may not.
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(la.q[0], lb.q[0]), _mm_mul_ps(la.q[1], lb.q[1])),
+            _mm_add_ps(_mm_mul_ps(la.q[2], lb.q[2]), _mm_mul_ps(la.q[3], lb.q[3])));
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+        __m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()), signBit);
+        dot = _mm_xor_ps(dot, flip);
+        for (int i = 0; i < 4; ++i) {
+            lb.q[i] = _mm_xor_ps(lb.q[i], flip);
+        }
+
+        // normalized lerp
+        __m128 qx = lerp(la.q[0], lb.q[0]), qy = lerp(la.q[1], lb.q[1]);
+        __m128 qz = lerp(la.q[2], lb.q[2]), qw = lerp(la.q[3], lb.q[3]);
+        __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)),
+            _mm_add_ps(_mm_mul_ps(qz, qz), _mm_mul_ps(qw, qw)));
+        __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(len2));
+        out.q[0] = _mm_mul_ps(qx, inv);
+        out.q[1] = _mm_mul_ps(qy, inv);
+        out.q[2] = _mm_mul_ps(qz, inv);
+        out.q[3] = _mm_mul_ps(qw, inv);
+
+        int slerpLanes = _mm_movemask_ps(_mm_cmplt_ps(dot, _mm_set1_ps(AnimationClip::NLERP_MIN_DOT)));
+        if (slerpLanes) {
+            // rotations too far apart for nlerp, redo those lanes exactly
+            alignas(16) float qa[4][4], qb[4][4], q[4][4];
+            for (int i = 0; i < 4; ++i) {
+                _mm_store_ps(qa[i], la.q[i]);
+                _mm_store_ps(qb[i], lb.q[i]);
+                _mm_store_ps(q[i], out.q[i]);
+            }
+            for (int lane = 0; lane < AnimationClip::LANES; ++lane) {
+                if (!(slerpLanes & (1 << lane))) continue;
+                glm::quat r = glm::normalize(glm::slerp(glm::quat(qa[3][lane], qa[0][lane], qa[1][lane], qa[2][lane]),
+                    glm::quat(qb[3][lane], qb[0][lane], qb[1][lane], qb[2][lane]), f));
+                q[0][lane] = r.x;
+                q[1][lane] = r.y;
+                q[2][lane] = r.z;
+                q[3][lane] = r.w;
+            }
+            for (int i = 0; i < 4; ++i) {
+                out.q[i] = _mm_load_ps(q[i]);
+            }
+        }
+        return out;
+    }
+
+    void storeMatrices(const PoseLanes& l, glm::mat4* out) {
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 two = _mm_set1_ps(2.0f);
+        const __m128 qx = l.q[0], qy = l.q[1], qz = l.q[2], qw = l.q[3];
+        const __m128 sx = l.s[0], sy = l.s[1], sz = l.s[2];
+
+        // rotation matrix columns (as glm::mat3_cast), scaled per axis
+        __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+        __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+        __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+        __m128 c0x = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+        __m128 c0y = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+        __m128 c0z = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+        __m128 c1x = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+        __m128 c1y = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+        __m128 c1z = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+        __m128 c2x = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+        __m128 c2y = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+        __m128 c2z = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+
+        // lanes -> matrices: each transpose turns one column of 4 lanes into 4 vec4s
+        auto storeColumn = [&](int column, __m128 cx, __m128 cy, __m128 cz, __m128 cw) {
+            _MM_TRANSPOSE4_PS(cx, cy, cz, cw);
+            _mm_storeu_ps(&out[0][column][0], cx);
+            _mm_storeu_ps(&out[1][column][0], cy);
+            _mm_storeu_ps(&out[2][column][0], cz);
+            _mm_storeu_ps(&out[3][column][0], cw);
+        };
+        const __m128 zero = _mm_setzero_ps();
+        storeColumn(0, c0x, c0y, c0z, zero);
+        storeColumn(1, c1x, c1y, c1z, zero);
+        storeColumn(2, c2x, c2y, c2z, zero);
+        storeColumn(3, l.p[0], l.p[1], l.p[2], one);
+    }
+}
+#else
+namespace {
+    // Scalar stand-in for the SSE lanes
+    struct PoseLanes {
+        ChannelPose c[AnimationClip::LANES];
+    };
+
+    PoseLanes loadLanes(const float* pose, int padded, int first) {
+        PoseLanes l;
+        for (int lane = 0; lane < AnimationClip::LANES; ++lane) {
+            auto at = [&](int k) { return pose[k * padded + first + lane]; };
+            l.c[lane].position = glm::vec3(at(AnimationClip::PX), at(AnimationClip::PY), at(AnimationClip::PZ));
+            l.c[lane].rotation = glm::quat(at(AnimationClip::RW), at(AnimationClip::RX), at(AnimationClip::RY), at(AnimationClip::RZ));
+            l.c[lane].scale = glm::vec3(at(AnimationClip::SX), at(AnimationClip::SY), at(AnimationClip::SZ));
+        }
+        return l;
+    }
+
+    void storeLanes(const PoseLanes& l, float* pose, int padded, int first) {
+        for (int lane = 0; lane < AnimationClip::LANES; ++lane) {
+            const ChannelPose& c = l.c[lane];
+            float values[AnimationClip::COMPONENTS] = { c.position.x, c.position.y, c.position.z,
+                c.rotation.x, c.rotation.y, c.rotation.z, c.rotation.w, c.scale.x, c.scale.y, c.scale.z };
+            for (int k = 0; k < AnimationClip::COMPONENTS; ++k) {
+                pose[k * padded + first + lane] = values[k];
+            }
+        }
+    }
+
+    PoseLanes blendLanes(const float* a, const float* b, float f, int padded, int first) {
+        PoseLanes la = loadLanes(a, padded, first);
+        PoseLanes lb = loadLanes(b, padded, first);
+        PoseLanes out;
+        for (int lane = 0; lane < AnimationClip::LANES; ++lane) {
+            glm::quat qb = lb.c[lane].rotation;
+            if (glm::dot(la.c[lane].rotation, qb) < 0.0f) {
+                qb = -qb; // shortest arc, see the SSE version
+            }
+            out.c[lane].position = glm::mix(la.c[lane].position, lb.c[lane].position, f);
+            out.c[lane].rotation = blendRotation(la.c[lane].rotation, qb, f);
+            out.c[lane].scale = glm::mix(la.c[lane].scale, lb.c[lane].scale, f);
+        }
+        return out;
+    }
+
+    void storeMatrices(const PoseLanes& l, glm::mat4* out) {
+        for (int lane = 0; lane < AnimationClip::LANES; ++lane) {
+            out[lane] = Bone::ComposeTRS(l.c[lane].position, l.c[lane].rotation, l.c[lane].scale);
+        }
+    }
+}
+#endif
+
+void AnimationClip::sample(float time, glm::mat4* out) const {
+    if (frames == 0) {
+        return;
+    }
+    const float *a, *b;
+    float f;
+    framesAround(time, a, b, f);
+    for (int c = 0; c < padded; c += LANES) {
+        storeMatrices(blendLanes(a, b, f, padded, c), out + c);
+    }
+}
+
+void AnimationClip::samplePose(float time, float* out) const {
+    if (frames == 0) {
+        return;
+    }
+    const float *a, *b;
+    float f;
+    framesAround(time, a, b, f);
+    for (int c = 0; c < padded; c += LANES) {
+        storeLanes(blendLanes(a, b, f, padded, c), out, padded, c);
+    }
+}
+
+void AnimationClip::blendPoses(const float* a, const float* b, float f, int padded, float* out) {
+    for (int c = 0; c < padded; c += LANES) {
+        storeLanes(blendLanes(a, b, f, padded, c), out, padded, c);
+    }
+}
+
+void AnimationClip::composePose(const float* pose, int padded, glm::mat4* out) {
+    for (int c = 0; c < padded; c += LANES) {
+        storeMatrices(loadLanes(pose, padded, c), out + c);
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef ANIMATION_CLIP_H
+#define ANIMATION_CLIP_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+class Bone;
+
+// Every channel of an Animation resampled at one rate and stored as
+// structure-of-arrays frames: per frame, one float array per component
+// (position xyz, rotation xyzw, scale xyz), each holding all channels.
+// Since every channel shares the frame index and blend factor, sample()
+// interpolates LANES channels per SSE instruction: lerp for position and
+// scale, normalized lerp for rotation with a slerp fallback on lanes whose
+// keys are far apart, then TRS straight into the output matrices.
+// Builds without SSE2 take the scalar path.
+//
+// compress() turns the frames into the shipping form:
+//  - tracks that never leave the tolerance of their first value are stored
+//    once instead of per frame
+//  - frames every channel can interpolate from their neighbours within the
+//    tolerance are dropped, the kept frame indices are shared by all channels
+//  - rotations are quantized smallest-three into 48 bits, positions and
+//    scales to 16 bits per component against the channel's range in the clip
+// sample() then decodes the two keys around the time and interpolates them
+// the same way.
+//
+// samplePose() stops before the matrices and writes the local TRS in the same
+// SoA layout (a pose), so callers can blend several clips with blendPoses()
+// and pay for composePose() once.
+class AnimationClip {
+public:
+    static constexpr int LANES = 4;
+    // rotations closer than this (quaternion dot) use nlerp
+    static constexpr float NLERP_MIN_DOT = 0.95f;
+
+    // Pose layout: component k of channel c at [k * padded + c], with padded
+    // a multiple of LANES; padding channels hold the identity
+    enum Component { PX, PY, PZ, RX, RY, RZ, RW, SX, SY, SZ, COMPONENTS };
+    static int padTo(int count) { return (count + LANES - 1) / LANES * LANES; }
+
+    // Samples each bone every `step` ticks over [0, duration]
+    void build(const std::vector<Bone*>& bones, float step, float duration);
+    // Tolerances in model units (position, scale) and radians (rotation);
+    // false when the clip is too long for 16 bit frame indices
+    bool compress(float positionTolerance, float rotationTolerance, float scaleTolerance);
+
+    bool empty() const { return frames == 0; }
+    bool compressed() const { return !keyFrames.empty(); }
+    int channelCount() const { return channels; }
+    // Rounded up to LANES, the size sample() writes
+    int paddedChannelCount() const { return padded; }
+    int frameCount() const { return frames; }
+    int keyCount() const { return compressed() ? (int)keyFrames.size() : frames; }
+    size_t byteSize() const;
+
+    // Local transform of every channel at time (ticks); out must hold
+    // paddedChannelCount() matrices
+    void sample(float time, glm::mat4* out) const;
+    // Same sample as a pose, out must hold COMPONENTS * paddedChannelCount()
+    void samplePose(float time, float* out) const;
+
+    // out = a blended towards b by f (0 = a), per channel: lerp for position
+    // and scale, shortest-arc rotation blend. out may be a or b.
+    static void blendPoses(const float* a, const float* b, float f, int padded, float* out);
+    // TRS of every channel of a pose into local matrices
+    static void composePose(const float* pose, int padded, glm::mat4* out);
+
+private:
+
+    int channels = 0;
+    int padded = 0;
+    int frames = 0;
+    float invStep = 0.0f;
+    std::vector<float> data; // frames x COMPONENTS x padded, released by compress()
+
+    // compressed form
+    enum AnimatedTrack { ANIMATED_POSITION = 1, ANIMATED_ROTATION = 2, ANIMATED_SCALE = 4 };
+    struct ChannelFormat {
+        int animated = 0; // AnimatedTrack bits
+        int offset = 0; // first word of the channel in a key
+        float positionMin[3] = {};
+        float positionStep[3] = {}; // range / 65535
+        float scaleMin[3] = {};
+        float scaleStep[3] = {};
+    };
+    std::vector<ChannelFormat> formats;
+    std::vector<uint16_t> keyFrames; // kept frame indices, shared by all channels
+    std::vector<uint16_t> keyData; // keyFrames.size() x keyStride words
+    int keyStride = 0;
+    std::vector<float> constantFrame; // one frame holding the tracks stored once
+
+    float* frame(int index) { return &data[(size_t)index * COMPONENTS * padded]; }
+    const float* frame(int index) const { return &data[(size_t)index * COMPONENTS * padded]; }
+
+    // Writes key `key` over dst, a copy of constantFrame
+    void decodeKey(int key, float* dst) const;
+    // The two frames around time and the blend factor between them; compressed
+    // keys are decoded into a per-thread scratch buffer
+    void framesAround(float time, const float*& a, const float*& b, float& f) const;
+};
+
+#endif // ANIMATION_CLIP_H
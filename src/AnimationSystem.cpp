@@ -0,0 +1,284 @@
+#include "AnimationSystem.h"
+#include "AnimationClip.h"
+#include "Animator.h"
+#include "Bone.h"
+#include "Config.h"
+#include "FrameArena.h"
+#include "LodSelector.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace {
+    double millisecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Skinning matrices as an AnimationClip pose, padding lanes the identity
+    void decomposePalette(const glm::mat4* palette, int count, int padded, float* pose) {
+        for (int i = 0; i < padded; ++i) {
+            glm::vec3 position(0.0f), scale(1.0f);
+            glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+            if (i < count) {
+                Bone::DecomposeTRS(palette[i], position, rotation, scale);
+            }
+            const float values[AnimationClip::COMPONENTS] = { position.x, position.y, position.z,
+                rotation.x, rotation.y, rotation.z, rotation.w, scale.x, scale.y, scale.z };
+            for (int k = 0; k < AnimationClip::COMPONENTS; ++k) {
+                pose[k * padded + i] = values[k];
+            }
+        }
+    }
+}
+
+void AnimationSystem::add(Animator* animator) {
+    AnimationSystem& s = get();
+    auto it = std::find_if(s.slots.begin(), s.slots.end(), [&](const Slot& slot) { return slot.animator == animator; });
+    if (it == s.slots.end()) {
+        Slot slot;
+        slot.animator = animator;
+        s.slots.push_back(slot);
+    }
+}
+
+void AnimationSystem::remove(Animator* animator) {
+    AnimationSystem& s = get();
+    s.slots.erase(std::remove_if(s.slots.begin(), s.slots.end(),
+        [&](const Slot& slot) { return slot.animator == animator; }), s.slots.end());
+}
+
+void AnimationSystem::setView(const Animator* animator, bool visible, float screenRadius) {
+    for (Slot& slot : get().slots) {
+        if (slot.animator == animator) {
+            slot.hasView = true;
+            slot.visible = visible;
+            slot.screenRadius = screenRadius;
+            return;
+        }
+    }
+}
+
+void AnimationSystem::update(float dt) {
+    AnimationSystem& s = get();
+
+    // layout: each palette right after the previous one
+    int total = 0;
+    int animated = 0;
+    for (Slot& slot : s.slots) {
+        slot.offset = total;
+        slot.count = slot.animator->GetPaletteSize();
+        total += slot.count;
+        animated += slot.count > 0 ? 1 : 0;
+
+        slot.culled = false;
+        slot.interval = 1;
+        slot.reduced = false;
+        if (Config::ANIMATION_LOD && slot.hasView) {
+            // same screen size levels as the meshes, hysteresis included
+            slot.culled = !slot.visible;
+            slot.level = LodSelector::levelFor(slot.screenRadius, slot.level, 3);
+            if (slot.level >= 1) {
+                slot.interval = slot.level == 1 ? Config::ANIMATION_LOD1_INTERVAL : Config::ANIMATION_LOD2_INTERVAL;
+            }
+            slot.reduced = slot.level >= 2;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(s.doneMutex);
+        s.totals.frames++;
+        s.totals.animatorFrames += animated;
+    }
+    // only grows, so the buffer isn't reallocated while enemies come and go
+    if ((int)s.matrices.size() < total) {
+        s.matrices.resize(total);
+    }
+    s.used = total;
+
+    s.frameDt = dt;
+    s.chunkCount = ((int)s.slots.size() + Config::ANIMATION_JOB_SIZE - 1) / Config::ANIMATION_JOB_SIZE;
+    s.nextChunk = 0;
+    if (s.chunkCount <= 1) {
+        s.runChunks();
+        return;
+    }
+
+    if (!s.pool) {
+        s.pool = std::make_unique<ThreadPool>(Config::ANIMATION_THREADS);
+        std::cout << "Animation system: " << s.pool->size() << " worker threads" << std::endl;
+    }
+    // the calling thread takes one share of the chunks itself
+    int helpers = std::min((int)s.pool->size(), s.chunkCount - 1);
+    {
+        std::lock_guard<std::mutex> lock(s.doneMutex);
+        s.helpersRunning = helpers;
+    }
+    for (int i = 0; i < helpers; ++i) {
+        s.pool->submit([&s] {
+            s.runChunks();
+            std::lock_guard<std::mutex> lock(s.doneMutex);
+            if (--s.helpersRunning == 0) {
+                s.doneWake.notify_one();
+            }
+        });
+    }
+    s.runChunks();
+
+    // helpers that found no chunk left still have to check out before the
+    // next update reuses the counters
+    std::unique_lock<std::mutex> lock(s.doneMutex);
+    s.doneWake.wait(lock, [&s] { return s.helpersRunning == 0; });
+}
+
+void AnimationSystem::runChunks() {
+    Stats local;
+    int chunk;
+    while ((chunk = nextChunk++) < chunkCount) {
+        int first = chunk * Config::ANIMATION_JOB_SIZE;
+        int last = std::min(first + Config::ANIMATION_JOB_SIZE, (int)slots.size());
+        for (int i = first; i < last; ++i) {
+            if (slots[i].count > 0) {
+                updateSlot(slots[i], local);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(doneMutex);
+    totals.evaluations += local.evaluations;
+    totals.reducedEvaluations += local.reducedEvaluations;
+    totals.blends += local.blends;
+    totals.culled += local.culled;
+    totals.evaluateMs += local.evaluateMs;
+    totals.reducedMs += local.reducedMs;
+    totals.blendMs += local.blendMs;
+}
+
+void AnimationSystem::updateSlot(Slot& slot, Stats& local) {
+    Animator* animator = slot.animator;
+    glm::mat4* out = &matrices[slot.offset];
+    float dt = frameDt * animator->GetSpeed();
+    int padded = AnimationClip::padTo(slot.count);
+    if ((int)slot.evaluated.size() != slot.count) {
+        // first update, or an animation with another skeleton
+        slot.evaluated.assign(slot.count, glm::mat4(1.0f));
+        slot.from.assign((size_t)AnimationClip::COMPONENTS * padded, 0.0f);
+        slot.to = slot.from;
+        slot.toCurrent = false;
+        slot.snap = true;
+    }
+
+    if (slot.culled) {
+        // the clock keeps running so the character is in step when it shows up again
+        animator->Advance(std::max(dt - slot.lead, 0.0f));
+        slot.lead = std::max(slot.lead - dt, 0.0f);
+        slot.snap = true;
+        std::copy(slot.evaluated.begin(), slot.evaluated.end(), out);
+        local.culled++;
+        return;
+    }
+
+    // a blend in flight finishes at the interval it was evaluated for
+    if (slot.snap || ++slot.sinceEvaluation >= slot.blendInterval) {
+        bool blending = slot.interval > 1 && !slot.snap;
+        if (slot.snap) {
+            // show the pose at the clock's time; the next frame evaluates ahead
+            // and blends from it
+            animator->Advance(std::max(dt - slot.lead, 0.0f));
+            slot.lead = std::max(slot.lead - dt, 0.0f);
+            slot.sinceEvaluation = slot.interval - 1;
+            slot.snap = false;
+        }
+        else {
+            // evaluate the pose due at the next evaluation, the frames until then blend towards it
+            float ahead = dt * (slot.interval - 1);
+            animator->Advance(std::max(dt + ahead - slot.lead, 0.0f));
+            slot.lead = ahead;
+            slot.sinceEvaluation = 0;
+        }
+        slot.blendInterval = slot.interval;
+        if (blending) {
+            if (!slot.toCurrent) {
+                // the last pose was evaluated at full rate, so was never decomposed
+                decomposePalette(slot.evaluated.data(), slot.count, padded, slot.to.data());
+            }
+            std::swap(slot.from, slot.to);
+        }
+        // slots with no node in the skeleton stay identity
+        std::fill(slot.evaluated.begin(), slot.evaluated.end(), glm::mat4(1.0f));
+
+        animator->SetReducedSkeleton(slot.reduced);
+        auto start = std::chrono::steady_clock::now();
+        animator->Evaluate(slot.evaluated.data());
+        if (slot.reduced) {
+            local.reducedEvaluations++;
+            local.reducedMs += millisecondsSince(start);
+        }
+        else {
+            local.evaluations++;
+            local.evaluateMs += millisecondsSince(start);
+        }
+
+        slot.toCurrent = slot.interval > 1;
+        if (slot.toCurrent) {
+            start = std::chrono::steady_clock::now();
+            decomposePalette(slot.evaluated.data(), slot.count, padded, slot.to.data());
+            local.blendMs += millisecondsSince(start);
+        }
+    }
+    else {
+        slot.lead = std::max(slot.lead - dt, 0.0f);
+    }
+
+    float alpha = (float)(slot.sinceEvaluation + 1) / (float)slot.blendInterval;
+    if (alpha >= 1.0f) {
+        std::copy(slot.evaluated.begin(), slot.evaluated.end(), out);
+        return;
+    }
+    // a matrix lerp would shrink and shear turning bones, blend the TRS instead
+    auto start = std::chrono::steady_clock::now();
+    FrameArena& arena = FrameArena::local();
+    FrameArena::Scope scope(arena);
+    float* pose = arena.alloc<float>((size_t)AnimationClip::COMPONENTS * padded);
+    glm::mat4* blended = arena.alloc<glm::mat4>(padded);
+    AnimationClip::blendPoses(slot.from.data(), slot.to.data(), alpha, padded, pose);
+    AnimationClip::composePose(pose, padded, blended);
+    std::copy(blended, blended + slot.count, out);
+    local.blends++;
+    local.blendMs += millisecondsSince(start);
+}
+
+AnimationSystem::Palette AnimationSystem::palette(const Animator* animator) {
+    AnimationSystem& s = get();
+    Palette p;
+    for (const Slot& slot : s.slots) {
+        if (slot.animator == animator) {
+            if (slot.count > 0 && slot.offset + slot.count <= (int)s.matrices.size()) {
+                p.matrices = &s.matrices[slot.offset];
+                p.count = slot.count;
+                p.offset = slot.offset;
+            }
+            break;
+        }
+    }
+    return p;
+}
+
+double AnimationSystem::Stats::savedMs() const {
+    if (evaluations == 0) {
+        return 0.0;
+    }
+    double fullRate = animatorFrames * (evaluateMs / evaluations);
+    return fullRate - (evaluateMs + reducedMs + blendMs);
+}
+
+AnimationSystem::Stats AnimationSystem::stats() {
+    AnimationSystem& s = get();
+    std::lock_guard<std::mutex> lock(s.doneMutex);
+    return s.totals;
+}
+
+void AnimationSystem::resetStats() {
+    AnimationSystem& s = get();
+    std::lock_guard<std::mutex> lock(s.doneMutex);
+    s.totals = Stats();
+}
@@ -0,0 +1,129 @@
+#ifndef ANIMATION_SYSTEM_H
+#define ANIMATION_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "ThreadPool.h"
+
+class Animator;
+
+// Once-a-frame update of every registered Animator:
+//  - update() lays the palettes of all animators with an animation out back
+//    to back in one buffer, then evaluates the poses in chunks of
+//    Config::ANIMATION_JOB_SIZE animators, on a ThreadPool and on the calling
+//    thread at once, and returns when every chunk is done
+//  - renderers read an animator's matrices straight out of that buffer with
+//    palette(), valid until the next update()
+// Animators only share read-only data (Animation, Skeleton, AnimationClip and
+// the Bones, whose key cursors each Animator keeps itself) and their scratch
+// comes from the thread's FrameArena, so the chunks need no locking.
+//
+// Animation LOD (Config::ANIMATION_LOD), from what setView() last reported:
+//  - culled animators keep their clock running but aren't evaluated, the
+//    palette holds their last pose
+//  - LodSelector level 1 evaluates every ANIMATION_LOD1_INTERVAL frames,
+//    level 2 and up every ANIMATION_LOD2_INTERVAL frames with the reduced
+//    skeleton; each evaluation is for the time the next one is due and the
+//    frames in between blend towards it in TRS space (AnimationClip poses),
+//    so the motion stays smooth and bones keep their shape. The first
+//    evaluation after a cull or a skeleton change is for the current time.
+// Animators never given a view run at full rate.
+class AnimationSystem {
+public:
+    struct Palette {
+        const glm::mat4* matrices = nullptr;
+        int count = 0;
+        int offset = 0; // of matrices in buffer()
+    };
+
+    // Counters since the last resetStats()
+    struct Stats {
+        int frames = 0;
+        long long animatorFrames = 0; // animators with an animation, summed over frames
+        long long evaluations = 0;    // full skeleton
+        long long reducedEvaluations = 0;
+        long long blends = 0;         // frames shown interpolated
+        long long culled = 0;         // frames not evaluated at all
+        double evaluateMs = 0.0;      // full skeleton evaluations
+        double reducedMs = 0.0;
+        double blendMs = 0.0;
+        // animatorFrames full evaluations at the measured average, minus the
+        // time actually spent; 0 until a full evaluation was timed
+        double savedMs() const;
+    };
+
+    static void add(Animator* animator);
+    static void remove(Animator* animator);
+
+    // Culling result for an animator's character, used from the next update():
+    // visible = passed the frustum test, screenRadius = LodSelector::screenRadius
+    static void setView(const Animator* animator, bool visible, float screenRadius);
+
+    // Advances every animator by dt seconds (times its speed) and writes the palettes
+    static void update(float dt);
+
+    // Empty until the animator's first update()
+    static Palette palette(const Animator* animator);
+    // Every palette of the frame, in registration order; only the first
+    // matrixCount() are this frame's
+    static const std::vector<glm::mat4>& buffer() { return get().matrices; }
+    static int matrixCount() { return get().used; }
+
+    static Stats stats();
+    static void resetStats();
+
+private:
+    static AnimationSystem& get() {
+        static AnimationSystem* s = new AnimationSystem();
+        return *s;
+    }
+
+    struct Slot {
+        Animator* animator = nullptr;
+        int offset = 0; // into matrices
+        int count = 0;  // 0 when it had no animation at the last update
+
+        // LOD input
+        bool hasView = false;
+        bool visible = true;
+        float screenRadius = 0.0f;
+
+        // LOD state
+        int level = -1;    // LodSelector level, -1 before the first view
+        int interval = 1;  // frames between evaluations
+        int blendInterval = 1; // interval the last evaluation was for
+        bool reduced = false;
+        bool culled = false;
+        int sinceEvaluation = 0;
+        float lead = 0.0f; // seconds the animator's clock is ahead of the shown pose
+        bool snap = true;  // next evaluation starts a new blend instead of continuing one
+        std::vector<glm::mat4> evaluated; // last evaluated palette
+        std::vector<float> from, to; // blend endpoints as AnimationClip poses
+        bool toCurrent = false; // to holds evaluated, not kept at full rate
+    };
+
+    // Evaluates chunks until none are left, on any thread
+    void runChunks();
+    void updateSlot(Slot& slot, Stats& local);
+
+    std::vector<Slot> slots;
+    std::vector<glm::mat4> matrices;
+    int used = 0;
+    std::unique_ptr<ThreadPool> pool; // created by the first update with more than one chunk
+
+    // current update
+    float frameDt = 0.0f;
+    int chunkCount = 0;
+    std::atomic<int> nextChunk{ 0 };
+    std::mutex doneMutex; // also guards totals
+    std::condition_variable doneWake;
+    int helpersRunning = 0;
+    Stats totals;
+};
+
+#endif // ANIMATION_SYSTEM_H
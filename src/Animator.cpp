@@ -1,66 +1,329 @@
 #include "Animator.h"
+#include "FrameArena.h"
+#include <algorithm>
 #include <iostream>
 
 Animator::Animator(Animation* animation)
 {
     m_CurrentTime = 0.0;
     m_CurrentAnimation = animation;
+    // sized to the skeleton by UpdateAnimation; AnimationSystem's animators never use it
+}
 
-    m_FinalBoneMatrices.reserve(100);
-
-    for (int i = 0; i < 100; i++)
+void Animator::UpdateAnimation(float dt)
+{
+    const Skeleton& skeleton = m_CurrentAnimation->GetSkeleton();
+    if ((int)m_FinalBoneMatrices.size() < skeleton.boneSlotCount)
     {
-        m_FinalBoneMatrices.push_back(glm::mat4(1.0f));
+        m_FinalBoneMatrices.resize(skeleton.boneSlotCount, glm::mat4(1.0f));
     }
+    UpdateAnimation(dt, m_FinalBoneMatrices.data());
 }
 
-void Animator::UpdateAnimation(float dt)
+void Animator::UpdateAnimation(float dt, glm::mat4* palette)
 {
-    float tickRate = m_CurrentAnimation->GetTicksPerSecond();
+    Advance(dt);
+    Evaluate(palette);
+}
+
+void Animator::AdvanceTime(Animation* animation, float& time, float dt)
+{
+    float tickRate = animation->GetTicksPerSecond();
     if (tickRate <= 0) {
         tickRate = 25.0f; // Default value if not specified
     }
-    m_CurrentTime += dt * tickRate; // Update current time based on delta time and ticks per second
-    m_CurrentTime = fmod(m_CurrentTime, m_CurrentAnimation->GetDuration()); // Loop the animation
+    time += dt * tickRate; // Update current time based on delta time and ticks per second
+    time = fmod(time, animation->GetDuration()); // Loop the animation
+}
+
+void Animator::Advance(float dt)
+{
+    AdvanceTime(m_CurrentAnimation, m_CurrentTime, dt);
+    if (m_Layers.empty())
+    {
+        return;
+    }
+
+    m_Fade = std::min(m_Fade + m_FadeRate * dt, 1.0f);
+    for (Layer& layer : m_Layers)
+    {
+        AdvanceTime(layer.animation, layer.time, dt);
+        layer.fade = std::min(layer.fade + layer.fadeRate * dt, 1.0f);
+    }
+
+    // anything under a fully faded-in clip can't be seen any more
+    if (m_Fade >= 1.0f)
+    {
+        m_Layers.clear();
+        return;
+    }
+    for (size_t i = m_Layers.size() - 1; i > 0; --i)
+    {
+        if (m_Layers[i].fade >= 1.0f)
+        {
+            m_Layers.erase(m_Layers.begin(), m_Layers.begin() + i);
+            break;
+        }
+    }
+}
 
+void Animator::Evaluate(glm::mat4* palette)
+{
     glm::mat4 flipY = glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0, 1, 0));
-    CalculateBoneTransform(&m_CurrentAnimation->GetRootNode(), flipY * m_CurrentAnimation->GetGlobalInverseTransform());
-    //CalculateBoneTransform(&m_CurrentAnimation->GetRootNode(), m_CurrentAnimation->GetGlobalInverseTransform());
-    
+    glm::mat4 rootTransform = flipY * m_CurrentAnimation->GetGlobalInverseTransform();
+    //glm::mat4 rootTransform = m_CurrentAnimation->GetGlobalInverseTransform();
+    if (m_Layers.empty())
+    {
+        EvaluatePose(rootTransform, palette);
+    }
+    else
+    {
+        EvaluateBlend(rootTransform, palette);
+    }
 }
 
 void Animator::PlayAnimation(Animation* pAnimation) {
     m_CurrentAnimation = pAnimation;
     m_CurrentTime = 0.0;
+    m_Cursors.clear();
+    m_Layers.clear();
+    m_Fade = 1.0f;
 }
 
-void Animator::CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform)
+void Animator::CrossFade(Animation* animation, float seconds)
 {
-    std::string nodeName = node->name;
-    glm::mat4 nodeTransform = node->transformation;
+    if (!animation || animation == m_CurrentAnimation)
+    {
+        return;
+    }
+    if (seconds <= 0.0f || !m_CurrentAnimation)
+    {
+        PlayAnimation(animation);
+        return;
+    }
 
-    Bone* Bone = m_CurrentAnimation->FindBone(nodeName);
+    // fading back to a clip that is still showing picks it up where it is:
+    // it leaves its layer for the top, starting from the weight it had in the mix
+    float time = 0.0f;
+    float fade = 0.0f;
+    std::vector<BoneCursor> cursors;
+    for (size_t i = 0; i < m_Layers.size(); ++i)
+    {
+        if (m_Layers[i].animation == animation)
+        {
+            fade = i == 0 ? 1.0f : m_Layers[i].fade; // the bottom layer shows fully under the rest
+            for (size_t j = i + 1; j < m_Layers.size(); ++j)
+            {
+                fade *= 1.0f - m_Layers[j].fade;
+            }
+            fade *= 1.0f - m_Fade;
+            time = m_Layers[i].time;
+            cursors = std::move(m_Layers[i].cursors);
+            m_Layers.erase(m_Layers.begin() + i);
+            break;
+        }
+    }
 
-    if (Bone)
+    m_Layers.push_back({ m_CurrentAnimation, m_CurrentTime, m_Fade, m_FadeRate, std::move(m_Cursors) });
+    if ((int)m_Layers.size() > MAX_BLEND_LAYERS)
     {
-        Bone->Update(m_CurrentTime);
-        nodeTransform = Bone->GetLocalTransform();
+        m_Layers.erase(m_Layers.begin());
     }
+    m_CurrentAnimation = animation;
+    m_CurrentTime = time;
+    m_Cursors = std::move(cursors);
+    m_Fade = fade;
+    m_FadeRate = 1.0f / seconds;
+}
 
-    glm::mat4 globalTransformation = parentTransform * nodeTransform ;
+void Animator::EvaluatePose(const glm::mat4& rootTransform)
+{
+    const Skeleton& skeleton = m_CurrentAnimation->GetSkeleton();
+    if ((int)m_FinalBoneMatrices.size() < skeleton.boneSlotCount)
+    {
+        m_FinalBoneMatrices.resize(skeleton.boneSlotCount, glm::mat4(1.0f));
+    }
+    EvaluatePose(rootTransform, m_FinalBoneMatrices.data());
+}
 
-    auto boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
-    if (boneInfoMap.find(nodeName) != boneInfoMap.end())
+void Animator::EvaluatePose(const glm::mat4& rootTransform, glm::mat4* palette)
+{
+    const Skeleton& skeleton = m_UseReducedSkeleton ? m_CurrentAnimation->GetReducedSkeleton() : m_CurrentAnimation->GetSkeleton();
+    // only grows the first time a bigger skeleton is seen
+    if (m_GlobalTransforms.size() < skeleton.size())
     {
-        int index = boneInfoMap[nodeName].id;
-        glm::mat4 offset = boneInfoMap[nodeName].offset;
-        m_FinalBoneMatrices[index] = globalTransformation * offset;
-        // m_FinalBoneMatrices[index] = offset * globalTransformation; // for fbx
+        m_GlobalTransforms.resize(skeleton.size());
     }
 
-    for (int i = 0; i < node->childrenCount; i++)
+    // all channels at once when the animation has an SoA clip
+    const AnimationClip& clip = m_CurrentAnimation->GetClip();
+    bool fromClip = !clip.empty();
+    if (fromClip)
+    {
+        if ((int)m_Locals.size() < clip.paddedChannelCount())
+        {
+            m_Locals.resize(clip.paddedChannelCount());
+        }
+        clip.sample(m_CurrentTime, m_Locals.data());
+    }
+    else if ((int)m_Cursors.size() < m_CurrentAnimation->GetChannelCount())
     {
-        CalculateBoneTransform(&node->children[i], globalTransformation);
+        m_Cursors.resize(m_CurrentAnimation->GetChannelCount());
     }
 
-}
\ No newline at end of file
+    // parents come first, so their global transform is always ready
+    for (size_t i = 0; i < skeleton.size(); ++i)
+    {
+        glm::mat4 nodeTransform;
+        int channel = skeleton.channels[i];
+        if (channel >= 0 && fromClip)
+        {
+            nodeTransform = m_Locals[channel];
+        }
+        else if (channel >= 0)
+        {
+            nodeTransform = m_CurrentAnimation->GetBone(channel)->GetLocalTransform(m_CurrentTime, m_Cursors[channel]);
+        }
+        else
+        {
+            nodeTransform = skeleton.bindLocal[i];
+        }
+
+        int parent = skeleton.parents[i];
+        m_GlobalTransforms[i] = (parent < 0 ? rootTransform : m_GlobalTransforms[parent]) * nodeTransform;
+
+        int slot = skeleton.boneSlots[i];
+        if (slot >= 0)
+        {
+            palette[slot] = m_GlobalTransforms[i] * skeleton.offsets[i];
+            // m_FinalBoneMatrices[slot] = offset * globalTransformation; // for fbx
+        }
+    }
+
+    // bones a reduced skeleton dropped move with their kept ancestor
+    for (size_t i = 0; i < skeleton.copySlots.size(); ++i)
+    {
+        palette[skeleton.copySlots[i]] = palette[skeleton.copyFrom[i]];
+    }
+}
+
+const Skeleton& Animator::SkeletonOf(Animation* animation) const
+{
+    return m_UseReducedSkeleton ? animation->GetReducedSkeleton() : animation->GetSkeleton();
+}
+
+bool Animator::SamplePose(Animation* animation, float time, std::vector<BoneCursor>& cursors, const Skeleton& rig,
+    int padded, float* pose) const
+{
+    const Skeleton& skeleton = SkeletonOf(animation);
+    if (!skeleton.sameRig(rig))
+    {
+        return false;
+    }
+    size_t nodes = skeleton.size();
+
+    // whole clip at once when there is one, scattered from channels to nodes
+    const AnimationClip& clip = animation->GetClip();
+    const float* channels = nullptr;
+    int channelPadded = clip.paddedChannelCount();
+    if (!clip.empty())
+    {
+        float* sampled = FrameArena::local().alloc<float>((size_t)AnimationClip::COMPONENTS * channelPadded);
+        clip.samplePose(time, sampled);
+        channels = sampled;
+    }
+    else if ((int)cursors.size() < animation->GetChannelCount())
+    {
+        cursors.resize(animation->GetChannelCount());
+    }
+
+    for (int i = 0; i < padded; ++i)
+    {
+        int channel = i < (int)nodes ? skeleton.channels[i] : -1;
+        if (channel >= 0 && channels)
+        {
+            for (int k = 0; k < AnimationClip::COMPONENTS; ++k)
+            {
+                pose[k * padded + i] = channels[k * channelPadded + channel];
+            }
+            continue;
+        }
+
+        glm::vec3 position(0.0f), scale(1.0f);
+        glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f); // padding stays the identity
+        if (channel >= 0)
+        {
+            animation->GetBone(channel)->Sample(time, cursors[channel], position, rotation, scale);
+        }
+        else if (i < (int)nodes)
+        {
+            position = skeleton.bindPositions[i];
+            rotation = skeleton.bindRotations[i];
+            scale = skeleton.bindScales[i];
+        }
+        const float values[AnimationClip::COMPONENTS] = { position.x, position.y, position.z,
+            rotation.x, rotation.y, rotation.z, rotation.w, scale.x, scale.y, scale.z };
+        for (int k = 0; k < AnimationClip::COMPONENTS; ++k)
+        {
+            pose[k * padded + i] = values[k];
+        }
+    }
+    return true;
+}
+
+void Animator::EvaluateBlend(const glm::mat4& rootTransform, glm::mat4* palette)
+{
+    const Skeleton& skeleton = SkeletonOf(m_CurrentAnimation);
+    size_t nodes = skeleton.size();
+    int padded = AnimationClip::padTo((int)nodes);
+    size_t poseFloats = (size_t)AnimationClip::COMPONENTS * padded;
+
+    // all scratch goes back to the thread's arena when this returns
+    FrameArena& arena = FrameArena::local();
+    FrameArena::Scope scope(arena);
+    float* pose = arena.alloc<float>(poseFloats);
+    float* layerPose = arena.alloc<float>(poseFloats);
+
+    // bottom layer as is, every clip above blended over the mix by its fade
+    bool empty = true;
+    auto addLayer = [&](Animation* animation, float time, std::vector<BoneCursor>& cursors, float fade)
+    {
+        if (!SamplePose(animation, time, cursors, skeleton, padded, empty ? pose : layerPose))
+        {
+            return; // a different rig can't be blended, leave it out
+        }
+        if (!empty)
+        {
+            AnimationClip::blendPoses(pose, layerPose, fade, padded, pose);
+        }
+        empty = false;
+    };
+    for (Layer& layer : m_Layers)
+    {
+        addLayer(layer.animation, layer.time, layer.cursors, layer.fade);
+    }
+    addLayer(m_CurrentAnimation, m_CurrentTime, m_Cursors, m_Fade);
+
+    glm::mat4* locals = arena.alloc<glm::mat4>(padded);
+    AnimationClip::composePose(pose, padded, locals);
+
+    // parents come first, as in EvaluatePose
+    if (m_GlobalTransforms.size() < nodes)
+    {
+        m_GlobalTransforms.resize(nodes);
+    }
+    for (size_t i = 0; i < nodes; ++i)
+    {
+        int parent = skeleton.parents[i];
+        m_GlobalTransforms[i] = (parent < 0 ? rootTransform : m_GlobalTransforms[parent]) * locals[i];
+        int slot = skeleton.boneSlots[i];
+        if (slot >= 0)
+        {
+            palette[slot] = m_GlobalTransforms[i] * skeleton.offsets[i];
+        }
+    }
+    for (size_t i = 0; i < skeleton.copySlots.size(); ++i)
+    {
+        palette[skeleton.copySlots[i]] = palette[skeleton.copyFrom[i]];
+    }
+}
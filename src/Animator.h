@@ -14,16 +14,68 @@ class Animator
     public:
         Animator(Animation* animation);
         void UpdateAnimation(float dt);
+        // Same, writing GetPaletteSize() matrices to palette instead of
+        // GetFinalBoneMatrices() (AnimationSystem)
+        void UpdateAnimation(float dt, glm::mat4* palette);
+        // The two halves of UpdateAnimation, for callers that don't evaluate
+        // every frame (AnimationSystem's LODs)
+        void Advance(float dt);
+        void Evaluate(glm::mat4* palette);
         void PlayAnimation(Animation* panimation);
-        void CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform);
+        // Blends from what is playing now to animation over `seconds` of
+        // playback instead of cutting. The outgoing clip keeps playing under
+        // it; fading again mid-fade blends over the current mix, up to
+        // MAX_BLEND_LAYERS clips deep. A clip still showing under the mix is
+        // moved to the top rather than played twice. Only clips on the same
+        // rig (Skeleton::sameRig) blend, others are left out of the mix.
+        void CrossFade(Animation* animation, float seconds);
+        bool IsBlending() const { return !m_Layers.empty(); }
+        // One forward pass over the current animation's Skeleton
+        void EvaluatePose(const glm::mat4& rootTransform);
+        void EvaluatePose(const glm::mat4& rootTransform, glm::mat4* palette);
+        // Bone matrices the current animation writes, 0 without one
+        int GetPaletteSize() const { return m_CurrentAnimation ? m_CurrentAnimation->GetSkeleton().boneSlotCount : 0; }
+        // Playback rate AnimationSystem applies to its dt
+        void SetSpeed(float speed) { m_Speed = speed; }
+        float GetSpeed() const { return m_Speed; }
+        // Evaluate with the animation's reduced skeleton (far LOD)
+        void SetReducedSkeleton(bool reduced) { m_UseReducedSkeleton = reduced; }
         void SetCurrentAnimation(Animation* animation) { m_CurrentAnimation = animation; }
         Animation* GetCurrentAnimation() { return m_CurrentAnimation; }
-        std::vector<glm::mat4> GetFinalBoneMatrices() { return m_FinalBoneMatrices; }
+        const std::vector<glm::mat4>& GetFinalBoneMatrices() const { return m_FinalBoneMatrices; }
+        static constexpr int MAX_BLEND_LAYERS = 4;
     private:
+        // An earlier clip still showing through a crossfade
+        struct Layer
+        {
+            Animation* animation;
+            float time;
+            float fade; // weight over the layers below, 0..1
+            float fadeRate; // per second of playback
+            std::vector<BoneCursor> cursors;
+        };
+        static void AdvanceTime(Animation* animation, float& time, float dt);
+        const Skeleton& SkeletonOf(Animation* animation) const;
+        // Local TRS of every node of animation's skeleton as an AnimationClip
+        // pose; false when its rig isn't rig (Skeleton::sameRig)
+        bool SamplePose(Animation* animation, float time, std::vector<BoneCursor>& cursors, const Skeleton& rig,
+            int padded, float* pose) const;
+        // EvaluatePose for a crossfade: every layer's pose blended in SoA
+        // form, then one compose and one hierarchy pass
+        void EvaluateBlend(const glm::mat4& rootTransform, glm::mat4* palette);
+
         std::vector<glm::mat4> m_FinalBoneMatrices;
+        std::vector<glm::mat4> m_GlobalTransforms; // per skeleton node, reused every frame
+        std::vector<glm::mat4> m_Locals; // per channel, from the clip
+        std::vector<BoneCursor> m_Cursors; // per channel, for animations without a clip
         Animation* m_CurrentAnimation;
         float m_CurrentTime;
         float m_DeltaTime;
+        float m_Speed = 1.0f;
+        std::vector<Layer> m_Layers; // bottom first, the current animation blends over the top
+        float m_Fade = 1.0f; // current animation's weight over m_Layers
+        float m_FadeRate = 0.0f;
+        bool m_UseReducedSkeleton = false;
 };
 
 #endif // ANIMATOR_H
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "AssetLoader.h"
+#include "AssetRegistry.h"
+
+#include <chrono>
+#include <iostream>
+#include "stb_image.h"
+
+AssetLoader::AssetLoader(unsigned int threads) : pool(threads) {
+    // the flip flag is global state in this stb_image version, set it once
+    // here instead of from the decoding threads
+    stbi_set_flip_vertically_on_load(true);
+    std::cout << "Asset loader: " << pool.size() << " worker threads" << std::endl;
+}
+
+void AssetLoader::requestModel(const std::string& path, TextureAssignments textures, std::function<void(AssimpModel*)> onLoaded) {
+    requested++;
+
+    std::string key = AssetRegistry::canonicalPath(path);
+    auto earlier = modelsRequested.find(key);
+    bool duplicate = earlier != modelsRequested.end();
+    std::shared_future<void> firstQueued = duplicate ? earlier->second : std::shared_future<void>();
+    auto queued = std::make_shared<std::promise<void>>();
+    if (!duplicate) {
+        modelsRequested[key] = queued->get_future().share();
+    }
+
+    pool.submit([this, path, textures, onLoaded, duplicate, firstQueued, queued] {
+        auto payload = std::make_shared<ModelPayload>();
+        if (!duplicate) {
+            AssimpModel::importModel(path, *payload);
+        }
+
+        auto images = std::make_shared<std::vector<DecodedImage>>(textures.size());
+        for (size_t i = 0; i < textures.size(); ++i) {
+            AssimpDecodeImage(textures[i].second.c_str(), "", (*images)[i]);
+        }
+
+        if (duplicate) {
+            // the first request's upload is queued ahead of ours, so by the time
+            // this one runs the registry has the model to share
+            firstQueued.wait();
+        }
+
+        finish([path, textures, onLoaded, duplicate, payload, images] {
+            AssimpModel* model = duplicate ? new AssimpModel(path) : new AssimpModel(path, *payload);
+            for (size_t i = 0; i < textures.size(); ++i) {
+                model->assignTexture(textures[i].first, textures[i].second, (*images)[i]);
+            }
+            if (onLoaded) {
+                onLoaded(model);
+            }
+        });
+
+        if (!duplicate) {
+            queued->set_value();
+        }
+    });
+}
+
+void AssetLoader::requestModel(const std::string& path, AssimpModel*& target, TextureAssignments textures) {
+    requestModel(path, std::move(textures), [&target](AssimpModel* model) { target = model; });
+}
+
+void AssetLoader::requestTexture(std::shared_ptr<Texture> texture, std::function<void()> onLoaded) {
+    requested++;
+    pool.submit([this, texture, onLoaded] {
+        texture->decode();
+        finish([texture, onLoaded] {
+            texture->upload();
+            if (onLoaded) {
+                onLoaded();
+            }
+        });
+    });
+}
+
+void AssetLoader::finish(std::function<void()> upload) {
+    std::lock_guard<std::mutex> lock(readyMutex);
+    ready.push_back(std::move(upload));
+}
+
+bool AssetLoader::pump(double budgetMs) {
+    auto start = std::chrono::steady_clock::now();
+    while (true) {
+        std::function<void()> upload;
+        {
+            std::lock_guard<std::mutex> lock(readyMutex);
+            if (ready.empty()) {
+                break;
+            }
+            upload = std::move(ready.front());
+            ready.pop_front();
+        }
+
+        upload();
+        completed++;
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() >= budgetMs) {
+            break;
+        }
+    }
+    return done();
+}
@@ -0,0 +1,75 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AssimpModel.h"
+#include "ModelCache.h"
+#include "Texture.h"
+#include "ThreadPool.h"
+
+// Everything AssimpModel::importModel produces for the GL thread
+struct ModelPayload {
+    BakedModel baked;
+    std::map<std::string, DecodedImage> images; // material textures, keyed by their path in the meshes
+    bool fromCache = false;
+    bool embeddedTextures = false;
+};
+
+// Startup loading in two halves:
+//  - the CPU work (file reads, Assimp import with tangent generation, mesh
+//    optimization, LODs, image decode) runs on a ThreadPool, one job per request
+//  - finished payloads wait in a queue that the GL thread drains from pump(),
+//    uploading until the frame's time budget is used up
+// The GL thread stays free to draw a loading screen between pumps.
+// Completion callbacks run on the GL thread, in the order uploads happen.
+class AssetLoader {
+public:
+    // assignTexture(type, path) calls applied once the model is uploaded
+    using TextureAssignments = std::vector<std::pair<std::string, std::string>>;
+
+    // 0 threads = one per core minus the main thread
+    explicit AssetLoader(unsigned int threads = 0);
+
+    // Repeated paths are imported once, later requests share the first model
+    // through AssetRegistry like a second `new AssimpModel(path)` would
+    void requestModel(const std::string& path, TextureAssignments textures, std::function<void(AssimpModel*)> onLoaded);
+    // Stores the model in target when it is ready
+    void requestModel(const std::string& path, AssimpModel*& target, TextureAssignments textures = {});
+    // Texture::decode() on a worker, Texture::upload() on the GL thread
+    void requestTexture(std::shared_ptr<Texture> texture, std::function<void()> onLoaded = nullptr);
+
+    // Runs queued uploads until budgetMs has passed (at least one per call when
+    // any is ready). True once every request is done.
+    bool pump(double budgetMs);
+
+    bool done() const { return completed == requested; }
+    // 0..1 for a loading bar
+    float progress() const { return requested > 0 ? (float)completed / requested : 1.0f; }
+    unsigned int threadCount() const { return pool.size(); }
+
+private:
+    // called by workers, queues GL work for pump()
+    void finish(std::function<void()> upload);
+
+    std::mutex readyMutex;
+    std::deque<std::function<void()>> ready;
+
+    // canonical path -> set once the first request's upload is queued (GL thread only)
+    std::map<std::string, std::shared_future<void>> modelsRequested;
+    int requested = 0;
+    int completed = 0;
+
+    // last, so the workers are joined before the queue goes away
+    ThreadPool pool;
+};
+
+#endif // ASSET_LOADER_H
@@ -0,0 +1,85 @@
+#include "AssetRegistry.h"
+
+#include <filesystem>
+#include <iostream>
+#include <assimp/postprocess.h>
+
+ImportedScene::ImportedScene(const std::string& path) {
+    // one flag set for everyone: animations only ever needed Triangulate,
+    // the model needs the rest
+    importedScene = importer.ReadFile(path,
+        aiProcess_Triangulate |
+        aiProcess_GenSmoothNormals |
+        aiProcess_CalcTangentSpace |
+        aiProcess_ValidateDataStructure |
+        aiProcess_PopulateArmatureData |
+        aiProcess_GenBoundingBoxes);
+
+    if (!importedScene || importedScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !importedScene->mRootNode) {
+        std::cerr << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+        importedScene = nullptr;
+    }
+}
+
+const aiAnimation* ImportedScene::animation(int index) const {
+    if (!importedScene || index < 0 || index >= (int)importedScene->mNumAnimations) {
+        return nullptr;
+    }
+    return importedScene->mAnimations[index];
+}
+
+std::string AssetRegistry::canonicalPath(const std::string& path) {
+    std::error_code ec;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, ec);
+    if (ec) {
+        return path;
+    }
+    return canonical.generic_string();
+}
+
+std::shared_ptr<ImportedScene> AssetRegistry::scene(const std::string& path) {
+    std::string key = canonicalPath(path);
+    AssetRegistry& r = get();
+    std::shared_ptr<SceneEntry> entry;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        auto& slot = r.scenes[key];
+        if (!slot) {
+            slot = std::make_shared<SceneEntry>();
+        }
+        entry = slot;
+    }
+
+    // import outside the lock so different files load in parallel
+    std::call_once(entry->once, [&] {
+        entry->scene = std::make_shared<ImportedScene>(path);
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.imports++;
+    });
+    return entry->scene;
+}
+
+int AssetRegistry::importCount() {
+    AssetRegistry& r = get();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.imports;
+}
+
+const AssimpModel* AssetRegistry::findModel(const std::string& path) {
+    auto& models = get().models;
+    auto it = models.find(canonicalPath(path));
+    return it != models.end() ? it->second.get() : nullptr;
+}
+
+void AssetRegistry::addModel(const std::string& path, std::shared_ptr<const AssimpModel> model) {
+    get().models[canonicalPath(path)] = std::move(model);
+}
+
+void AssetRegistry::releaseImports() {
+    AssetRegistry& r = get();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::cout << "Asset registry: " << r.imports << " imports, " << r.sharedModels
+        << " models shared an earlier load" << std::endl;
+    r.scenes.clear();
+    r.models.clear();
+}
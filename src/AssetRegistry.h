@@ -0,0 +1,79 @@
+#ifndef ASSET_REGISTRY_H
+#define ASSET_REGISTRY_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+
+class AssimpModel;
+
+// One Assimp import of a file, shared by the model and every Animation built
+// from it. The importer owns the scene, so keep the handle while using it.
+class ImportedScene {
+public:
+    explicit ImportedScene(const std::string& path);
+
+    ImportedScene(const ImportedScene&) = delete;
+    ImportedScene& operator=(const ImportedScene&) = delete;
+
+    const aiScene* scene() const { return importedScene; }
+    const char* error() const { return importer.GetErrorString(); }
+    unsigned int animationCount() const { return importedScene ? importedScene->mNumAnimations : 0; }
+    const aiAnimation* animation(int index) const;
+
+private:
+    Assimp::Importer importer;
+    const aiScene* importedScene = nullptr;
+};
+
+// Load-time registry keyed by canonical path:
+//  - scene(path) imports a file once no matter how many loaders ask for it
+//  - models remember the first AssimpModel loaded from a path; later models of
+//    the same file copy its meshes and reuse the same arena ranges instead of
+//    uploading the geometry again
+// Call releaseImports() once loading is done to free the Assimp scenes and the
+// model prototypes, the GPU data stays with the models.
+// scene() may be called from AssetLoader's workers; the model prototypes are
+// only touched on the GL thread.
+class AssetRegistry {
+public:
+    static std::string canonicalPath(const std::string& path);
+
+    static std::shared_ptr<ImportedScene> scene(const std::string& path);
+
+    // As loaded, before any assignTexture, nullptr if the path wasn't loaded yet
+    static const AssimpModel* findModel(const std::string& path);
+    // shared so this file never destroys an AssimpModel itself, the scene half
+    // links without GL (tools/AnimationBenchmark)
+    static void addModel(const std::string& path, std::shared_ptr<const AssimpModel> model);
+
+    static void releaseImports();
+
+    static int importCount();
+    static int sharedModelCount() { return get().sharedModels; }
+    static void countSharedModel() { get().sharedModels++; }
+
+private:
+    static AssetRegistry& get() {
+        static AssetRegistry s;
+        return s;
+    }
+
+    // a worker asking for a file that is still importing waits on its once flag
+    struct SceneEntry {
+        std::once_flag once;
+        std::shared_ptr<ImportedScene> scene;
+    };
+
+    std::mutex mutex; // guards scenes and imports
+    std::map<std::string, std::shared_ptr<SceneEntry>> scenes;
+    std::map<std::string, std::shared_ptr<const AssimpModel>> models;
+    int imports = 0;
+    int sharedModels = 0;
+};
+
+#endif // ASSET_REGISTRY_H
@@ -1,96 +1,208 @@
 #include "AssimpMesh.h"
 #include "Program.h"
 #include "TextureManager.h"
+#include "GLStateCache.h"
 
 #include <iostream>
+#include <algorithm>
+#include <array>
+#include <map>
+#include <cstddef>
 
 // Constructor
-AssimpMesh::AssimpMesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<AssimpTexture> textures) {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+AssimpMesh::AssimpMesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<AssimpTexture> textures,
+    std::vector<std::vector<unsigned int>> lodIndices) {
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    this->textures = std::move(textures);
+    this->lodIndices = std::move(lodIndices);
 
     // std::cout << "Mesh created" << std::endl;
 
     setupMesh();
+    resolveMaterial();
 }
 
-void AssimpMesh::setupMesh()
-{
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+// slot in uMaps for a texture type, -1 if the shaders don't sample it
+static int materialSlot(const std::string& type) {
+    if (type == "texture_diffuse")   return 0;
+    if (type == "texture_specular")  return 1;
+    if (type == "texture_roughness") return 2;
+    if (type == "texture_metalness") return 3;
+    if (type == "texture_normal")    return 4;
+    if (type == "texture_emission")  return 5;
+    return -1;
+}
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+void AssimpMesh::resolveMaterial() {
+    MeshMaterial m;
+    for (auto& t : textures) {
+        int slot = materialSlot(t.type);
+        if (slot >= 0) {
+            m.maps[slot] = t.id;
+        }
+    }
 
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    // identical map sets share an id
+    static std::map<std::array<GLuint, MESH_MATERIAL_SLOTS>, int> materialIds;
+    std::array<GLuint, MESH_MATERIAL_SLOTS> key;
+    std::copy(m.maps, m.maps + MESH_MATERIAL_SLOTS, key.begin());
+    auto it = materialIds.find(key);
+    if (it == materialIds.end()) {
+        it = materialIds.emplace(key, (int)materialIds.size()).first;
+    }
+    m.id = it->second;
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    material = m;
+}
 
-    // Vertex positions
+// attributes shared by both compact formats: 0 position, 1 octahedral normal,
+// 2 half float uv, 5 octahedral tangent + bitangent sign
+template <typename V>
+static void setupCompactAttributes() {
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V, position));
 
-    // Vertex normals
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(V), (void*)offsetof(V, normal));
 
-    // Vertex texture coordinates
     glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(V), (void*)offsetof(V, uv));
+
+    glEnableVertexAttribArray(5);
+    glVertexAttribPointer(5, 4, GL_BYTE, GL_TRUE, sizeof(V), (void*)offsetof(V, tangent));
+}
+
+static void setupStaticAttributes() {
+    setupCompactAttributes<StaticVertex>();
+}
+
+static void setupSkinnedAttributes() {
+    setupCompactAttributes<SkinnedVertex>();
 
     // Bone IDs
     glEnableVertexAttribArray(3);
-    glVertexAttribIPointer(3, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
+    glVertexAttribIPointer(3, 4, GL_UNSIGNED_BYTE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, boneIds));
 
     // Weights
     glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+    glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, weights));
+}
 
-    // Tangents
-    glEnableVertexAttribArray(5);
-    glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+GeometryArena& AssimpMesh::arena(VertexFormat format, bool wideIndices) {
+    // [0] 16-bit indices, [1] 32-bit indices for meshes with 65536+ vertices
+    static GeometryArena staticArenas[2] = {
+        { sizeof(StaticVertex), GL_UNSIGNED_SHORT, setupStaticAttributes },
+        { sizeof(StaticVertex), GL_UNSIGNED_INT, setupStaticAttributes }
+    };
+    static GeometryArena skinnedArenas[2] = {
+        { sizeof(SkinnedVertex), GL_UNSIGNED_SHORT, setupSkinnedAttributes },
+        { sizeof(SkinnedVertex), GL_UNSIGNED_INT, setupSkinnedAttributes }
+    };
+    return format == VertexFormat::Skinned ? skinnedArenas[wideIndices] : staticArenas[wideIndices];
+}
 
-    // Bitangents
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+size_t AssimpMesh::arenaBytesUsed() {
+    size_t bytes = 0;
+    for (VertexFormat format : { VertexFormat::Static, VertexFormat::Skinned }) {
+        bytes += arena(format, false).getBytesUsed() + arena(format, true).getBytesUsed();
+    }
+    return bytes;
+}
+
+template <typename V>
+static void packCommon(const Vertex& in, V& out) {
+    out.position = in.Position;
+    VertexPacking::packNormalFrame(in.Normal, in.Tangent, in.Bitangent, out.normal, out.tangent);
+    VertexPacking::packUV(in.TexCoords, out.uv);
+}
 
-    glBindVertexArray(0);
+template <typename V>
+static ArenaRange allocatePacked(GeometryArena& target, const std::vector<V>& packed, const std::vector<unsigned int>& indices) {
+    if (target.getIndexType() == GL_UNSIGNED_SHORT) {
+        // mesh-local indices fit in 16 bits, the base vertex does the rest
+        std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+        return target.allocate(packed.data(), packed.size(), shortIndices.data(), shortIndices.size());
+    }
+    return target.allocate(packed.data(), packed.size(), indices.data(), indices.size());
+}
+
+static ArenaRange allocateLodIndices(GeometryArena& target, const std::vector<unsigned int>& indices, GLint baseVertex) {
+    if (target.getIndexType() == GL_UNSIGNED_SHORT) {
+        std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+        return target.allocateIndices(shortIndices.data(), shortIndices.size(), baseVertex);
+    }
+    return target.allocateIndices(indices.data(), indices.size(), baseVertex);
+}
+
+ArenaRange AssimpMesh::upload(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, VertexFormat format) {
+    GeometryArena& target = arena(format, vertices.size() >= 65536);
+
+    if (format == VertexFormat::Skinned) {
+        std::vector<SkinnedVertex> packed(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            packCommon(vertices[i], packed[i]);
+            VertexPacking::packWeights(vertices[i].m_BoneIDs, vertices[i].m_Weights, packed[i].boneIds, packed[i].weights);
+        }
+        return allocatePacked(target, packed, indices);
+    }
+
+    std::vector<StaticVertex> packed(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        packCommon(vertices[i], packed[i]);
+    }
+    return allocatePacked(target, packed, indices);
+}
+
+void AssimpMesh::setupMesh()
+{
+    // only meshes that actually carry bone weights pay for the skinned layout
+    format = VertexFormat::Static;
+    for (const auto& v : vertices) {
+        if (v.m_BoneIDs[0] >= 0) {
+            format = VertexFormat::Skinned;
+            break;
+        }
+    }
+
+    // sub-allocate from the shared arena instead of owning a VAO/VBO/EBO
+    range = upload(vertices, indices, format);
+    GeometryArena& target = arena(format, range.indexType == GL_UNSIGNED_INT);
+    VAO = target.getVAO();
+
+    // simplified levels only add indices, the vertices are shared with LOD0
+    lods.assign(1, range);
+    for (const auto& lod : lodIndices) {
+        lods.push_back(allocateLodIndices(target, lod, range.baseVertex));
+    }
 
     // std::cout << "Mesh setup complete" << std::endl;
 }
 
 // render the mesh
-void AssimpMesh::Draw(const std::shared_ptr<Program> prog) const {
-    // build an ID array in the same order as uMaps[0..5]
-    GLuint ids[6] = { 0,0,0,0,0,0 };
-    for (auto& t : textures) {
-        if (t.type == "texture_diffuse")   ids[0] = t.id;
-        if (t.type == "texture_specular")  ids[1] = t.id;
-        if (t.type == "texture_roughness") ids[2] = t.id;
-        if (t.type == "texture_metalness") ids[3] = t.id;
-        if (t.type == "texture_normal")     ids[4] = t.id;
-        if (t.type == "texture_emission")   ids[5] = t.id;
-    }
+void AssimpMesh::Draw(const std::shared_ptr<Program> prog, int lod) const {
+    unsigned requested = prog ? prog->getFeatures() : 0;
+    if (prog) prog->setFeatures(featuresFor(requested));
+    bindState();
+    drawElements(lod);
+    if (prog) prog->setFeatures(requested);
+}
 
-    // bind each either to the real map or your 11 fallback
-    for (int i = 0; i < 6; ++i) {
-        glActiveTexture(GL_TEXTURE0 + i);
-        GLuint toBind = ids[i]
-            ? ids[i]
+void AssimpMesh::bindState() const {
+    // bind each either to the real map or the 1x1 fallback
+    for (int i = 0; i < MESH_MATERIAL_SLOTS; ++i) {
+        GLuint toBind = material.maps[i]
+            ? material.maps[i]
             : (i == 4 ? TextureManager::flatNormal()
-                : (i == 5 ? TextureManager::black() // <-- black for emission
+                : (i == 5 ? TextureManager::black() // black for emission
                     : TextureManager::white())); // white for all others
-        glBindTexture(GL_TEXTURE_2D, toBind);
+        GLStateCache::bindTexture(i, toBind);
     }
 
-    // draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    GLStateCache::bindVertexArray(VAO);
+}
 
-    // Reset to default texture unit
-    glActiveTexture(GL_TEXTURE0);
-}
\ No newline at end of file
+void AssimpMesh::drawElements(int lod) const {
+    const ArenaRange& r = lodRange(lod);
+    glDrawElementsBaseVertex(GL_TRIANGLES, r.indexCount, r.indexType, r.indexOffset(), r.baseVertex);
+}
@@ -4,10 +4,13 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <algorithm>
 #include <glad/glad.h>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Program.h"
+#include "GeometryArena.h"
+#include "VertexFormats.h"
 
 #define MAX_BONE_INFLUENCE 4
 
@@ -29,19 +32,60 @@ struct AssimpTexture {
     std::string path;
 };
 
+// number of texture slots, matches uMaps[0..5] in the shaders
+#define MESH_MATERIAL_SLOTS 6
+
+// LOD0 plus up to three simplified index buffers, see MeshSimplifier.h
+#define MESH_MAX_LODS 4
+
+// Texture ids for each uMaps slot, resolved once from the mesh's texture list
+// (0 = use the TextureManager fallback). id is shared by every mesh with the
+// same set of maps so draws can be sorted by material.
+struct MeshMaterial {
+    GLuint maps[MESH_MATERIAL_SLOTS] = { 0, 0, 0, 0, 0, 0 };
+    int id = 0;
+};
+
 class AssimpMesh {
     public:
        std::vector<Vertex> vertices;
        std::vector<unsigned int> indices;
        std::vector<AssimpTexture> textures;
-       unsigned int VAO;
+       unsigned int VAO; // the shared arena VAO
+       VertexFormat format = VertexFormat::Static;
+       ArenaRange range; // where the vertices/indices live in the arena
+       std::vector<ArenaRange> lods; // lods[0] == range, coarser levels share its vertices
+       std::vector<std::vector<unsigned int>> lodIndices; // CPU copy of LOD1 and up, for the model cache
+       MeshMaterial material;
 
-       AssimpMesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<AssimpTexture> textures);
-       void Draw(const std::shared_ptr<Program> prog) const;
+       // lodIndices come from the import (MeshSimplifier::buildLodChain) or the model cache
+       AssimpMesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<AssimpTexture> textures,
+           std::vector<std::vector<unsigned int>> lodIndices = {});
+       // Draws with the permutation featuresFor() picks, prog's selection is kept
+       void Draw(const std::shared_ptr<Program> prog, int lod = 0) const;
+       // requested without FEATURE_SKINNED for a Static mesh, which has no
+       // bone attributes to skin with
+       unsigned featuresFor(unsigned requested) const {
+           return format == VertexFormat::Static ? requested & ~(unsigned)FEATURE_SKINNED : requested;
+       }
 
-    private:
-        unsigned int VBO, EBO;
+       // Rebuild the material record, call after changing textures
+       void resolveMaterial();
+       // Binds the material maps and VAO, skipping whatever is already bound
+       void bindState() const;
+       void drawElements(int lod = 0) const;
+
+       int getLodCount() const { return (int)lods.size(); }
+       // Clamped to the levels this mesh actually has
+       const ArenaRange& lodRange(int lod) const { return lods[std::min(std::max(lod, 0), (int)lods.size() - 1)]; }
 
+       // One arena per GPU vertex format and index width
+       static GeometryArena& arena(VertexFormat format, bool wideIndices = false);
+       static size_t arenaBytesUsed();
+       // Packs load-time vertices into the given format and sub-allocates them
+       static ArenaRange upload(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, VertexFormat format);
+
+    private:
         void setupMesh();
 };
 
@@ -3,142 +3,213 @@
 #include <iostream>
 #include "stb_image.h"
 #include "AssimpGLMHelpers.h"
+#include "GLStateCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ModelCache.h"
+#include "Config.h"
+#include "AssetRegistry.h"
+#include "AssetLoader.h"
 #include <filesystem>
+#include <cstring>
 
 
 AssimpModel::AssimpModel(std::string const &path, bool gamma) : gammaCorrection(gamma) {
-    loadModel(path);
+    if (const AssimpModel* loaded = AssetRegistry::findModel(path)) {
+        // same file loaded before: reuse its arena ranges, assigned textures stay per model
+        *this = *loaded;
+        gammaCorrection = gamma;
+        AssetRegistry::countSharedModel();
+        std::cout << "Model shared: " << path << std::endl;
+        return;
+    }
+
+    ModelPayload payload;
+    if (importModel(path, payload)) {
+        upload(path, payload);
+    }
+    if (!meshes.empty()) {
+        AssetRegistry::addModel(path, std::make_shared<AssimpModel>(*this));
+    }
     // std::cout << "Model: " << path << " loaded" << std::endl;
 }
 
+AssimpModel::AssimpModel(std::string const &path, ModelPayload &payload, bool gamma) : gammaCorrection(gamma) {
+    upload(path, payload);
+    if (!meshes.empty() && !AssetRegistry::findModel(path)) {
+        AssetRegistry::addModel(path, std::make_shared<AssimpModel>(*this));
+    }
+}
+
 AssimpModel::~AssimpModel() {
 }
 
-void AssimpModel::Draw(const std::shared_ptr<Program> prog) const {
+void AssimpModel::Draw(const std::shared_ptr<Program> prog, int lod) const {
     // std::cout << "Mesh size: " << meshes.size() << std::endl;
+    // static submeshes of a rig switch to the unskinned permutation
+    unsigned requested = prog ? prog->getFeatures() : 0;
     for (unsigned int i = 0; i < meshes.size(); i++) {
-        meshes[i].Draw(prog);
+        if (prog) prog->setFeatures(meshes[i].featuresFor(requested));
+        meshes[i].bindState();
+        meshes[i].drawElements(lod);
         // std::cout << "Drawing mesh: " << i << std::endl;
     }
+    if (prog) prog->setFeatures(requested);
 }
 
-void AssimpModel::loadModel(std::string const &path) {
-    Assimp::Importer importer;
-    // importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_PRESERVE_PIVOTS, false);
-    // importer.SetPropertyFloat(AI_CONFIG_GLOBAL_SCALE_FACTOR_KEY, 1.0f);
-    const aiScene *scene = importer.ReadFile(path,
-        aiProcess_Triangulate |
-        aiProcess_GenSmoothNormals |
-        aiProcess_CalcTangentSpace |
-        aiProcess_ValidateDataStructure |
-        aiProcess_PopulateArmatureData |
-        // aiProcess_LimitBoneWeights |
-        // aiProcess_GlobalScale |
-        aiProcess_GenBoundingBoxes);
-
-    std::cout << "Loading model: " << path << std::endl;
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-        std::cerr << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
-        return;
+bool AssimpModel::importModel(std::string const &path, ModelPayload &payload) {
+    BakedModel& baked = payload.baked;
+    std::string directory = path.substr(0, path.find_last_of('/'));
+
+    payload.fromCache = Config::USE_MODEL_CACHE && ModelCache::load(path, baked);
+    if (payload.fromCache) {
+        std::cout << "Loaded model from cache: " << path << " (" << baked.meshes.size() << " meshes)" << std::endl;
     }
+    else {
+        // shared with any Animation of the same file, see AssetRegistry.h
+        std::shared_ptr<ImportedScene> imported = AssetRegistry::scene(path);
+        const aiScene *scene = imported->scene();
 
-    for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
-        aiMesh* mesh = scene->mMeshes[i];
-        const aiAABB& aabb = mesh->mAABB;
+        std::cout << "Loading model: " << path << std::endl;
+        if (!scene) {
+            return false;
+        }
 
-        // std::cout << "Mesh " << i << " AABB min: (" << aabb.mMin.x << ", " << aabb.mMin.y << ", " << aabb.mMin.z << ")" << std::endl;
-        // std::cout << "Mesh " << i << " AABB max: (" << aabb.mMax.x << ", " << aabb.mMax.y << ", " << aabb.mMax.z << ")" << std::endl;
+        // calculate the bounding box for the model
+        baked.boxMin = glm::vec3(std::numeric_limits<float>::infinity());
+        for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+            const aiAABB& box = scene->mMeshes[i]->mAABB;
 
-        m_BoundingBoxes.push_back(aabb);
-    }
+            baked.boxMin.x = std::min(baked.boxMin.x, box.mMin.x);
+            baked.boxMin.y = std::min(baked.boxMin.y, box.mMin.y);
+            baked.boxMin.z = std::min(baked.boxMin.z, box.mMin.z);
 
-    // calculate the bounding box for the model
-    for (const auto& box : m_BoundingBoxes) {
-        boundingBoxMin.x = std::min(boundingBoxMin.x, box.mMin.x);
-        boundingBoxMin.y = std::min(boundingBoxMin.y, box.mMin.y);
-        boundingBoxMin.z = std::min(boundingBoxMin.z, box.mMin.z);
+            baked.boxMax.x = std::max(baked.boxMax.x, box.mMax.x);
+            baked.boxMax.y = std::max(baked.boxMax.y, box.mMax.y);
+            baked.boxMax.z = std::max(baked.boxMax.z, box.mMax.z);
+        }
 
-        boundingBoxMax.x = std::max(boundingBoxMax.x, box.mMax.x);
-        boundingBoxMax.y = std::max(boundingBoxMax.y, box.mMax.y);
-        boundingBoxMax.z = std::max(boundingBoxMax.z, box.mMax.z);
-    }
+        std::cout<<"Loaded model: "<<path<<std::endl;
 
-    // std::cout << "Model: " << path << " bounding box min: (" << boundingBoxMin.x << ", " << boundingBoxMin.y << ", " << boundingBoxMin.z << ")" << std::endl;
-    // std::cout << "Model: " << path << " bounding box max: (" << boundingBoxMax.x << ", " << boundingBoxMax.y << ", " << boundingBoxMax.z << ")" << std::endl;
+        MeshOptimizer::Stats stats;
+        processNode(scene->mRootNode, scene, payload, stats);
 
+        std::cout << "Mesh optimization: " << path << ": " << stats.triangles << " triangles, vertices "
+            << stats.verticesBefore << " -> " << stats.verticesAfter
+            << ", ACMR " << stats.acmrBefore() << " -> " << stats.acmrAfter() << std::endl;
 
-    std::cout<<"Loaded model: "<<path<<std::endl;
+        if (Config::USE_MODEL_CACHE) {
+            if (payload.embeddedTextures) {
+                // embedded textures can't be reloaded from a path
+                std::cout << "Model cache: " << path << " has embedded textures, not baked" << std::endl;
+            }
+            else {
+                Animation::ReadHierarchyData(baked.rootNode, scene->mRootNode);
+                baked.globalInverseTransform = AssimpGLMHelpers::ConvertMatrixToGLMFormat(aiMatrix4x4(scene->mRootNode->mTransformation).Inverse());
+                for (unsigned int i = 0; i < scene->mNumAnimations; ++i) {
+                    baked.animations.push_back(ModelCache::bakeAnimation(scene->mAnimations[i]));
+                }
+                if (ModelCache::save(path, baked)) {
+                    std::cout << "Model cache: wrote " << ModelCache::cachePath(path) << std::endl;
+                }
+            }
+        }
+    }
 
-    directory = path.substr(0, path.find_last_of('/'));
+    // decode the material textures here too, the GL thread only uploads them
+    for (const auto& mesh : baked.meshes) {
+        for (const auto& texture : mesh.textures) {
+            if (payload.images.find(texture.path) == payload.images.end()) {
+                AssimpDecodeImage(texture.path.c_str(), directory, payload.images[texture.path]);
+            }
+        }
+    }
+    return true;
+}
 
-    // boundingBoxMin = glm::vec3(std::numeric_limits<float>::max());
-    // boundingBoxMax = glm::vec3(std::numeric_limits<float>::lowest());
+void AssimpModel::upload(std::string const &path, ModelPayload &payload) {
+    BakedModel& baked = payload.baked;
 
-    processNode(scene->mRootNode, scene);
+    directory = path.substr(0, path.find_last_of('/'));
+    boundingBoxMin = baked.boxMin;
+    boundingBoxMax = baked.boxMax;
+    m_BoneInfoMap = std::move(baked.boneInfo);
+    m_BoneCounter = baked.boneCounter;
+
+    for (auto& bakedMesh : baked.meshes) {
+        // identical images, here or in other models, share one texture, see TextureCache.h
+        for (auto& texture : bakedMesh.textures) {
+            auto image = payload.images.find(texture.path);
+            if (image != payload.images.end()) {
+                texture.id = AssimpTextureFromImage(image->second);
+            }
+            else {
+                texture.id = AssimpTextureFromFile(texture.path.c_str(), directory);
+            }
+            holdTexture(texture.id);
+        }
+        meshes.push_back(AssimpMesh(std::move(bakedMesh.vertices), std::move(bakedMesh.indices),
+            std::move(bakedMesh.textures), std::move(bakedMesh.lodIndices)));
+    }
 
-    // after processing all nodes, we can calculate the bounding box
-    // calculateBoundingBox();
+    if (!payload.fromCache) {
+        std::cout << "LOD chain: " << path << ":";
+        for (int lod = 0; lod < getLodCount(); ++lod) {
+            std::cout << " " << getTriangleCount(lod);
+        }
+        std::cout << " triangles" << std::endl;
+    }
 
     std::cout<<"Model loaded"<<std::endl;
 }
 
-void AssimpModel::processNode(aiNode* node, const aiScene* scene) {
+void AssimpModel::processNode(aiNode* node, const aiScene* scene, ModelPayload& payload, MeshOptimizer::Stats& stats) {
 
     // Process all the node's meshes (if any)
     // std::cout<< "Processing node: " << node->mName.C_Str() << std::endl;
     for (unsigned int i = 0; i < node->mNumMeshes; i++) {
         // std::cout<<"Processing node: "<<i<<std::endl;
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        payload.baked.meshes.push_back(processMesh(mesh, scene, payload, stats));
     }
 
     // std::cout<<"Node processed"<<std::endl;
 
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
         // std::cout<<"Processing children: "<<i<<std::endl;
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, payload, stats);
     }
 
     // std::cout<<"Children processed"<<std::endl;
 }
 
-std::vector<AssimpTexture> AssimpModel::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName, const aiScene* scene) {
+std::vector<AssimpTexture> AssimpModel::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName, const aiScene* scene, ModelPayload& payload) {
     std::cout << "Material has " << mat->GetTextureCount(type) << " textures of type " << typeName << std::endl;
     std::vector<AssimpTexture> textures;
     for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
         aiString str;
         mat->GetTexture(type, i, &str);
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-            if (std::strcmp(textures_loaded[j].path.c_str(), str.C_Str()) == 0) {
-                textures.push_back(textures_loaded[j]);
-                skip = true;
-                break;
-            }
-        }
-        if (!skip) {
-            AssimpTexture texture;
-
-            // Check if the texture is embedded in the model
-            const aiTexture* embeddedTexture = scene->GetEmbeddedTexture(str.C_Str());
-            if (embeddedTexture) {
-                // Load the texture from embedded data
-                texture.id = loadEmbeddedTexture(embeddedTexture);
-            }
-            else {
-                // Load the texture from file
-                texture.id = AssimpTextureFromFile(str.C_Str(), directory);
-            }
 
-            textures.push_back(texture);
-            textures_loaded.push_back(texture);
+        // ids are filled in by upload(), by path
+        AssimpTexture texture;
+        texture.id = 0;
+        texture.path = str.C_Str();
+
+        // Check if the texture is embedded in the model
+        const aiTexture* embeddedTexture = scene->GetEmbeddedTexture(str.C_Str());
+        if (embeddedTexture && payload.images.find(texture.path) == payload.images.end()) {
+            // Decode the texture from embedded data
+            decodeEmbeddedTexture(embeddedTexture, payload.images[texture.path]);
+            payload.embeddedTextures = true;
         }
+
+        textures.push_back(texture);
     }
 
     return textures;
 }
 
-unsigned int AssimpTextureFromFile(const char* path, const std::string& directory, bool gamma) {
+bool AssimpDecodeImage(const char* path, const std::string& directory, DecodedImage& out) {
     std::string filename;
     if (directory.empty() || path[0] == '/' || (path[0] != '\0' && path[1] == ':')) {
         // Path is absolute or directory is empty
@@ -154,51 +225,8 @@ unsigned int AssimpTextureFromFile(const char* path, const std::string& director
 
     std::cout << "Attempting to load texture: " << filename << std::endl;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-
-    if (data) {
-        GLenum format;
-        GLenum internalFormat; // Add internal format for gamma correction
-
-        if (nrComponents == 1) {
-            format = GL_RED;
-            internalFormat = GL_RED;
-        }
-        else if (nrComponents == 3) {
-            format = GL_RGB;
-            internalFormat = gamma ? GL_SRGB : GL_RGB; // Use sRGB for gamma correction
-        }
-        else if (nrComponents == 4) {
-            format = GL_RGBA;
-            internalFormat = gamma ? GL_SRGB_ALPHA : GL_RGBA; // Use sRGB_ALPHA for gamma correction
-        }
-        else {
-            format = GL_RGB;
-            internalFormat = gamma ? GL_SRGB : GL_RGB;
-            std::cout << "Unusual number of components in image: " << nrComponents << std::endl;
-        }
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-
-        // Use internalFormat to handle gamma correction properly
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        std::cout << "Successfully loaded texture: " << filename << " (" << width << "x" << height
-            << ", " << nrComponents << " channels)" << std::endl;
-
-        stbi_image_free(data);
-    }
-    else {
+    // picks up a texconv .ktx2 next to the image when there is one
+    if (!TextureCache::decode(filename, out)) {
         std::cerr << "Texture failed to load at path: " << filename << std::endl;
         std::cerr << "STB_Image error: " << stbi_failure_reason() << std::endl;
 
@@ -209,92 +237,99 @@ unsigned int AssimpTextureFromFile(const char* path, const std::string& director
         else {
             std::cerr << "File does not exist or is not accessible" << std::endl;
         }
-
-        stbi_image_free(data);
+        return false;
     }
+    return true;
+}
 
+unsigned int AssimpTextureFromImage(const DecodedImage& image, bool gamma) {
+    TextureSampler sampler;
+    sampler.srgb = gamma; // sRGB internal format for gamma correction
+    unsigned int textureID = TextureCache::acquire(image, sampler);
+    if (textureID) {
+        std::cout << "Successfully loaded texture: " << image.filename << " (" << image.width << "x" << image.height
+            << ", " << image.channels << " channels)" << std::endl;
+    }
     return textureID;
 }
 
-unsigned int AssimpModel::loadEmbeddedTexture(const aiTexture* embeddedTexture) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+unsigned int AssimpTextureFromFile(const char* path, const std::string& directory, bool gamma) {
+    DecodedImage image;
+    AssimpDecodeImage(path, directory, image);
+    return AssimpTextureFromImage(image, gamma);
+}
+
+void AssimpModel::decodeEmbeddedTexture(const aiTexture* embeddedTexture, DecodedImage& out) {
+    out.filename = embeddedTexture->mFilename.C_Str();
 
     // Check if texture is compressed
     if (embeddedTexture->mHeight == 0) {
         // Compressed texture data (like PNG, JPG, etc.)
-        int width, height, channels;
         unsigned char* data = stbi_load_from_memory(
             reinterpret_cast<const stbi_uc*>(embeddedTexture->pcData),
             embeddedTexture->mWidth,  // mWidth contains the size in bytes for compressed textures
-            &width, &height, &channels, 0
+            &out.width, &out.height, &out.channels, 0
         );
 
         if (data) {
-            GLenum format;
-            if (channels == 1) format = GL_RED;
-            else if (channels == 3) format = GL_RGB;
-            else if (channels == 4) format = GL_RGBA;
-            else format = GL_RGB;
-
-            glBindTexture(GL_TEXTURE_2D, textureID);
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            stbi_image_free(data);
+            out.pixels.reset(data, stbi_image_free);
+            out.byteSize = (size_t)out.width * out.height * out.channels;
+            out.contentHash = TextureCache::contentHash(data, out.byteSize, out.width, out.height, out.channels);
         }
         else {
             std::cerr << "Failed to load embedded compressed texture" << std::endl;
-            return 0;
         }
     }
     else {
-        // Uncompressed texture data (raw pixels)
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-            embeddedTexture->mWidth, embeddedTexture->mHeight,
-            0, GL_RGBA, GL_UNSIGNED_BYTE, embeddedTexture->pcData);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        // Uncompressed texture data (raw pixels), copied since the scene is released after loading
+        size_t bytes = (size_t)embeddedTexture->mWidth * embeddedTexture->mHeight * 4;
+        out.width = embeddedTexture->mWidth;
+        out.height = embeddedTexture->mHeight;
+        out.channels = 4;
+        out.pixels.reset(new unsigned char[bytes], std::default_delete<unsigned char[]>());
+        std::memcpy(out.pixels.get(), embeddedTexture->pcData, bytes);
+        out.byteSize = bytes;
+        out.contentHash = TextureCache::contentHash(out.pixels.get(), bytes, out.width, out.height, out.channels);
+    }
+}
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+void AssimpModel::holdTexture(unsigned int id) {
+    TextureRef ref(id);
+    bool held = std::any_of(textures_loaded.begin(), textures_loaded.end(),
+        [id](const TextureRef& t) { return t.id() == id; });
+    if (id && !held) {
+        textures_loaded.push_back(std::move(ref));
     }
+}
 
-    return textureID;
+void AssimpModel::releaseUnusedTextures() {
+    textures_loaded.erase(std::remove_if(textures_loaded.begin(), textures_loaded.end(), [this](const TextureRef& t) {
+        for (const auto& mesh : meshes) {
+            for (const auto& tex : mesh.textures) {
+                if (tex.id == t.id()) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }), textures_loaded.end());
 }
 
 void AssimpModel::assignTexture(const std::string& type, const std::string& path) {
     // Load the texture
-    unsigned int texID = AssimpTextureFromFile(path.c_str(), "", gammaCorrection);
+    DecodedImage image;
+    AssimpDecodeImage(path.c_str(), "", image);
+    assignTexture(type, path, image);
+}
 
-    // Create a texture object
+void AssimpModel::assignTexture(const std::string& type, const std::string& path, const DecodedImage& image) {
+    // Create a texture object, TextureCache hands back the existing texture
+    // when any model already uploaded the same image
     AssimpTexture texture;
-    texture.id = texID;
     texture.type = type;
     texture.path = path;
-
-    // See if we've already loaded this texture
-    bool alreadyLoaded = false;
-    for (auto& tex : textures_loaded) {
-        if (tex.path == path) {
-            // Use the already loaded texture ID
-            texture.id = tex.id;
-            alreadyLoaded = true;
-            break;
-        }
-    }
-
-    if (!alreadyLoaded) {
-        // Add to loaded textures list
-        textures_loaded.push_back(texture);
-    }
+    texture.id = AssimpTextureFromImage(image, gammaCorrection);
+    holdTexture(texture.id);
 
     // Assign to all meshes in the model
     for (auto& mesh : meshes) {
@@ -312,7 +347,10 @@ void AssimpModel::assignTexture(const std::string& type, const std::string& path
         if (!found) {
             mesh.textures.push_back(texture);
         }
+        mesh.resolveMaterial();
     }
+    // the maps this replaced may now be unused everywhere
+    releaseUnusedTextures();
 
     std::cout << "Manually assigned texture: " << path << " as " << type << std::endl;
 }
@@ -324,17 +362,22 @@ void AssimpModel::SetVertexBoneDataToDefault(Vertex& vertex) {
     }
 }
 
-AssimpMesh AssimpModel::processMesh(aiMesh* mesh, const aiScene* scene) {
+BakedMesh AssimpModel::processMesh(aiMesh* mesh, const aiScene* scene, ModelPayload& payload, MeshOptimizer::Stats& stats) {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<AssimpTexture> textures;
 
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-        Vertex vertex;
+        Vertex vertex{}; // zeroed, welding compares whole vertices
         SetVertexBoneDataToDefault(vertex);
         vertex.Position = AssimpGLMHelpers::GetGLMVec(mesh->mVertices[i]);
         vertex.Normal = AssimpGLMHelpers::GetGLMVec(mesh->mNormals[i]);
 
+        if (mesh->HasTangentsAndBitangents()) {
+            vertex.Tangent = AssimpGLMHelpers::GetGLMVec(mesh->mTangents[i]);
+            vertex.Bitangent = AssimpGLMHelpers::GetGLMVec(mesh->mBitangents[i]);
+        }
+
         if (mesh->mTextureCoords[0])
         {
             glm::vec2 vec;
@@ -349,10 +392,6 @@ AssimpMesh AssimpModel::processMesh(aiMesh* mesh, const aiScene* scene) {
         // std::cout << "Processing vertex: " << i << std::endl;
 
         vertices.push_back(vertex);
-
-        // update bounding box based on min/max for the model
-        // boundingBoxMin = glm::min(boundingBoxMin, vertex.Position);
-        // boundingBoxMax = glm::max(boundingBoxMax, vertex.Position);
     }
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
         aiFace face = mesh->mFaces[i];
@@ -364,38 +403,47 @@ AssimpMesh AssimpModel::processMesh(aiMesh* mesh, const aiScene* scene) {
     aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
     // diffuse maps
-    std::vector<AssimpTexture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", scene);
+    std::vector<AssimpTexture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", scene, payload);
     textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
 
     // specular maps
-    std::vector<AssimpTexture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", scene);
+    std::vector<AssimpTexture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", scene, payload);
     textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
 
     // normal maps
-    std::vector<AssimpTexture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", scene);
+    std::vector<AssimpTexture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", scene, payload);
     textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
 
     // height maps
-    std::vector<AssimpTexture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", scene);
+    std::vector<AssimpTexture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", scene, payload);
     textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
     // roughness maps
-    std::vector<AssimpTexture> roughnessMaps = loadMaterialTextures(material, aiTextureType_SHININESS, "texture_roughness", scene);
+    std::vector<AssimpTexture> roughnessMaps = loadMaterialTextures(material, aiTextureType_SHININESS, "texture_roughness", scene, payload);
     textures.insert(textures.end(), roughnessMaps.begin(), roughnessMaps.end());
 
     // metalness maps
-    std::vector<AssimpTexture> metalnessMaps = loadMaterialTextures(material, aiTextureType_OPACITY, "texture_metalness", scene);
+    std::vector<AssimpTexture> metalnessMaps = loadMaterialTextures(material, aiTextureType_OPACITY, "texture_metalness", scene, payload);
     textures.insert(textures.end(), metalnessMaps.begin(), metalnessMaps.end());
 
     // emission maps
-    std::vector<AssimpTexture> emissionMaps = loadMaterialTextures(material, aiTextureType_EMISSIVE, "texture_emission", scene);
+    std::vector<AssimpTexture> emissionMaps = loadMaterialTextures(material, aiTextureType_EMISSIVE, "texture_emission", scene, payload);
     textures.insert(textures.end(), emissionMaps.begin(), emissionMaps.end());
 
-    ExtractBoneWeightForVertices(vertices, mesh, scene);
+    ExtractBoneWeightForVertices(vertices, mesh, payload.baked.boneInfo, payload.baked.boneCounter);
+
+    // weld + reorder before upload, see MeshOptimizer.h
+    stats.add(MeshOptimizer::optimize(vertices, indices));
 
     // std::cout << "Mesh processed" << std::endl;
 
-    return AssimpMesh(vertices, indices, textures);
+    BakedMesh baked;
+    // simplified levels index into the same vertices, see MeshSimplifier.h
+    baked.lodIndices = MeshSimplifier::buildLodChain(vertices, indices, MESH_MAX_LODS);
+    baked.vertices = std::move(vertices);
+    baked.indices = std::move(indices);
+    baked.textures = std::move(textures);
+    return baked;
 }
 
 void AssimpModel::SetVertexBoneData(Vertex& vertex, int boneID, float weight) {
@@ -423,10 +471,7 @@ void AssimpModel::SetVertexBoneData(Vertex& vertex, int boneID, float weight) {
     }
 }
 
-void AssimpModel::ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, aiMesh* mesh, const aiScene* scene) {
-    auto& boneInfoMap = m_BoneInfoMap;
-    auto& boneCounter = m_BoneCounter;
-
+void AssimpModel::ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, aiMesh* mesh, std::map<std::string, BoneInfo>& boneInfoMap, int& boneCounter) {
     // std::cout << "Bone counter: " << boneCounter << std::endl;
 
     for (int boneIndex = 0; boneIndex < mesh->mNumBones; ++boneIndex) {
@@ -436,11 +481,11 @@ void AssimpModel::ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, ai
             BoneInfo newBoneInfo;
             newBoneInfo.id = boneCounter;
             newBoneInfo.offset = AssimpGLMHelpers::ConvertMatrixToGLMFormat(mesh->mBones[boneIndex]->mOffsetMatrix);
-            m_BoneInfoMap[boneName] = newBoneInfo;
+            boneInfoMap[boneName] = newBoneInfo;
             boneID = boneCounter;
             boneCounter++;
         } else {
-            boneID = m_BoneInfoMap[boneName].id;
+            boneID = boneInfoMap[boneName].id;
         }
 
         assert(boneID != -1);
@@ -491,3 +536,18 @@ int AssimpModel::getMeshSize(int meshIndex) const {
     return 0; // Return 0 if mesh index is out of bounds
 }
 
+int AssimpModel::getLodCount() const {
+    int count = 1;
+    for (const auto& mesh : meshes) {
+        count = std::max(count, mesh.getLodCount());
+    }
+    return count;
+}
+
+int AssimpModel::getTriangleCount(int lod) const {
+    int triangles = 0;
+    for (const auto& mesh : meshes) {
+        triangles += mesh.lodRange(lod).indexCount / 3;
+    }
+    return triangles;
+}
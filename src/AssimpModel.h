@@ -12,11 +12,20 @@
 #include <assimp/postprocess.h>
 
 #include "AssimpMesh.h" // Include AssimpMesh.h to use AssimpMesh class
+#include "MeshOptimizer.h"
+#include "TextureCache.h"
 
 using namespace glm;
 
+// Reads and decodes an image without touching GL, safe on any thread
+bool AssimpDecodeImage(const char *path, const std::string &directory, DecodedImage &out);
+// Mipmapped GL_TEXTURE_2D from TextureCache, the caller owns one reference
+unsigned int AssimpTextureFromImage(const DecodedImage &image, bool gamma = false);
 unsigned int AssimpTextureFromFile(const char *path, const std::string &directory, bool gamma = false);
 
+struct ModelPayload;
+struct BakedMesh;
+
 struct BoneInfo {
     // id is index in finalBoneMatrices
     int id;
@@ -28,9 +37,11 @@ struct BoneInfo {
 class AssimpModel {
     public:
         AssimpModel(std::string const &path, bool gamma = false);
+        // GL half of a load, the payload comes from importModel()
+        AssimpModel(std::string const &path, ModelPayload &payload, bool gamma = false);
         ~AssimpModel();
 
-        void Draw(const std::shared_ptr<Program> prog) const;
+        void Draw(const std::shared_ptr<Program> prog, int lod = 0) const;
 
 
         auto& GetBoneInfoMap() { return m_BoneInfoMap; }
@@ -38,38 +49,51 @@ class AssimpModel {
 
         std::vector<AssimpMesh> meshes;
         std::string directory;
-        std::vector<AssimpTexture> textures_loaded;
+        // one TextureCache reference per texture the meshes use
+        std::vector<TextureRef> textures_loaded;
         bool gammaCorrection;
 
         glm::vec3 boundingBoxMin = glm::vec3(std::numeric_limits<float>::infinity());
         glm::vec3 boundingBoxMax;
 
         void assignTexture(const std::string& type, const std::string& path);
+        // Same with the image already decoded, it is only uploaded if the path is new
+        void assignTexture(const std::string& type, const std::string& path, const DecodedImage& image);
 
         glm::vec3 getBoundingBoxMin() const { return boundingBoxMin; }
         glm::vec3 getBoundingBoxMax() const { return boundingBoxMax; }
 
         int getMeshCount() const;
         int getMeshSize(int meshIndex) const;
+        // Most LOD levels of any mesh, 1 when nothing was simplified
+        int getLodCount() const;
+        int getTriangleCount(int lod = 0) const;
+
+        // CPU half of a load: model cache or Assimp import, mesh optimization,
+        // LODs and texture decode. Touches no GL state, safe on a worker thread.
+        static bool importModel(std::string const &path, ModelPayload &payload);
 
     private:
-        void loadModel(std::string const &path);
-        void processNode(aiNode *node, const aiScene *scene);
-        AssimpMesh processMesh(aiMesh *mesh, const aiScene *scene);
-        std::vector<AssimpTexture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName, const aiScene *scene);
-        unsigned int loadEmbeddedTexture(const aiTexture* embeddedTexture);
+        // GL half: arena upload of the meshes and their textures
+        void upload(std::string const &path, ModelPayload &payload);
+        static void processNode(aiNode *node, const aiScene *scene, ModelPayload &payload, MeshOptimizer::Stats &stats);
+        static BakedMesh processMesh(aiMesh *mesh, const aiScene *scene, ModelPayload &payload, MeshOptimizer::Stats &stats);
+        static std::vector<AssimpTexture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName, const aiScene *scene, ModelPayload &payload);
+        static void decodeEmbeddedTexture(const aiTexture* embeddedTexture, DecodedImage& out);
+        // Adopts the reference acquired for id, dropping it if already held
+        void holdTexture(unsigned int id);
+        // Releases references no mesh uses anymore
+        void releaseUnusedTextures();
 
     private:
 
         std::map<std::string, BoneInfo> m_BoneInfoMap;
         int m_BoneCounter = 0;
 
-        void SetVertexBoneDataToDefault(Vertex& vertex);
-        void SetVertexBoneData(Vertex& vertex, int boneID, float weight);
-        void ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, aiMesh *mesh, const aiScene *scene);
+        static void SetVertexBoneDataToDefault(Vertex& vertex);
+        static void SetVertexBoneData(Vertex& vertex, int boneID, float weight);
+        static void ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, aiMesh *mesh, std::map<std::string, BoneInfo>& boneInfoMap, int& boneCounter);
         void calculateBoundingBox();
-
-        std::vector<aiAABB> m_BoundingBoxes;
 };
 
 #endif // ASSIMPMODEL_H
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "Bone.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #define GLM_ENABLE_EXPERIMENTAL
@@ -6,8 +8,7 @@
 Bone::Bone(const std::string& name, int ID, const aiNodeAnim* channel)
     :
     m_Name(name),
-    m_ID(ID),
-    m_LocalTransform(1.0f)
+    m_ID(ID)
 {
     m_NumPositions = channel->mNumPositionKeys;
 
@@ -46,62 +47,183 @@ Bone::Bone(const std::string& name, int ID, const aiNodeAnim* channel)
     }
 }
 
-void Bone::Update(float animationTime)
+Bone::Bone(const std::string& name, int ID, std::vector<KeyPosition> positions,
+    std::vector<KeyRotation> rotations, std::vector<KeyScale> scales)
+    :
+    m_Positions(std::move(positions)),
+    m_Rotations(std::move(rotations)),
+    m_Scales(std::move(scales)),
+    m_Name(name),
+    m_ID(ID)
+{
+    m_NumPositions = (int)m_Positions.size();
+    m_NumRotations = (int)m_Rotations.size();
+    m_NumScalings = (int)m_Scales.size();
+}
+
+namespace {
+    // Index i with keys[i].timeStamp <= time < keys[i + 1].timeStamp, clamped
+    // to [0, size - 2]; needs at least 2 keys. Amortized O(1) while time moves
+    // forward, a binary search when it jumps back.
+    template <typename Key>
+    int advanceCursor(const std::vector<Key>& keys, int& cursor, float time)
+    {
+        int last = (int)keys.size() - 2;
+        if (cursor > last || time < keys[cursor].timeStamp)
+        {
+            auto next = std::upper_bound(keys.begin(), keys.end(), time,
+                [](float t, const Key& key) { return t < key.timeStamp; });
+            cursor = std::max(0, (int)(next - keys.begin()) - 1);
+        }
+        while (cursor < last && time >= keys[cursor + 1].timeStamp)
+        {
+            ++cursor;
+        }
+        cursor = std::min(cursor, last);
+        return cursor;
+    }
+}
+
+glm::mat4 Bone::GetLocalTransform(float animationTime, BoneCursor& cursor) const
 {
 
     if (m_NumPositions == 0 || m_NumRotations == 0 || m_NumScalings == 0)
     {
-        m_LocalTransform = glm::mat4(1.0f);
-        return;
+        return glm::mat4(1.0f);
     }
 
-    glm::mat4 translation = InterpolatePosition(animationTime);
-    glm::mat4 rotation = InterpolateRotation(animationTime);
-    glm::mat4 scale = InterpolateScaling(animationTime);
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale;
+    if (!m_SampledPositions.empty())
+    {
+        SampleResampled(animationTime, position, rotation, scale);
+    }
+    else
+    {
+        position = InterpolatePosition(animationTime, cursor.position);
+        rotation = InterpolateRotation(animationTime, cursor.rotation);
+        scale = InterpolateScaling(animationTime, cursor.scale);
+    }
 
-    m_LocalTransform = translation * rotation * scale;
+    return ComposeTRS(position, rotation, scale);
 }
 
-int Bone::GetPositionIndex(float animationTime)
+void Bone::Sample(float animationTime, BoneCursor& cursor, glm::vec3& position, glm::quat& rotation, glm::vec3& scale) const
 {
-    for (int i = 0; i < m_NumPositions - 1; ++i)
+    if (m_NumPositions == 0 || m_NumRotations == 0 || m_NumScalings == 0)
     {
-        if (animationTime < m_Positions[i + 1].timeStamp)
-        {
-            return i;
-        }
+        position = glm::vec3(0.0f);
+        rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        scale = glm::vec3(1.0f);
+        return;
     }
+    position = InterpolatePosition(animationTime, cursor.position);
+    rotation = InterpolateRotation(animationTime, cursor.rotation);
+    scale = InterpolateScaling(animationTime, cursor.scale);
+}
 
-    // assert(0);
-    return m_NumPositions - 1; // Return the last index if no match found
+size_t Bone::KeyBytes() const
+{
+    return m_Positions.capacity() * sizeof(KeyPosition) + m_Rotations.capacity() * sizeof(KeyRotation)
+        + m_Scales.capacity() * sizeof(KeyScale) + m_SampledPositions.capacity() * sizeof(glm::vec3)
+        + m_SampledRotations.capacity() * sizeof(glm::quat) + m_SampledScales.capacity() * sizeof(glm::vec3);
 }
 
-int Bone::GetRotationIndex(float animationTime)
+void Bone::ReleaseKeys()
 {
-    for (int i = 0; i < m_NumRotations - 1; ++i)
+    std::vector<KeyPosition>().swap(m_Positions);
+    std::vector<KeyRotation>().swap(m_Rotations);
+    std::vector<KeyScale>().swap(m_Scales);
+    std::vector<glm::vec3>().swap(m_SampledPositions);
+    std::vector<glm::quat>().swap(m_SampledRotations);
+    std::vector<glm::vec3>().swap(m_SampledScales);
+    m_NumPositions = m_NumRotations = m_NumScalings = 0;
+}
+
+glm::mat4 Bone::ComposeTRS(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+    // columns of R scaled by S, T in the last column; the bottom row stays 0 0 0 1
+    glm::mat3 r = glm::mat3_cast(rotation);
+    glm::mat4 m;
+    m[0] = glm::vec4(r[0] * scale.x, 0.0f);
+    m[1] = glm::vec4(r[1] * scale.y, 0.0f);
+    m[2] = glm::vec4(r[2] * scale.z, 0.0f);
+    m[3] = glm::vec4(translation, 1.0f);
+    return m;
+}
+
+void Bone::DecomposeTRS(const glm::mat4& m, glm::vec3& translation, glm::quat& rotation, glm::vec3& scale)
+{
+    translation = glm::vec3(m[3]);
+    glm::mat3 r(m);
+    scale = glm::vec3(glm::length(r[0]), glm::length(r[1]), glm::length(r[2]));
+    if (glm::determinant(r) < 0.0f)
+    {
+        scale.x = -scale.x;
+    }
+    for (int i = 0; i < 3; ++i)
     {
-        if (animationTime < m_Rotations[i + 1].timeStamp)
+        if (scale[i] != 0.0f)
         {
-            return i;
+            r[i] /= scale[i];
         }
     }
-
-    // assert(0);
-    return m_NumRotations - 1; // Return the last index if no match found
+    rotation = glm::normalize(glm::quat_cast(r));
 }
 
-int Bone::GetScaleIndex(float animationTime)
+void Bone::Resample(float step)
 {
-    for (int i = 0; i < m_NumScalings - 1; ++i)
+    int keys = std::max(m_NumPositions, std::max(m_NumRotations, m_NumScalings));
+    if (step <= 0.0f || keys <= 2 || m_NumPositions == 0 || m_NumRotations == 0 || m_NumScalings == 0)
     {
-        if (animationTime < m_Scales[i + 1].timeStamp)
-        {
-            return i;
-        }
+        return;
+    }
+
+    float end = std::max(m_Positions.back().timeStamp, std::max(m_Rotations.back().timeStamp, m_Scales.back().timeStamp));
+    int count = std::max(2, (int)std::ceil(end / step) + 1);
+    m_SampledPositions.resize(count);
+    m_SampledRotations.resize(count);
+    m_SampledScales.resize(count);
+    BoneCursor cursor;
+    for (int i = 0; i < count; ++i)
+    {
+        float t = i * step;
+        m_SampledPositions[i] = InterpolatePosition(t, cursor.position);
+        m_SampledRotations[i] = InterpolateRotation(t, cursor.rotation);
+        m_SampledScales[i] = InterpolateScaling(t, cursor.scale);
     }
+    m_InvSampleStep = 1.0f / step;
+}
+
+void Bone::SampleResampled(float animationTime, glm::vec3& position, glm::quat& rotation, glm::vec3& scale) const
+{
+    float x = std::max(animationTime, 0.0f) * m_InvSampleStep;
+    int last = (int)m_SampledPositions.size() - 2;
+    int i = std::min((int)x, last);
+    float f = glm::clamp(x - (float)i, 0.0f, 1.0f);
 
-    // assert(0);
-    return m_NumScalings - 1; // Return the last index if no match found
+    position = glm::mix(m_SampledPositions[i], m_SampledPositions[i + 1], f);
+    rotation = glm::normalize(glm::slerp(m_SampledRotations[i], m_SampledRotations[i + 1], f));
+    scale = glm::mix(m_SampledScales[i], m_SampledScales[i + 1], f);
+}
+
+int Bone::GetPositionIndex(float animationTime, int& cursor) const
+{
+    if (m_NumPositions < 2) return 0;
+    return advanceCursor(m_Positions, cursor, animationTime);
+}
+
+int Bone::GetRotationIndex(float animationTime, int& cursor) const
+{
+    if (m_NumRotations < 2) return 0;
+    return advanceCursor(m_Rotations, cursor, animationTime);
+}
+
+int Bone::GetScaleIndex(float animationTime, int& cursor) const
+{
+    if (m_NumScalings < 2) return 0;
+    return advanceCursor(m_Scales, cursor, animationTime);
 }
 
 float Bone::GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime)
@@ -109,52 +231,51 @@ float Bone::GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float anima
     float scaleFactor = 0.0f;
     float midWayLength = animationTime - lastTimeStamp;
     float framesDiff = nextTimeStamp - lastTimeStamp;
+    if (framesDiff <= 0.0f)
+    {
+        return 0.0f;
+    }
     scaleFactor = midWayLength / framesDiff;
-    return scaleFactor;
+    // hold the end keys instead of extrapolating past them
+    return glm::clamp(scaleFactor, 0.0f, 1.0f);
 }
 
-glm::mat4 Bone::InterpolatePosition(float animationTime)
+glm::vec3 Bone::InterpolatePosition(float animationTime, int& cursor) const
 {
     if (1 == m_NumPositions)
     {
-        return glm::translate(glm::mat4(1.0f), m_Positions[0].position);
+        return m_Positions[0].position;
     }
 
-    int p0Index = GetPositionIndex(animationTime);
+    int p0Index = GetPositionIndex(animationTime, cursor);
     int p1Index = p0Index + 1;
     float scaleFactor = GetScaleFactor(m_Positions[p0Index].timeStamp, m_Positions[p1Index].timeStamp, animationTime);
-    glm::vec3 finalPosition = glm::mix(m_Positions[p0Index].position, m_Positions[p1Index].position, scaleFactor);
-    return glm::translate(glm::mat4(1.0f), finalPosition);
+    return glm::mix(m_Positions[p0Index].position, m_Positions[p1Index].position, scaleFactor);
 }
 
-glm::mat4 Bone::InterpolateRotation(float animationTime) {
+glm::quat Bone::InterpolateRotation(float animationTime, int& cursor) const {
     if (1 == m_NumRotations) {
-        auto rotation = glm::normalize(m_Rotations[0].orientation);
-        return glm::toMat4(rotation);
+        return glm::normalize(m_Rotations[0].orientation);
     }
 
-    int p0Index = GetRotationIndex(animationTime);
+    int p0Index = GetRotationIndex(animationTime, cursor);
     int p1Index = p0Index + 1;
     float scaleFactor = GetScaleFactor(m_Rotations[p0Index].timeStamp, m_Rotations[p1Index].timeStamp, animationTime);
     glm::quat finalRotation = glm::slerp(m_Rotations[p0Index].orientation, m_Rotations[p1Index].orientation, scaleFactor);
-    finalRotation = glm::normalize(finalRotation);
-
-    return glm::toMat4(finalRotation);
+    return glm::normalize(finalRotation);
 }
 
-glm::mat4 Bone::InterpolateScaling(float animationTime) {
+glm::vec3 Bone::InterpolateScaling(float animationTime, int& cursor) const {
     if (1 == m_NumScalings) {
-        return glm::scale(glm::mat4(1.0f), m_Scales[0].scale);
+        return m_Scales[0].scale;
     }
 
-    int p0Index = GetScaleIndex(animationTime);
+    int p0Index = GetScaleIndex(animationTime, cursor);
     int p1Index = p0Index + 1;
     float scaleFactor = GetScaleFactor(m_Scales[p0Index].timeStamp, m_Scales[p1Index].timeStamp, animationTime);
-    glm::vec3 finalScale = glm::mix(m_Scales[p0Index].scale, m_Scales[p1Index].scale, scaleFactor);
-    return glm::scale(glm::mat4(1.0f), finalScale);
+    return glm::mix(m_Scales[p0Index].scale, m_Scales[p1Index].scale, scaleFactor);
 }
 
 // midwayLength = animationTime - lastTimeStamp
 // framesDiff = nextTimeStamp - lastTimeStamp
 // scaleFactor = midwayLength / framesDiff
-
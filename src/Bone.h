@@ -28,22 +28,56 @@ struct KeyScale
     float timeStamp;
 };
 
+// Where one player of a Bone is in each of its tracks. Bones are shared by
+// every Animator playing their Animation, so each Animator keeps its own.
+struct BoneCursor
+{
+    int position = 0;
+    int rotation = 0;
+    int scale = 0;
+};
+
 class Bone
 {
     public:
         Bone(const std::string& name, int ID, const aiNodeAnim* channel);
-        void Update(float animationTime);
-        glm::mat4 GetLocalTransform() { return m_LocalTransform; }
+        // From already converted keys (model cache)
+        Bone(const std::string& name, int ID, std::vector<KeyPosition> positions,
+            std::vector<KeyRotation> rotations, std::vector<KeyScale> scales);
+        // Local transform at animationTime, the identity for an incomplete channel
+        glm::mat4 GetLocalTransform(float animationTime, BoneCursor& cursor) const;
         std::string GetBoneName() const { return m_Name; }
-        int GetID() { return m_ID; }
-        int GetPositionIndex(float animationTime);
-        int GetRotationIndex(float animationTime);
-        int GetScaleIndex(float animationTime);
+        int GetID() const { return m_ID; }
+        // Key before animationTime. The cursor only moves forward while time
+        // does and re-seeks when the clip wraps around.
+        int GetPositionIndex(float animationTime, int& cursor) const;
+        int GetRotationIndex(float animationTime, int& cursor) const;
+        int GetScaleIndex(float animationTime, int& cursor) const;
+
+        // Interpolated keys at animationTime (identity TRS for an incomplete channel)
+        void Sample(float animationTime, BoneCursor& cursor, glm::vec3& position, glm::quat& rotation, glm::vec3& scale) const;
+
+        // Resamples the tracks every `step` ticks so sampling computes the key
+        // index directly instead of searching; skipped for tracks with <= 2 keys
+        void Resample(float step);
+
+        // Memory held by the key tracks (source and resampled)
+        size_t KeyBytes() const;
+        // Frees the tracks once an AnimationClip holds them; sampling then
+        // gives the identity
+        void ReleaseKeys();
+
+        // T * R * S written straight into an affine matrix, no 4x4 products
+        static glm::mat4 ComposeTRS(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+        // Inverse of ComposeTRS for an affine matrix without shear; a mirrored
+        // matrix comes back with a negative x scale
+        static void DecomposeTRS(const glm::mat4& m, glm::vec3& translation, glm::quat& rotation, glm::vec3& scale);
     private:
-        float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime);
-        glm::mat4 InterpolatePosition(float animationTime);
-        glm::mat4 InterpolateRotation(float animationTime);
-        glm::mat4 InterpolateScaling(float animationTime);
+        static float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime);
+        glm::vec3 InterpolatePosition(float animationTime, int& cursor) const;
+        glm::quat InterpolateRotation(float animationTime, int& cursor) const;
+        glm::vec3 InterpolateScaling(float animationTime, int& cursor) const;
+        void SampleResampled(float animationTime, glm::vec3& position, glm::quat& rotation, glm::vec3& scale) const;
 
         std::vector<KeyPosition> m_Positions;
         std::vector<KeyRotation> m_Rotations;
@@ -52,7 +86,12 @@ class Bone
         int m_NumRotations;
         int m_NumScalings;
 
-        glm::mat4 m_LocalTransform;
+        // uniform rate copy of the tracks, empty unless Resample() was called
+        std::vector<glm::vec3> m_SampledPositions;
+        std::vector<glm::quat> m_SampledRotations;
+        std::vector<glm::vec3> m_SampledScales;
+        float m_InvSampleStep = 0.0f;
+
         std::string m_Name;
         int m_ID;
 };
@@ -0,0 +1,97 @@
+#include "BonePalette.h"
+#include "Config.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <iostream>
+
+static_assert(Config::BONE_PALETTE_FRAMES >= 1 && Config::BONE_PALETTE_FRAMES <= 8, "fences array holds up to 8 regions");
+
+void BonePalette::init() {
+    BonePalette& p = get();
+    if (p.buffer != 0) {
+        return;
+    }
+    glGenBuffers(1, &p.buffer);
+    glGenTextures(1, &p.texture);
+    p.grow(Config::BONE_PALETTE_BONES);
+}
+
+void BonePalette::grow(int bones) {
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    int limit = maxTexels / (TEXELS_PER_BONE * Config::BONE_PALETTE_FRAMES);
+    if (bones > limit) {
+        std::cerr << "BonePalette: " << bones << " bones per frame exceed the texture buffer limit of "
+            << limit << std::endl;
+        bones = limit;
+    }
+
+    // the old store may still be read by queued draws, glBufferData orphans it
+    for (GLsync& fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+    capacity = bones;
+    region = -1;
+
+    GLsizeiptr bytes = (GLsizeiptr)capacity * TEXELS_PER_BONE * 4 * sizeof(float) * Config::BONE_PALETTE_FRAMES;
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    GLStateCache::bindTextureBuffer(TEXTURE_UNIT, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+    std::cout << "Bone palette: " << Config::BONE_PALETTE_FRAMES << " x " << capacity << " bones ("
+        << bytes / 1024 << " KB)" << std::endl;
+}
+
+void BonePalette::upload(const glm::mat4* matrices, int count) {
+    BonePalette& p = get();
+    if (p.buffer == 0 || count <= 0) {
+        return;
+    }
+    if (count > p.capacity) {
+        p.grow(std::max(count, p.capacity * 2));
+        count = std::min(count, p.capacity);
+    }
+
+    // every draw of the previous frame is queued by now
+    if (p.region >= 0) {
+        p.fences[p.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    p.region = (p.region + 1) % Config::BONE_PALETTE_FRAMES;
+    GLsync& fence = p.fences[p.region];
+    if (fence) {
+        // only blocks when the GPU is BONE_PALETTE_FRAMES frames behind
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    const GLsizeiptr boneBytes = TEXELS_PER_BONE * 4 * sizeof(float);
+    glBindBuffer(GL_TEXTURE_BUFFER, p.buffer);
+    float* dst = (float*)glMapBufferRange(GL_TEXTURE_BUFFER, (GLintptr)p.region * p.capacity * boneBytes,
+        (GLsizeiptr)count * boneBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (dst) {
+        for (int i = 0; i < count; ++i) {
+            const glm::mat4& m = matrices[i];
+            for (int row = 0; row < TEXELS_PER_BONE; ++row) {
+                *dst++ = m[0][row];
+                *dst++ = m[1][row];
+                *dst++ = m[2][row];
+                *dst++ = m[3][row];
+            }
+        }
+        glUnmapBuffer(GL_TEXTURE_BUFFER);
+    }
+    else {
+        std::cerr << "BonePalette: could not map region " << p.region << std::endl;
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    p.base = p.region * p.capacity;
+    GLStateCache::bindTextureBuffer(TEXTURE_UNIT, p.texture);
+}
@@ -0,0 +1,50 @@
+#ifndef BONE_PALETTE_H
+#define BONE_PALETTE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Every character's bone matrices for the frame in one texture buffer, read by
+// the SKINNED shaders with texelFetch. Bones are stored as the top three rows
+// of their matrix (3 RGBA32F texels, the last row is always 0 0 0 1), so a
+// draw only sets boneBase, the index of its first bone.
+// The buffer is a ring of Config::BONE_PALETTE_FRAMES regions. Each frame
+// maps the next region unsynchronized, after waiting on the fence of the
+// frame that last used it, so the upload never stalls on draws in flight.
+// GL 4.1 has no glTexBufferRange, the texture spans all regions and the
+// region offset is folded into frameBase().
+class BonePalette {
+public:
+    static constexpr int TEXTURE_UNIT = 11;
+    static constexpr int TEXELS_PER_BONE = 3;
+
+    // Needs the GL context
+    static void init();
+
+    // Copies count matrices into the next region and binds the texture
+    static void upload(const glm::mat4* matrices, int count);
+
+    // boneBase of matrices[0] of the last upload
+    static int frameBase() { return get().base; }
+
+    // Capacity of one region, in bones
+    static int regionBones() { return get().capacity; }
+
+private:
+    static BonePalette& get() {
+        static BonePalette* s = new BonePalette();
+        return *s;
+    }
+
+    // Reallocates for at least `bones` per region, dropping every fence
+    void grow(int bones);
+
+    GLuint buffer = 0;
+    GLuint texture = 0;
+    int capacity = 0;   // bones per region
+    int region = -1;    // last uploaded
+    int base = 0;
+    GLsync fences[8] = {};
+};
+
+#endif // BONE_PALETTE_H
@@ -20,13 +20,48 @@ namespace Config {
     constexpr bool DEBUG_TEX_LOADING = false;
     constexpr bool DEBUG_PLAYER_AABB = false;
     constexpr bool DEBUG_ORB_PICKUP = false;
+    constexpr bool DEBUG_GL_STATE = false; // Prints issued/skipped GL binds every 300 frames
+    constexpr bool DEBUG_ANIMATION_LOD = false; // Prints AnimationSystem LOD stats and the estimated CPU time saved every 300 frames
+    constexpr int DEBUG_CROWD_SIZE = 0; // Baked-animation copies of the player drawn around the library center, 0 = off
 
     // Rendering & Shaders
-    constexpr int MAX_BONES = 200;
+    constexpr int MAX_BONES = 200; // Bones per skeleton the SKINNED shaders address
+    constexpr int BONE_PALETTE_FRAMES = 3; // Bone palette ring regions, frames the GPU may lag before an upload waits
+    constexpr int BONE_PALETTE_BONES = 1024; // Initial bones per region, grows with the animated crowd
+    constexpr float ANIMATION_RESAMPLE_HZ = 60.0f; // Bone tracks resampled at this rate for O(1) key lookup, 0 keeps the source keys
+    constexpr bool ANIMATION_SOA_CLIPS = true; // Channels packed into SoA frames at ANIMATION_RESAMPLE_HZ and interpolated 4 bones at a time
+    constexpr bool ANIMATION_COMPRESSION = true; // SoA clips drop redundant frames and quantize keys at load
+    constexpr float ANIMATION_POSITION_TOLERANCE = 0.001f; // Max position error a dropped or constant key may add, model units
+    constexpr float ANIMATION_ROTATION_TOLERANCE = 0.001f; // Same for rotations, radians
+    constexpr float ANIMATION_SCALE_TOLERANCE = 0.001f; // Same for scales
+    constexpr int ANIMATION_JOB_SIZE = 4; // Animators per AnimationSystem job
+    constexpr unsigned int ANIMATION_THREADS = 0; // AnimationSystem workers, 0 = one per core minus the main thread
+    constexpr bool ANIMATION_LOD = true; // Throttle/skip pose evaluation from the culling and screen size AnimationSystem is given
+    constexpr int ANIMATION_LOD1_INTERVAL = 2; // Frames between pose evaluations at LodSelector level 1, interpolated in between
+    constexpr int ANIMATION_LOD2_INTERVAL = 4; // Same for level 2 and up, which also use the reduced skeleton
+    constexpr int ANIMATION_REDUCED_BONE_DEPTH = 7; // Bones deeper than this below the first bone follow their parent in the reduced skeleton
+    constexpr float ANIMATION_CROSSFADE_SECONDS = 0.2f; // Walk/idle switches blend over this much playback time, 0 cuts
+    constexpr float BAKED_ANIMATION_HZ = 30.0f; // AnimationBaker sample rate, the shader blends between frames
     inline static bool SHADOW = true;
     constexpr float ORTHO_SIZE = 60.0f;
     constexpr float PARTICLES = true;
 
+    // Occlusion culling (queries are read back a few frames late, never stalling)
+    inline static bool OCCLUSION_CULLING = true;
+    constexpr int OCCLUSION_CHUNK_CELLS = 5; // Grid cells per side of an occlusion chunk
+    constexpr float OCCLUSION_CHUNK_HEIGHT = 8.0f; // Height of a chunk's test box
+
+    // Asset loading
+    constexpr bool USE_PROGRAM_CACHE = true; // Save linked shader binaries to <vert>+<frag>.progbin and load those on later runs
+    constexpr bool USE_MODEL_CACHE = true; // Bake imported models to <file>.bake and load those on later runs
+    constexpr double LOADING_UPLOAD_BUDGET_MS = 8.0; // GL upload time per loading screen frame, see AssetLoader.h
+    constexpr bool USE_COMPRESSED_TEXTURES = true; // Load <image>.ktx2 from texconv instead of the image when present
+    constexpr size_t TEXTURE_CACHE_UNUSED_MB = 64; // Unreferenced textures kept for reuse before eviction
+    constexpr bool STREAM_TEXTURES = true; // Upload large textures over several frames through pixel unpack buffers
+    constexpr int TEXTURE_STREAM_BUFFERS = 4; // Staging buffers in flight
+    constexpr int TEXTURE_STREAM_BUFFER_MB = 8; // Size of each staging buffer
+    constexpr int TEXTURE_STREAM_MIN_KB = 256; // Smaller images are uploaded directly
+
     // UI
     constexpr bool SHOW_HEALTHBAR = true;
 	constexpr bool SHOW_MINIMAP = true;
@@ -0,0 +1,129 @@
+#include "DrawQueue.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <tuple>
+#include <glm/gtc/type_ptr.hpp>
+
+DrawQueue::~DrawQueue() {
+    if (instanceVBO != 0) {
+        glDeleteBuffers(1, &instanceVBO);
+    }
+}
+
+void DrawQueue::submit(const std::shared_ptr<Program>& prog, const AssimpModel* model, const glm::mat4& M) {
+    if (!prog || !model) return;
+
+    int matrix = (int)matrices.size();
+    matrices.push_back(M);
+    int lod = lodSelector ? lodSelector->select(model, M) : 0;
+
+    for (const auto& mesh : model->meshes) {
+        items.push_back({ prog.get(), &mesh, &mesh.lodRange(lod), matrix });
+    }
+}
+
+static auto sortKey(Program* prog, const AssimpMesh* mesh, const ArenaRange* range) {
+    return std::make_tuple(prog->getPid(), mesh->VAO, mesh->material.id, range->firstIndex, range->baseVertex);
+}
+
+void DrawQueue::bindInstanceMatrices(size_t firstInstance) {
+    // GL 4.1 has no base instance, so re-point the attributes at the batch
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for (GLuint col = 0; col < 4; ++col) {
+        GLuint loc = INSTANCE_MATRIX_LOCATION + col;
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+            (void*)(firstInstance * sizeof(glm::mat4) + col * sizeof(glm::vec4)));
+        glVertexAttribDivisor(loc, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void DrawQueue::flush() {
+    drawCalls = 0;
+    triangles = 0;
+    if (items.empty()) {
+        clear();
+        return;
+    }
+
+    // stable so draws with equal state keep their submission order
+    std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+        return sortKey(a.prog, a.mesh, a.range) < sortKey(b.prog, b.mesh, b.range);
+    });
+
+    // one upload for every instance matrix of the frame
+    instanceData.clear();
+    for (const auto& item : items) {
+        instanceData.push_back(matrices[item.matrix]);
+    }
+    if (instanceVBO == 0) {
+        glGenBuffers(1, &instanceVBO);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, instanceData.size() * sizeof(glm::mat4), instanceData.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    std::vector<GLuint> touchedVAOs;
+    std::vector<Program*> touchedProgs;
+    size_t first = 0;
+    while (first < items.size()) {
+        const Item& item = items[first];
+        size_t last = first + 1;
+        while (last < items.size() && items[last].prog == item.prog && items[last].mesh->VAO == item.mesh->VAO
+            && items[last].range->firstIndex == item.range->firstIndex
+            && items[last].range->baseVertex == item.range->baseVertex
+            && items[last].mesh->material.id == item.mesh->material.id) {
+            ++last;
+        }
+
+        item.prog->bind();
+        item.mesh->bindState();
+        const ArenaRange& range = *item.range;
+        triangles += (size_t)(range.indexCount / 3) * (last - first);
+
+        if (item.prog->supports(FEATURE_INSTANCED)) {
+            if (std::find(touchedVAOs.begin(), touchedVAOs.end(), item.mesh->VAO) == touchedVAOs.end()) {
+                touchedVAOs.push_back(item.mesh->VAO);
+            }
+            if (std::find(touchedProgs.begin(), touchedProgs.end(), item.prog) == touchedProgs.end()) {
+                touchedProgs.push_back(item.prog);
+            }
+            item.prog->setFeature(FEATURE_INSTANCED, true);
+            bindInstanceMatrices(first);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, range.indexType, range.indexOffset(),
+                (GLsizei)(last - first), range.baseVertex);
+            drawCalls++;
+        }
+        else {
+            // program can't take instance matrices, one draw per instance
+            for (size_t i = first; i < last; ++i) {
+                item.prog->setUniform(UniformId::M, instanceData[i]);
+                glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, range.indexType, range.indexOffset(), range.baseVertex);
+                drawCalls++;
+            }
+        }
+
+        first = last;
+    }
+
+    // leave the instance attributes off so plain draws fall back to M
+    for (GLuint vao : touchedVAOs) {
+        GLStateCache::bindVertexArray(vao);
+        for (GLuint col = 0; col < 4; ++col) {
+            glDisableVertexAttribArray(INSTANCE_MATRIX_LOCATION + col);
+        }
+    }
+    for (Program* prog : touchedProgs) {
+        prog->bind();
+        prog->setFeature(FEATURE_INSTANCED, false);
+    }
+
+    clear();
+}
+
+void DrawQueue::clear() {
+    items.clear();
+    matrices.clear();
+}
@@ -0,0 +1,58 @@
+#ifndef DRAW_QUEUE_H
+#define DRAW_QUEUE_H
+
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+
+#include "AssimpModel.h"
+#include "Program.h"
+#include "LodSelector.h"
+
+// Collects static model draws for the frame and submits them sorted by
+// (program, VAO, material, mesh). Runs of the same mesh become one instanced
+// draw, the model matrices going through an instance buffer bound to
+// attribute locations 7-10. Every other uniform must already be set on the
+// program when flush() is called. With a LodSelector set, each instance is
+// drawn at the LOD it picks.
+class DrawQueue {
+public:
+    static constexpr GLuint INSTANCE_MATRIX_LOCATION = 7;
+
+    ~DrawQueue();
+
+    void submit(const std::shared_ptr<Program>& prog, const AssimpModel* model, const glm::mat4& M);
+
+    // nullptr draws everything at LOD0
+    void setLodSelector(LodSelector* selector) { lodSelector = selector; }
+
+    // Sorts, draws and empties the queue
+    void flush();
+    void clear();
+
+    int size() const { return (int)items.size(); }
+    // Draw calls issued by the last flush
+    int lastDrawCalls() const { return drawCalls; }
+    // Triangles drawn by the last flush, after LOD selection
+    size_t lastTriangles() const { return triangles; }
+
+private:
+    struct Item {
+        Program* prog;
+        const AssimpMesh* mesh;
+        const ArenaRange* range; // the LOD picked for this instance
+        int matrix; // index into matrices
+    };
+
+    void bindInstanceMatrices(size_t firstInstance);
+
+    std::vector<Item> items;
+    std::vector<glm::mat4> matrices;
+    std::vector<glm::mat4> instanceData; // matrices in sorted draw order
+    GLuint instanceVBO = 0;
+    int drawCalls = 0;
+    size_t triangles = 0;
+    LodSelector* lodSelector = nullptr;
+};
+
+#endif // DRAW_QUEUE_H
@@ -0,0 +1,43 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+
+FrameArena& FrameArena::local() {
+    thread_local FrameArena arena;
+    return arena;
+}
+
+size_t FrameArena::capacity() const {
+    size_t total = 0;
+    for (const Block& b : blocks) {
+        total += b.size;
+    }
+    return total;
+}
+
+void* FrameArena::allocate(size_t bytes) {
+    bytes = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    // move on to the next block that fits, growing when none does
+    while (block < blocks.size() && offset + bytes > blocks[block].size) {
+        block++;
+        offset = 0;
+    }
+    if (block == blocks.size()) {
+        size_t size = std::max(bytes, blocks.empty() ? FIRST_BLOCK : blocks.back().size * 2);
+        // new[] of unsigned char is aligned for any fundamental type
+        blocks.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+    }
+    void* memory = blocks[block].memory.get() + offset;
+    offset += bytes;
+    return memory;
+}
+
+void FrameArena::rewind(size_t toBlock, size_t toOffset) {
+    block = toBlock;
+    offset = toOffset;
+    if (block == 0 && offset == 0 && blocks.size() > 1) {
+        size_t total = capacity();
+        blocks.clear();
+        blocks.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[total]), total });
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Bump allocator for the scratch a frame's pose evaluations need (sampled
+// poses, blend buffers, local matrices). Every thread has its own, so the
+// AnimationSystem workers never share one. A Scope hands everything allocated
+// under it back at once; the storage is kept, so once the arena has grown to
+// a frame's peak, blending costs no heap allocation at all.
+// Memory is uninitialized and 16 byte aligned, only for trivial types.
+class FrameArena {
+public:
+    static constexpr size_t ALIGNMENT = 16;
+
+    // The calling thread's arena
+    static FrameArena& local();
+
+    template <typename T>
+    T* alloc(size_t count) { return static_cast<T*>(allocate(count * sizeof(T))); }
+
+    // Rewinds the arena to where it was when the scope was opened
+    class Scope {
+    public:
+        explicit Scope(FrameArena& arena) : arena(arena), block(arena.block), offset(arena.offset) {}
+        ~Scope() { arena.rewind(block, offset); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        FrameArena& arena;
+        size_t block;
+        size_t offset;
+    };
+
+    // Bytes held across every block
+    size_t capacity() const;
+
+private:
+    static constexpr size_t FIRST_BLOCK = 64 * 1024;
+
+    struct Block {
+        std::unique_ptr<unsigned char[]> memory;
+        size_t size;
+    };
+
+    void* allocate(size_t bytes);
+    // Fully rewound arenas merge their blocks, the next frame fits in one
+    void rewind(size_t block, size_t offset);
+
+    std::vector<Block> blocks;
+    size_t block = 0;  // current block
+    size_t offset = 0; // first free byte in it
+};
+
+#endif // FRAME_ARENA_H
@@ -0,0 +1,95 @@
+#include "GLStateCache.h"
+
+void GLStateCache::useProgram(GLuint pid) {
+    GLStateCache& s = get();
+    if (s.program == pid) {
+        s.skipped++;
+        return;
+    }
+    glUseProgram(pid);
+    s.program = pid;
+    s.issued++;
+}
+
+void GLStateCache::bindVertexArray(GLuint vao) {
+    GLStateCache& s = get();
+    if (s.vertexArray == vao) {
+        s.skipped++;
+        return;
+    }
+    glBindVertexArray(vao);
+    s.vertexArray = vao;
+    s.issued++;
+}
+
+void GLStateCache::bindTexture(int unit, GLuint tex) {
+    GLStateCache& s = get();
+    if (unit < 0 || unit >= MAX_TEXTURE_UNITS) {
+        // untracked unit, always issue and forget which unit is active
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        s.activeUnit = -1;
+        s.issued += 2;
+        return;
+    }
+
+    if (s.textures[unit] == tex) {
+        s.skipped += 2;
+        return;
+    }
+    if (s.activeUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        s.activeUnit = unit;
+        s.issued++;
+    } else {
+        s.skipped++;
+    }
+    glBindTexture(GL_TEXTURE_2D, tex);
+    s.textures[unit] = tex;
+    s.issued++;
+}
+
+void GLStateCache::bindTextureBuffer(int unit, GLuint tex) {
+    GLStateCache& s = get();
+    if (unit < 0 || unit >= MAX_TEXTURE_UNITS) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_BUFFER, tex);
+        s.activeUnit = -1;
+        s.issued += 2;
+        return;
+    }
+
+    if (s.textureBuffers[unit] == tex) {
+        s.skipped += 2;
+        return;
+    }
+    if (s.activeUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        s.activeUnit = unit;
+        s.issued++;
+    } else {
+        s.skipped++;
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, tex);
+    s.textureBuffers[unit] = tex;
+    s.issued++;
+}
+
+void GLStateCache::invalidate() {
+    get().clear();
+}
+
+void GLStateCache::clear() {
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    for (int i = 0; i < MAX_TEXTURE_UNITS; ++i) {
+        textures[i] = UNKNOWN;
+        textureBuffers[i] = UNKNOWN;
+    }
+    activeUnit = -1;
+}
+
+void GLStateCache::resetStats() {
+    get().issued = 0;
+    get().skipped = 0;
+}
@@ -0,0 +1,52 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <glad/glad.h>
+
+// Shadow copy of the program / VAO / 2D and buffer texture bindings. Binds
+// that would not change anything are skipped. Any code that binds behind the
+// cache's back must call invalidate() so the next bind goes through.
+class GLStateCache {
+public:
+    static constexpr int MAX_TEXTURE_UNITS = 16;
+
+    static void useProgram(GLuint pid);
+    // Program of the last useProgram, UNKNOWN_BINDING after invalidate()
+    static GLuint boundProgram() { return get().program; }
+    static void bindVertexArray(GLuint vao);
+    // Binds a GL_TEXTURE_2D to the given unit, only switching the active unit
+    // when the binding actually has to change
+    static void bindTexture(int unit, GLuint tex);
+    // Same for a GL_TEXTURE_BUFFER, tracked apart from the 2D bindings
+    static void bindTextureBuffer(int unit, GLuint tex);
+
+    // Forget everything, the next bind of each kind is always issued
+    static void invalidate();
+
+    // Binds issued vs skipped since the last resetStats()
+    static long long issuedCalls() { return get().issued; }
+    static long long skippedCalls() { return get().skipped; }
+    static void resetStats();
+
+    static constexpr GLuint UNKNOWN_BINDING = 0xFFFFFFFFu;
+
+private:
+    static constexpr GLuint UNKNOWN = UNKNOWN_BINDING;
+
+    GLuint program = UNKNOWN;
+    GLuint vertexArray = UNKNOWN;
+    GLuint textures[MAX_TEXTURE_UNITS];
+    GLuint textureBuffers[MAX_TEXTURE_UNITS];
+    int activeUnit = -1;
+    long long issued = 0;
+    long long skipped = 0;
+
+    GLStateCache() { clear(); }
+    void clear();
+    static GLStateCache& get() {
+        static GLStateCache s;
+        return s;
+    }
+};
+
+#endif // GL_STATE_CACHE_H
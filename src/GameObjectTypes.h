@@ -67,6 +67,7 @@ enum class Material {
     blue_body,
     gold,
 };
+constexpr int MATERIAL_COUNT = (int)Material::gold + 1; // keep in sync with the last Material
 
 // Helper function to map each <Material> to a base color for particles (or fallback white)
 inline glm::vec3 materialToColor(Material m) {
@@ -124,10 +125,7 @@ struct WallObject {
 	vec3 direction;
 	float height;
 	float width;
-	GLuint WallVAID;
-	GLuint BuffObj, NorBuffObj, IndxBuffObj;
-	GLuint TexBuffObj;
-	int GiboLen;
+	ArenaRange range; // Quad in the shared mesh arena (world space)
 	std::shared_ptr<Texture> texture; // Texture for the wall
 };
 
@@ -136,10 +134,7 @@ struct LibGrndObject {
 	float width;
 	float height;
 	vec3 center_pos;
-	GLuint VAO;
-	GLuint BuffObj, NorBuffObj, IndxBuffObj;
-	GLuint TexBuffObj;
-	int GiboLen;
+	ArenaRange range; // Quad in the shared mesh arena (world space)
 	std::shared_ptr<Texture> texture; // Texture for the library
 };
 
@@ -0,0 +1,115 @@
+#include "GeometryArena.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <iostream>
+
+static constexpr size_t INITIAL_VERTEX_CAPACITY = 1 << 16;
+static constexpr size_t INITIAL_INDEX_CAPACITY = 1 << 18;
+
+GeometryArena::GeometryArena(GLsizei vertexStride, GLenum indexType, std::function<void()> setupAttributes)
+    : stride(vertexStride), indexType(indexType), setupAttributes(std::move(setupAttributes)) {
+}
+
+void GeometryArena::create() {
+    glGenVertexArrays(1, &vao);
+    vertexCapacity = INITIAL_VERTEX_CAPACITY;
+    indexCapacity = INITIAL_INDEX_CAPACITY;
+
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexCapacity * stride, nullptr, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &ebo);
+
+    GLStateCache::bindVertexArray(vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity * ArenaRange::indexSize(indexType), nullptr, GL_STATIC_DRAW);
+    setupAttributes();
+    GLStateCache::bindVertexArray(0);
+}
+
+static GLuint growBuffer(GLuint oldBuffer, size_t usedBytes, size_t newBytes) {
+    GLuint newBuffer;
+    glGenBuffers(1, &newBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+    if (usedBytes > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, oldBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &oldBuffer);
+    return newBuffer;
+}
+
+void GeometryArena::reserve(size_t vertices, size_t indices) {
+    if (vao == 0) {
+        create();
+    }
+    if (vertices <= vertexCapacity && indices <= indexCapacity) {
+        return;
+    }
+
+    if (vertices > vertexCapacity) {
+        size_t newCapacity = std::max(vertices, vertexCapacity * 2);
+        vbo = growBuffer(vbo, vertexCount * stride, newCapacity * stride);
+        vertexCapacity = newCapacity;
+    }
+    if (indices > indexCapacity) {
+        size_t newCapacity = std::max(indices, indexCapacity * 2);
+        size_t indexSize = ArenaRange::indexSize(indexType);
+        ebo = growBuffer(ebo, indexCount * indexSize, newCapacity * indexSize);
+        indexCapacity = newCapacity;
+    }
+
+    // point the VAO at the new buffers
+    GLStateCache::bindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    setupAttributes();
+    GLStateCache::bindVertexArray(0);
+}
+
+ArenaRange GeometryArena::allocate(const void* vertices, size_t vCount, const void* indices, size_t iCount) {
+    reserve(vertexCount + vCount, indexCount + iCount);
+
+    ArenaRange range;
+    range.baseVertex = (GLint)vertexCount;
+    range.firstIndex = (GLuint)indexCount;
+    range.indexCount = (GLsizei)iCount;
+    range.indexType = indexType;
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, vertexCount * stride, vCount * stride, vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // the element buffer binding is VAO state, upload through the copy target
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+    size_t indexSize = ArenaRange::indexSize(indexType);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, indexCount * indexSize, iCount * indexSize, indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    vertexCount += vCount;
+    indexCount += iCount;
+    return range;
+}
+
+ArenaRange GeometryArena::allocateIndices(const void* indices, size_t iCount, GLint baseVertex) {
+    reserve(vertexCount, indexCount + iCount);
+
+    ArenaRange range;
+    range.baseVertex = baseVertex;
+    range.firstIndex = (GLuint)indexCount;
+    range.indexCount = (GLsizei)iCount;
+    range.indexType = indexType;
+
+    size_t indexSize = ArenaRange::indexSize(indexType);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, indexCount * indexSize, iCount * indexSize, indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    indexCount += iCount;
+    return range;
+}
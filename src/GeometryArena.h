@@ -0,0 +1,97 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <glad/glad.h>
+
+// Where a mesh lives inside a GeometryArena
+struct ArenaRange {
+    GLint baseVertex = 0;
+    GLuint firstIndex = 0;
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+
+    static size_t indexSize(GLenum type) {
+        return type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    }
+    const void* indexOffset() const {
+        return (const void*)(uintptr_t)(firstIndex * indexSize(indexType));
+    }
+};
+
+// Command list for glMultiDrawElementsBaseVertex over ranges of one arena
+// (so all ranges share an index type).
+// Filled each frame by whoever decides what is visible, then drawn in one call.
+struct MultiDrawBatch {
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> baseVertices;
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    void add(const ArenaRange& range) {
+        indexType = range.indexType;
+        counts.push_back(range.indexCount);
+        offsets.push_back(range.indexOffset());
+        baseVertices.push_back(range.baseVertex);
+    }
+    void clear() {
+        counts.clear();
+        offsets.clear();
+        baseVertices.clear();
+    }
+    bool empty() const { return counts.empty(); }
+
+    // The arena's VAO must be bound
+    void draw() const {
+        if (counts.empty()) return;
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), indexType,
+            (const void* const*)offsets.data(), (GLsizei)counts.size(), (GLint*)baseVertices.data());
+    }
+};
+
+// One shared VAO + vertex buffer + index buffer for every mesh of a single
+// vertex format and index type. Meshes are sub-allocated and drawn with a base vertex,
+// so switching between them never changes the bound VAO or buffers.
+class GeometryArena {
+public:
+    // setupAttributes is called with the arena VAO and vertex buffer bound and
+    // must enable/point every attribute of the format
+    GeometryArena(GLsizei vertexStride, GLenum indexType, std::function<void()> setupAttributes);
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // indices are of the arena's index type and relative to the first vertex
+    ArenaRange allocate(const void* vertices, size_t vertexCount, const void* indices, size_t indexCount);
+    // Extra index range over vertices that are already in the arena (LODs)
+    ArenaRange allocateIndices(const void* indices, size_t indexCount, GLint baseVertex);
+
+    GLuint getVAO() const { return vao; }
+    GLsizei getStride() const { return stride; }
+    GLenum getIndexType() const { return indexType; }
+    size_t getVertexCount() const { return vertexCount; }
+    size_t getIndexCount() const { return indexCount; }
+    size_t getBytesUsed() const { return vertexCount * stride + indexCount * ArenaRange::indexSize(indexType); }
+
+private:
+    void create();
+    // Grows to fit, copying what is already uploaded into the new buffers
+    void reserve(size_t vertices, size_t indices);
+
+    GLsizei stride;
+    GLenum indexType;
+    std::function<void()> setupAttributes;
+
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ebo = 0;
+    size_t vertexCapacity = 0;
+    size_t indexCapacity = 0;
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+};
+
+#endif // GEOMETRY_ARENA_H
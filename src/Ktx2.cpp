@@ -0,0 +1,248 @@
+#include "Ktx2.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    const unsigned char IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    struct Header {
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint32_t sgdByteOffset[2]; // uint64 at a 4 byte aligned offset, unused
+        uint32_t sgdByteLength[2];
+    };
+    static_assert(sizeof(Header) == 68, "KTX2 header layout");
+
+    struct LevelIndex {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    const char* ORIENTATION_KEY = "KTXorientation";
+
+    // KHR_DF_MODEL_* of each format
+    uint32_t colorModel(uint32_t vkFormat) {
+        switch (vkFormat) {
+        case Ktx2::BC1_RGB_UNORM:
+        case Ktx2::BC1_RGB_SRGB: return 128;
+        case Ktx2::BC3_UNORM:
+        case Ktx2::BC3_SRGB: return 130;
+        default: return 131; // BC4
+        }
+    }
+
+    bool isSrgb(uint32_t vkFormat) {
+        return vkFormat == Ktx2::BC1_RGB_SRGB || vkFormat == Ktx2::BC3_SRGB;
+    }
+
+    void put32(std::vector<unsigned char>& out, uint32_t v) {
+        for (int i = 0; i < 4; ++i) out.push_back((unsigned char)(v >> (8 * i)));
+    }
+
+    // Basic data format descriptor, required by the spec for every file
+    std::vector<unsigned char> buildDfd(uint32_t vkFormat) {
+        // BC3 describes its alpha and color halves as two samples
+        bool twoSamples = colorModel(vkFormat) == 130;
+        uint32_t samples = twoSamples ? 2 : 1;
+        uint32_t blockSize = 24 + 16 * samples;
+
+        std::vector<unsigned char> dfd;
+        put32(dfd, 4 + blockSize);                // dfdTotalSize
+        put32(dfd, 0);                            // vendorId = Khronos, descriptorType = basic
+        put32(dfd, 2 | (blockSize << 16));        // versionNumber = 2, descriptorBlockSize
+        put32(dfd, colorModel(vkFormat) | (1u << 8) | ((isSrgb(vkFormat) ? 2u : 1u) << 16)); // model, BT709, transfer, flags
+        put32(dfd, 3 | (3 << 8));                 // 4x4x1x1 texel block
+        put32(dfd, (uint32_t)Ktx2::blockBytes(vkFormat)); // bytesPlane0
+        put32(dfd, 0);                            // bytesPlane4..7
+
+        uint32_t bitOffset = 0;
+        for (uint32_t s = 0; s < samples; ++s) {
+            // BC3: alpha block first (channel 15), then color (channel 0)
+            uint32_t channel = (twoSamples && s == 0) ? 15 : 0;
+            put32(dfd, bitOffset | (63u << 16) | (channel << 24));
+            put32(dfd, 0);                        // sample position
+            put32(dfd, 0);                        // sampleLower
+            put32(dfd, 0xFFFFFFFFu);              // sampleUpper
+            bitOffset += 64;
+        }
+        return dfd;
+    }
+
+    std::vector<unsigned char> buildKvd(bool flippedY) {
+        // "ru" = rows go up, the default "rd" is top-down
+        std::string value = flippedY ? "ru" : "rd";
+        std::vector<unsigned char> kvd;
+        uint32_t length = (uint32_t)(std::strlen(ORIENTATION_KEY) + 1 + value.size() + 1);
+        put32(kvd, length);
+        kvd.insert(kvd.end(), ORIENTATION_KEY, ORIENTATION_KEY + std::strlen(ORIENTATION_KEY) + 1);
+        kvd.insert(kvd.end(), value.c_str(), value.c_str() + value.size() + 1);
+        while (kvd.size() % 4) kvd.push_back(0);
+        return kvd;
+    }
+
+    bool readOrientation(const unsigned char* kvd, size_t length) {
+        size_t pos = 0;
+        while (pos + 4 <= length) {
+            uint32_t pairLength;
+            std::memcpy(&pairLength, kvd + pos, 4);
+            pos += 4;
+            if (pos + pairLength > length) break;
+            const char* key = reinterpret_cast<const char*>(kvd + pos);
+            size_t keyLength = strnlen(key, pairLength);
+            if (keyLength < pairLength && std::strcmp(key, ORIENTATION_KEY) == 0) {
+                return pairLength > keyLength + 2 && key[keyLength + 2] == 'u';
+            }
+            pos += (pairLength + 3) & ~3u;
+        }
+        return false;
+    }
+}
+
+size_t Ktx2::blockBytes(uint32_t vkFormat) {
+    return (vkFormat == BC3_UNORM || vkFormat == BC3_SRGB) ? 16 : 8;
+}
+
+size_t Ktx2::levelBytes(uint32_t vkFormat, int width, int height) {
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(vkFormat);
+}
+
+std::string Ktx2::pathFor(const std::string& sourcePath) {
+    return sourcePath + ".ktx2";
+}
+
+bool Ktx2::upToDate(const std::string& sourcePath) {
+    std::error_code ec;
+    auto compressed = std::filesystem::last_write_time(pathFor(sourcePath), ec);
+    if (ec) return false;
+    auto source = std::filesystem::last_write_time(sourcePath, ec);
+    return ec || compressed >= source; // a missing source still has its .ktx2
+}
+
+bool Ktx2::read(const std::string& path, Image& out) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    std::vector<unsigned char> file((size_t)in.tellg());
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(file.data()), file.size());
+    if (!in) return false;
+
+    Header h;
+    if (file.size() < sizeof(IDENTIFIER) + sizeof(Header) || std::memcmp(file.data(), IDENTIFIER, sizeof(IDENTIFIER)) != 0) {
+        std::cerr << "KTX2: " << path << " is not a KTX2 file" << std::endl;
+        return false;
+    }
+    std::memcpy(&h, file.data() + sizeof(IDENTIFIER), sizeof(Header));
+    if (h.vkFormat != BC1_RGB_UNORM && h.vkFormat != BC1_RGB_SRGB &&
+        h.vkFormat != BC3_UNORM && h.vkFormat != BC3_SRGB && h.vkFormat != BC4_UNORM) {
+        std::cerr << "KTX2: " << path << " has unsupported format " << h.vkFormat << std::endl;
+        return false;
+    }
+    if (h.supercompressionScheme != 0 || h.pixelDepth > 1 || h.layerCount > 1 || h.faceCount != 1 || h.levelCount == 0) {
+        std::cerr << "KTX2: " << path << " is not a plain 2D texture" << std::endl;
+        return false;
+    }
+
+    size_t indexOffset = sizeof(IDENTIFIER) + sizeof(Header);
+    if (indexOffset + h.levelCount * sizeof(LevelIndex) > file.size()) return false;
+
+    out.vkFormat = h.vkFormat;
+    out.width = (int)h.pixelWidth;
+    out.height = (int)h.pixelHeight;
+    out.flippedY = h.kvdByteLength > 0 && (size_t)h.kvdByteOffset + h.kvdByteLength <= file.size()
+        && readOrientation(file.data() + h.kvdByteOffset, h.kvdByteLength);
+
+    // copy the levels out back to back, largest first
+    out.levels.clear();
+    out.data.clear();
+    for (uint32_t i = 0; i < h.levelCount; ++i) {
+        LevelIndex level;
+        std::memcpy(&level, file.data() + indexOffset + i * sizeof(LevelIndex), sizeof(LevelIndex));
+        int w = std::max(1, out.width >> i);
+        int hgt = std::max(1, out.height >> i);
+        if (level.byteOffset + level.byteLength > file.size() || level.byteLength != levelBytes(h.vkFormat, w, hgt)) {
+            std::cerr << "KTX2: " << path << " level " << i << " is truncated" << std::endl;
+            return false;
+        }
+        Level l;
+        l.offset = out.data.size();
+        l.size = (size_t)level.byteLength;
+        out.data.insert(out.data.end(), file.begin() + level.byteOffset, file.begin() + level.byteOffset + level.byteLength);
+        out.levels.push_back(l);
+    }
+    return true;
+}
+
+bool Ktx2::write(const std::string& path, const Image& image) {
+    std::vector<unsigned char> dfd = buildDfd(image.vkFormat);
+    std::vector<unsigned char> kvd = buildKvd(image.flippedY);
+
+    Header h{};
+    h.vkFormat = image.vkFormat;
+    h.typeSize = 1;
+    h.pixelWidth = (uint32_t)image.width;
+    h.pixelHeight = (uint32_t)image.height;
+    h.faceCount = 1;
+    h.levelCount = (uint32_t)image.levels.size();
+
+    size_t offset = sizeof(IDENTIFIER) + sizeof(Header) + image.levels.size() * sizeof(LevelIndex);
+    h.dfdByteOffset = (uint32_t)offset;
+    h.dfdByteLength = (uint32_t)dfd.size();
+    offset += dfd.size();
+    h.kvdByteOffset = (uint32_t)offset;
+    h.kvdByteLength = (uint32_t)kvd.size();
+    offset += kvd.size();
+
+    // the spec stores the smallest level first, each aligned to the block size
+    size_t align = blockBytes(image.vkFormat);
+    std::vector<LevelIndex> index(image.levels.size());
+    for (size_t i = image.levels.size(); i-- > 0;) {
+        offset = (offset + align - 1) / align * align;
+        index[i].byteOffset = offset;
+        index[i].byteLength = image.levels[i].size;
+        index[i].uncompressedByteLength = image.levels[i].size;
+        offset += image.levels[i].size;
+    }
+
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(IDENTIFIER), sizeof(IDENTIFIER));
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(LevelIndex));
+        out.write(reinterpret_cast<const char*>(dfd.data()), dfd.size());
+        out.write(reinterpret_cast<const char*>(kvd.data()), kvd.size());
+        size_t written = sizeof(IDENTIFIER) + sizeof(h) + index.size() * sizeof(LevelIndex) + dfd.size() + kvd.size();
+        for (size_t i = image.levels.size(); i-- > 0;) {
+            static const char zeros[16] = {};
+            out.write(zeros, index[i].byteOffset - written);
+            out.write(reinterpret_cast<const char*>(image.data.data() + image.levels[i].offset), image.levels[i].size);
+            written = index[i].byteOffset + image.levels[i].size;
+        }
+        if (!out) return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
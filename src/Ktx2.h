@@ -0,0 +1,51 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Minimal KTX2 container support for the block compressed textures written by
+// tools/texconv: one 2D image, no supercompression, a full mip chain. Reading
+// and writing only, GL upload lives in TextureCache.
+namespace Ktx2 {
+    // VkFormat values of the formats texconv produces
+    enum Format : uint32_t {
+        BC1_RGB_UNORM = 131,
+        BC1_RGB_SRGB = 132,
+        BC3_UNORM = 137,
+        BC3_SRGB = 138,
+        BC4_UNORM = 139,
+    };
+
+    // Bytes per 4x4 block
+    size_t blockBytes(uint32_t vkFormat);
+    // Size of a width x height level, rounded up to whole blocks
+    size_t levelBytes(uint32_t vkFormat, int width, int height);
+
+    struct Level {
+        size_t offset = 0; // into Image::data
+        size_t size = 0;
+    };
+
+    struct Image {
+        uint32_t vkFormat = 0;
+        int width = 0;
+        int height = 0;
+        // rows stored bottom-up, the way stb_image hands them to GL here
+        bool flippedY = false;
+        std::vector<Level> levels; // levels[0] is the full size image
+        std::vector<unsigned char> data;
+    };
+
+    // <source>.ktx2, written next to the source image
+    std::string pathFor(const std::string& sourcePath);
+    // True when the .ktx2 exists and is at least as new as the source
+    bool upToDate(const std::string& sourcePath);
+
+    bool read(const std::string& path, Image& out);
+    bool write(const std::string& path, const Image& image);
+}
+
+#endif // KTX2_H
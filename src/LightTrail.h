@@ -8,6 +8,7 @@
 #include <vector>
 #include <deque>
 #include "Program.h"
+#include "GLStateCache.h"
 
 using namespace glm;
 using namespace std;
@@ -65,7 +66,7 @@ public:
         indices.clear();
 
         glGenVertexArrays(1, &VAO);
-        glBindVertexArray(VAO);
+        GLStateCache::bindVertexArray(VAO);
 
         glGenBuffers(1, &VBO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
@@ -78,7 +79,7 @@ public:
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
 
-        glBindVertexArray(0);
+        GLStateCache::bindVertexArray(0);
     }
 
     void setStartPos(const vec3& pos) {
@@ -243,7 +244,7 @@ public:
         }
 
         // Update the GPU buffers
-        glBindVertexArray(VAO);
+        GLStateCache::bindVertexArray(VAO);
 
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vec3), vertices.data(), GL_DYNAMIC_DRAW);
@@ -251,7 +252,7 @@ public:
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_DYNAMIC_DRAW);
 
-        glBindVertexArray(0);
+        GLStateCache::bindVertexArray(0);
     }
 
     void draw() {
@@ -270,9 +271,9 @@ public:
         //     glUniform4fv(shaderProg->getUniform("trailColor"), 1, value_ptr(trailColor));
         // }
 
-        glBindVertexArray(VAO);
+        GLStateCache::bindVertexArray(VAO);
         glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        GLStateCache::bindVertexArray(0);
 
         // shaderProg->unbind();
     }
@@ -0,0 +1,74 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+void LodSelector::setView(const glm::vec3& cameraPos, const glm::mat4& P, int viewportHeight) {
+    this->cameraPos = cameraPos;
+    // P[1][1] = cot(fovy / 2)
+    pixelScale = P[1][1] * viewportHeight * 0.5f;
+}
+
+void LodSelector::boundingSphere(const AssimpModel* model, const glm::mat4& M, glm::vec3& center, float& radius) {
+    glm::vec3 boxMin = model->getBoundingBoxMin();
+    glm::vec3 boxMax = model->getBoundingBoxMax();
+    center = glm::vec3(M * glm::vec4((boxMin + boxMax) * 0.5f, 1.0f));
+    float scale = std::max(glm::length(glm::vec3(M[0])), std::max(glm::length(glm::vec3(M[1])), glm::length(glm::vec3(M[2]))));
+    radius = glm::length(boxMax - boxMin) * 0.5f * scale;
+}
+
+float LodSelector::screenRadius(const AssimpModel* model, const glm::mat4& M) const {
+    if (pixelScale <= 0.0f) {
+        return 0.0f;
+    }
+
+    glm::vec3 center;
+    float radius;
+    boundingSphere(model, M, center, radius);
+
+    float distance = glm::length(center - cameraPos);
+    if (distance <= radius) {
+        return std::numeric_limits<float>::max(); // camera inside the sphere
+    }
+    return radius * pixelScale / distance;
+}
+
+int LodSelector::levelFor(float radius, int previous, int lodCount) {
+    int level = 0;
+    while (level < lodCount - 1) {
+        float threshold = LOD0_SCREEN_RADIUS / (float)(1 << level);
+        if (previous >= 0) {
+            // harder to leave the level we are already on
+            threshold *= previous > level ? (1.0f + HYSTERESIS) : (1.0f - HYSTERESIS);
+        }
+        if (radius >= threshold) {
+            break;
+        }
+        level++;
+    }
+    return level;
+}
+
+int LodSelector::select(const AssimpModel* model, const glm::mat4& M, size_t key) {
+    int lodCount = model->getLodCount();
+    if (lodCount <= 1 || pixelScale <= 0.0f) {
+        return 0;
+    }
+
+    auto it = history.find(key);
+    int previous = it != history.end() ? it->second : -1;
+    int level = levelFor(screenRadius(model, M), previous, lodCount);
+    history[key] = level;
+    return level;
+}
+
+int LodSelector::select(const AssimpModel* model, const glm::mat4& M) {
+    std::hash<float> hashFloat;
+    size_t key = std::hash<const void*>()(model);
+    for (int i = 0; i < 3; ++i) {
+        key ^= hashFloat(M[3][i]) + 0x9e3779b9 + (key << 6) + (key >> 2);
+    }
+    return select(model, M, key);
+}
@@ -0,0 +1,43 @@
+#ifndef LOD_SELECTOR_H
+#define LOD_SELECTOR_H
+
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+#include "AssimpModel.h"
+
+// Picks a model LOD from the projected size of its bounding sphere. LOD n is
+// used while the sphere covers at least LOD0_SCREEN_RADIUS / 2^n pixels of
+// radius. Each instance remembers its last level and only crosses a threshold
+// once it is HYSTERESIS past it, so objects near a boundary don't flicker.
+class LodSelector {
+public:
+    static constexpr float LOD0_SCREEN_RADIUS = 240.0f;
+    static constexpr float HYSTERESIS = 0.15f;
+
+    // Call once per frame with the camera the LODs are chosen for
+    void setView(const glm::vec3& cameraPos, const glm::mat4& P, int viewportHeight);
+
+    // World space bounding sphere of the model's box under M
+    static void boundingSphere(const AssimpModel* model, const glm::mat4& M, glm::vec3& center, float& radius);
+
+    // Bounding sphere radius in pixels, 0 if no view was set
+    float screenRadius(const AssimpModel* model, const glm::mat4& M) const;
+
+    // key identifies the instance across frames
+    int select(const AssimpModel* model, const glm::mat4& M, size_t key);
+    // For static instances: keyed by model and position
+    int select(const AssimpModel* model, const glm::mat4& M);
+
+    // Level for a radius given the previous level (-1 = none)
+    static int levelFor(float radius, int previous, int lodCount);
+
+    void clearHistory() { history.clear(); }
+
+private:
+    glm::vec3 cameraPos = glm::vec3(0.0f);
+    float pixelScale = 0.0f; // pixels per unit of size at distance 1
+    std::unordered_map<size_t, int> history;
+};
+
+#endif // LOD_SELECTOR_H
@@ -0,0 +1,312 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+void MeshOptimizer::Stats::add(const Stats& other) {
+    verticesBefore += other.verticesBefore;
+    verticesAfter += other.verticesAfter;
+    triangles += other.triangles;
+    transformsBefore += other.transformsBefore;
+    transformsAfter += other.transformsAfter;
+}
+
+size_t MeshOptimizer::simulateCache(const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize) {
+    // FIFO cache, a vertex is resident while its insertion stamp is within cacheSize
+    std::vector<size_t> stamps(vertexCount, 0);
+    size_t time = cacheSize + 1;
+    size_t misses = 0;
+
+    for (unsigned int v : indices) {
+        if (time - stamps[v] > (size_t)cacheSize) {
+            stamps[v] = time++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+namespace {
+    struct VertexBytesHash {
+        size_t operator()(const Vertex& v) const {
+            // FNV-1a over the raw vertex, Vertex has no padding
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&v);
+            size_t h = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(Vertex); ++i) {
+                h = (h ^ bytes[i]) * 1099511628211ull;
+            }
+            return h;
+        }
+    };
+
+    struct VertexBytesEqual {
+        bool operator()(const Vertex& a, const Vertex& b) const {
+            return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+        }
+    };
+}
+
+void MeshOptimizer::weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    std::unordered_map<Vertex, unsigned int, VertexBytesHash, VertexBytesEqual> unique;
+    unique.reserve(vertices.size());
+
+    std::vector<unsigned int> remap(vertices.size());
+    std::vector<Vertex> welded;
+    welded.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        auto it = unique.find(vertices[i]);
+        if (it == unique.end()) {
+            it = unique.emplace(vertices[i], (unsigned int)welded.size()).first;
+            welded.push_back(vertices[i]);
+        }
+        remap[i] = it->second;
+    }
+
+    for (auto& index : indices) {
+        index = remap[index];
+    }
+    vertices.swap(welded);
+}
+
+std::vector<unsigned int> MeshOptimizer::optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize) {
+    std::vector<unsigned int> clusters;
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return clusters;
+    }
+
+    // vertex -> triangle adjacency in CSR form
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (unsigned int v : indices) {
+        liveTriangles[v]++;
+    }
+    std::vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+    }
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i) {
+        adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+    }
+
+    std::vector<size_t> stamps(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+
+    size_t time = cacheSize + 1;
+    size_t cursor = 0;
+    int fanning = indices[0];
+    clusters.push_back(0);
+
+    while (fanning >= 0) {
+        candidates.clear();
+
+        // emit every remaining triangle around the fanning vertex
+        for (unsigned int a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; ++a) {
+            unsigned int t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - stamps[v] > (size_t)cacheSize) {
+                    stamps[v] = time++;
+                }
+            }
+            emitted[t] = true;
+        }
+
+        // next fanning vertex: the candidate that has been in the cache the longest
+        // and will still be there once its remaining triangles are emitted; one
+        // that would be evicted by then still beats leaving the neighbourhood
+        int next = -1;
+        long long best = -1;
+        for (unsigned int v : candidates) {
+            if (liveTriangles[v] == 0) {
+                continue;
+            }
+            long long priority = 0;
+            if (time - stamps[v] + 2 * liveTriangles[v] <= (size_t)cacheSize) {
+                priority = (long long)(time - stamps[v]);
+            }
+            if (priority > best) {
+                best = priority;
+                next = v;
+            }
+        }
+
+        if (next < 0) {
+            // dead end, no candidate has triangles left: back up through
+            // recently used vertices, then scan
+            while (!deadEnd.empty() && next < 0) {
+                unsigned int v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[v] > 0) {
+                    next = v;
+                }
+            }
+            while (next < 0 && cursor < vertexCount) {
+                if (liveTriangles[cursor] > 0) {
+                    next = (int)cursor;
+                }
+                cursor++;
+            }
+            if (next >= 0) {
+                // a hard boundary, the cache is effectively cold again
+                clusters.push_back((unsigned int)(output.size() / 3));
+            }
+        }
+        fanning = next;
+    }
+
+    indices.swap(output);
+    return clusters;
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices,
+    const std::vector<unsigned int>& hardClusters, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || hardClusters.empty()) {
+        return;
+    }
+
+    // split the hard clusters further where the next triangle misses on all
+    // three vertices anyway and the segment so far is about as cache friendly
+    // as the whole cluster, so reordering at that point costs next to nothing
+    std::vector<unsigned int> clusters;
+    std::vector<size_t> stamps(vertices.size(), 0);
+    size_t time = CACHE_SIZE + 1;
+
+    for (size_t c = 0; c < hardClusters.size(); ++c) {
+        unsigned int begin = hardClusters[c];
+        unsigned int end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : (unsigned int)triangleCount;
+
+        std::vector<unsigned int> clusterIndices(indices.begin() + begin * 3, indices.begin() + end * 3);
+        float clusterAcmr = (float)simulateCache(clusterIndices, vertices.size()) / (end - begin);
+
+        clusters.push_back(begin);
+        size_t misses = 0;
+        unsigned int segmentStart = begin;
+        for (unsigned int t = begin; t < end; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = indices[t * 3 + k];
+                if (time - stamps[v] > (size_t)CACHE_SIZE) {
+                    stamps[v] = time++;
+                    misses++;
+                }
+            }
+            unsigned int segmentTriangles = t + 1 - segmentStart;
+            if (t + 1 < end && segmentTriangles >= (unsigned int)CACHE_SIZE
+                && (float)misses / segmentTriangles <= clusterAcmr * threshold) {
+                bool coldTriangle = true;
+                for (int k = 0; k < 3; ++k) {
+                    if (time - stamps[indices[(t + 1) * 3 + k]] <= (size_t)CACHE_SIZE) {
+                        coldTriangle = false;
+                    }
+                }
+                if (!coldTriangle) {
+                    continue;
+                }
+                clusters.push_back(t + 1);
+                segmentStart = t + 1;
+                misses = 0;
+            }
+        }
+    }
+
+    // sort by how much each cluster faces away from the mesh centroid, so
+    // outer surfaces are drawn first and occlude the inner ones
+    glm::vec3 meshCentroid(0.0f);
+    for (const auto& v : vertices) {
+        meshCentroid += v.Position;
+    }
+    meshCentroid /= (float)std::max<size_t>(vertices.size(), 1);
+
+    struct Cluster {
+        unsigned int begin;
+        unsigned int end;
+        float sortKey;
+    };
+    std::vector<Cluster> sorted;
+    sorted.reserve(clusters.size());
+
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        Cluster cluster;
+        cluster.begin = clusters[c];
+        cluster.end = c + 1 < clusters.size() ? clusters[c + 1] : (unsigned int)triangleCount;
+
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (unsigned int t = cluster.begin; t < cluster.end; ++t) {
+            const glm::vec3& p0 = vertices[indices[t * 3 + 0]].Position;
+            const glm::vec3& p1 = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& p2 = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0); // length is twice the area
+            float a = glm::length(n);
+            centroid += (p0 + p1 + p2) * (a / 3.0f);
+            normal += n;
+            area += a;
+        }
+        if (area > 0.0f) {
+            centroid /= area;
+        }
+        float normalLength = glm::length(normal);
+        cluster.sortKey = normalLength > 0.0f ? glm::dot(centroid - meshCentroid, normal / normalLength) : 0.0f;
+        sorted.push_back(cluster);
+    }
+
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    for (const auto& cluster : sorted) {
+        output.insert(output.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+    }
+    indices.swap(output);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+
+    for (auto& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = (unsigned int)ordered.size();
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    // vertices no triangle references are dropped
+    vertices.swap(ordered);
+}
+
+MeshOptimizer::Stats MeshOptimizer::optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    Stats stats;
+    stats.verticesBefore = vertices.size();
+    stats.triangles = indices.size() / 3;
+    stats.transformsBefore = simulateCache(indices, vertices.size());
+
+    weldVertices(vertices, indices);
+    std::vector<unsigned int> clusters = optimizeVertexCache(indices, vertices.size());
+    optimizeOverdraw(indices, vertices, clusters);
+    optimizeVertexFetch(vertices, indices);
+
+    stats.verticesAfter = vertices.size();
+    stats.transformsAfter = simulateCache(indices, vertices.size());
+    return stats;
+}
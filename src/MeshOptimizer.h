@@ -0,0 +1,52 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+
+#include "AssimpMesh.h"
+
+// Load-time index/vertex reordering for AssimpMesh data. Runs once per mesh in
+// AssimpModel::processMesh before the mesh is uploaded:
+//   weld -> vertex cache order (Tipsify) -> overdraw order -> vertex fetch order
+namespace MeshOptimizer {
+    // post-transform cache size assumed by the reordering and the ACMR report
+    constexpr int CACHE_SIZE = 16;
+    // clusters may be this much worse than the cache optimized ACMR before
+    // the overdraw pass starts a new cluster
+    constexpr float OVERDRAW_THRESHOLD = 1.05f;
+
+    struct Stats {
+        size_t verticesBefore = 0;
+        size_t verticesAfter = 0;
+        size_t triangles = 0;
+        // sums of transformed vertices in a simulated FIFO cache, divide by triangles for ACMR
+        size_t transformsBefore = 0;
+        size_t transformsAfter = 0;
+
+        float acmrBefore() const { return triangles ? (float)transformsBefore / triangles : 0.0f; }
+        float acmrAfter() const { return triangles ? (float)transformsAfter / triangles : 0.0f; }
+        void add(const Stats& other);
+    };
+
+    // Vertices transformed by a FIFO cache of cacheSize entries
+    size_t simulateCache(const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize = CACHE_SIZE);
+
+    // Merges bitwise identical vertices and remaps the indices
+    void weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+    // Tipsify (Sander et al. 2007). Returns the cluster boundaries (first
+    // triangle of every cluster), used by optimizeOverdraw.
+    std::vector<unsigned int> optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize = CACHE_SIZE);
+
+    // Sorts the clusters so the ones facing out of the mesh come first
+    void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices,
+        const std::vector<unsigned int>& clusters, float threshold = OVERDRAW_THRESHOLD);
+
+    // Renumbers vertices in first use order so fetches walk memory linearly
+    void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+    // Runs the whole pipeline and returns before/after numbers
+    Stats optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+}
+
+#endif // MESH_OPTIMIZER_H
@@ -0,0 +1,273 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+    // Symmetric 4x4 error quadric, sum of squared distances to a set of planes
+    struct Quadric {
+        double a2 = 0, ab = 0, ac = 0, ad = 0;
+        double b2 = 0, bc = 0, bd = 0;
+        double c2 = 0, cd = 0;
+        double d2 = 0;
+
+        static Quadric fromPlane(const glm::vec3& n, float d) {
+            Quadric q;
+            q.a2 = n.x * n.x; q.ab = n.x * n.y; q.ac = n.x * n.z; q.ad = n.x * d;
+            q.b2 = n.y * n.y; q.bc = n.y * n.z; q.bd = n.y * d;
+            q.c2 = n.z * n.z; q.cd = n.z * d;
+            q.d2 = (double)d * d;
+            return q;
+        }
+
+        Quadric& operator+=(const Quadric& o) {
+            a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+            b2 += o.b2; bc += o.bc; bd += o.bd;
+            c2 += o.c2; cd += o.cd;
+            d2 += o.d2;
+            return *this;
+        }
+
+        double error(const glm::vec3& p) const {
+            double x = p.x, y = p.y, z = p.z;
+            double e = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                + c2 * z * z + 2 * cd * z
+                + d2;
+            return e > 0.0 ? e : 0.0;
+        }
+    };
+
+    struct PositionHash {
+        size_t operator()(const glm::vec3& p) const {
+            uint32_t bits[3];
+            std::memcpy(bits, &p, sizeof(bits));
+            return (size_t)bits[0] * 73856093u ^ (size_t)bits[1] * 19349663u ^ (size_t)bits[2] * 83492791u;
+        }
+    };
+
+    struct PositionEqual {
+        bool operator()(const glm::vec3& a, const glm::vec3& b) const {
+            return std::memcmp(&a, &b, sizeof(glm::vec3)) == 0;
+        }
+    };
+
+    struct Collapse {
+        unsigned int from;
+        unsigned int to;
+        double cost;
+    };
+
+    int dominantBone(const Vertex& v) {
+        int best = 0;
+        for (int i = 1; i < MAX_BONE_INFLUENCE; ++i) {
+            if (v.m_Weights[i] > v.m_Weights[best]) best = i;
+        }
+        return v.m_BoneIDs[best];
+    }
+
+    glm::vec3 triangleNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2) {
+        return glm::cross(p1 - p0, p2 - p0);
+    }
+}
+
+std::vector<unsigned int> MeshSimplifier::simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    size_t targetIndexCount, float maxError, float* outError) {
+    std::vector<unsigned int> result(indices);
+    double worst = 0.0;
+    size_t vertexCount = vertices.size();
+
+    // vertices sharing a position form a group; groups of more than one
+    // vertex are attribute seams
+    std::unordered_map<glm::vec3, unsigned int, PositionHash, PositionEqual> firstAtPosition;
+    std::vector<unsigned int> group(vertexCount);
+    std::vector<unsigned int> groupSize(vertexCount, 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        group[v] = firstAtPosition.emplace(vertices[v].Position, (unsigned int)v).first->second;
+        groupSize[group[v]]++;
+    }
+
+    // open borders: edges between position groups used by a single triangle
+    std::unordered_map<uint64_t, int> edgeUse;
+    for (size_t i = 0; i < result.size(); i += 3) {
+        for (int k = 0; k < 3; ++k) {
+            uint64_t a = group[result[i + k]];
+            uint64_t b = group[result[i + (k + 1) % 3]];
+            edgeUse[std::min(a, b) << 32 | std::max(a, b)]++;
+        }
+    }
+    std::vector<bool> borderGroup(vertexCount, false);
+    for (const auto& edge : edgeUse) {
+        if (edge.second == 1) {
+            borderGroup[edge.first >> 32] = true;
+            borderGroup[edge.first & 0xffffffffu] = true;
+        }
+    }
+
+    std::vector<bool> locked(vertexCount);
+    std::vector<int> bone(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        locked[v] = groupSize[group[v]] > 1 || borderGroup[group[v]];
+        bone[v] = dominantBone(vertices[v]);
+    }
+
+    // plane quadrics, accumulated per position group so seams see both sides
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < result.size(); i += 3) {
+        const glm::vec3& p0 = vertices[result[i + 0]].Position;
+        glm::vec3 n = triangleNormal(p0, vertices[result[i + 1]].Position, vertices[result[i + 2]].Position);
+        float length = glm::length(n);
+        if (length == 0.0f) continue;
+        n = n / length;
+        Quadric q = Quadric::fromPlane(n, -glm::dot(n, p0));
+        for (int k = 0; k < 3; ++k) {
+            quadrics[group[result[i + k]]] += q;
+        }
+    }
+
+    double maxErrorSq = (double)maxError * maxError;
+    std::vector<unsigned int> adjacencyStart(vertexCount + 1);
+    std::vector<unsigned int> adjacency;
+    std::vector<Collapse> candidates;
+    std::vector<unsigned int> collapseTo(vertexCount);
+    std::vector<bool> touched(vertexCount);
+
+    while (result.size() > targetIndexCount) {
+        size_t triangleCount = result.size() / 3;
+
+        // vertex -> triangle adjacency for this pass
+        std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+        for (unsigned int v : result) {
+            adjacencyStart[v + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; ++v) {
+            adjacencyStart[v + 1] += adjacencyStart[v];
+        }
+        adjacency.resize(result.size());
+        std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t i = 0; i < result.size(); ++i) {
+            adjacency[fill[result[i]]++] = (unsigned int)(i / 3);
+        }
+
+        // every collapsible directed edge, cheapest first
+        candidates.clear();
+        for (size_t i = 0; i < result.size(); ++i) {
+            unsigned int from = result[i];
+            if (locked[from]) continue;
+            size_t triangle = i - i % 3;
+            for (int k = 0; k < 3; ++k) {
+                unsigned int to = result[triangle + k];
+                if (group[to] == group[from] || bone[to] != bone[from]) continue;
+                Quadric q = quadrics[group[from]];
+                q += quadrics[group[to]];
+                double cost = q.error(vertices[to].Position);
+                if (cost <= maxErrorSq) {
+                    candidates.push_back({ from, to, cost });
+                }
+            }
+        }
+        if (candidates.empty()) break;
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b) {
+            return a.cost < b.cost;
+        });
+
+        // apply non-overlapping collapses until the target is reached
+        for (size_t v = 0; v < vertexCount; ++v) {
+            collapseTo[v] = (unsigned int)v;
+        }
+        std::fill(touched.begin(), touched.end(), false);
+        size_t removeGoal = triangleCount - targetIndexCount / 3;
+        size_t removed = 0;
+
+        for (const auto& c : candidates) {
+            if (removed >= removeGoal) break;
+            if (touched[c.from] || touched[c.to]) continue;
+
+            // reject collapses that flip or squash a surviving triangle
+            bool valid = true;
+            size_t dying = 0;
+            const glm::vec3& target = vertices[c.to].Position;
+            for (unsigned int a = adjacencyStart[c.from]; a < adjacencyStart[c.from + 1] && valid; ++a) {
+                const unsigned int* tri = &result[adjacency[a] * 3];
+                if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+                    dying++;
+                    continue;
+                }
+                glm::vec3 p[3], moved[3];
+                for (int k = 0; k < 3; ++k) {
+                    p[k] = vertices[tri[k]].Position;
+                    moved[k] = tri[k] == c.from ? target : p[k];
+                }
+                glm::vec3 before = triangleNormal(p[0], p[1], p[2]);
+                glm::vec3 after = triangleNormal(moved[0], moved[1], moved[2]);
+                if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after)) {
+                    valid = false;
+                }
+            }
+            if (!valid) continue;
+
+            collapseTo[c.from] = c.to;
+            for (unsigned int a = adjacencyStart[c.from]; a < adjacencyStart[c.from + 1]; ++a) {
+                const unsigned int* tri = &result[adjacency[a] * 3];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+            }
+            touched[c.to] = true;
+            quadrics[group[c.to]] += quadrics[group[c.from]];
+            removed += dying;
+            worst = std::max(worst, c.cost);
+        }
+        if (removed == 0) break;
+
+        // remap and drop the triangles that became degenerate
+        std::vector<unsigned int> next;
+        next.reserve(result.size());
+        for (size_t i = 0; i < result.size(); i += 3) {
+            unsigned int a = collapseTo[result[i + 0]];
+            unsigned int b = collapseTo[result[i + 1]];
+            unsigned int c = collapseTo[result[i + 2]];
+            if (group[a] == group[b] || group[b] == group[c] || group[a] == group[c]) continue;
+            next.push_back(a);
+            next.push_back(b);
+            next.push_back(c);
+        }
+        result.swap(next);
+    }
+
+    if (outError) {
+        *outError = (float)std::sqrt(worst);
+    }
+    return result;
+}
+
+std::vector<std::vector<unsigned int>> MeshSimplifier::buildLodChain(const std::vector<Vertex>& vertices,
+    const std::vector<unsigned int>& indices, int maxLods) {
+    std::vector<std::vector<unsigned int>> chain;
+    if (indices.size() / 3 < LOD_MIN_TRIANGLES || vertices.empty()) {
+        return chain;
+    }
+
+    glm::vec3 boxMin = vertices[0].Position;
+    glm::vec3 boxMax = vertices[0].Position;
+    for (const auto& v : vertices) {
+        boxMin = glm::min(boxMin, v.Position);
+        boxMax = glm::max(boxMax, v.Position);
+    }
+    float maxError = LOD_MAX_ERROR * glm::length(boxMax - boxMin);
+
+    const std::vector<unsigned int>* previous = &indices;
+    for (int level = 1; level < maxLods; ++level) {
+        size_t target = (size_t)(previous->size() / 3 * LOD_REDUCTION) * 3;
+        std::vector<unsigned int> lod = simplify(vertices, *previous, target, maxError);
+        if (lod.empty() || lod.size() > previous->size() * LOD_MIN_GAIN) {
+            break;
+        }
+        MeshOptimizer::optimizeVertexCache(lod, vertices.size());
+        chain.push_back(std::move(lod));
+        previous = &chain.back();
+    }
+    return chain;
+}
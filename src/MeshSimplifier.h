@@ -0,0 +1,37 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <vector>
+
+#include "AssimpMesh.h"
+
+// Quadric error edge collapse (Garland & Heckbert) working on the index buffer
+// only: a vertex is collapsed onto one of its neighbours, so every LOD reuses
+// the vertex data of LOD0 and only needs its own indices.
+//
+// Vertices on UV seams (same position, different attributes) and on open
+// borders are never moved, and collapses are only allowed between vertices
+// with the same dominant bone, so seams and skinning survive simplification.
+namespace MeshSimplifier {
+    // LOD n targets half the triangles of LOD n-1
+    constexpr float LOD_REDUCTION = 0.5f;
+    // a level that gets less than this far below the previous one ends the chain
+    constexpr float LOD_MIN_GAIN = 0.85f;
+    // meshes smaller than this are not worth a LOD chain
+    constexpr size_t LOD_MIN_TRIANGLES = 256;
+    // largest allowed error as a fraction of the mesh bounding box diagonal
+    constexpr float LOD_MAX_ERROR = 0.05f;
+
+    // Collapses edges until indices has at most targetIndexCount entries or
+    // no collapse stays under maxError (in model units). Returns the new
+    // indices, outError receives the largest error actually introduced.
+    std::vector<unsigned int> simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+        size_t targetIndexCount, float maxError, float* outError = nullptr);
+
+    // Index buffers for LOD1..maxLods-1, each simplified from the previous level
+    // and vertex cache optimized. May return fewer levels (or none).
+    std::vector<std::vector<unsigned int>> buildLodChain(const std::vector<Vertex>& vertices,
+        const std::vector<unsigned int>& indices, int maxLods);
+}
+
+#endif // MESH_SIMPLIFIER_H
@@ -0,0 +1,448 @@
+#include "ModelCache.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const char MAGIC[4] = { 'W', 'L', 'M', 'C' };
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t vertexSize;
+        uint32_t reserved;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+    };
+
+    bool sourceStamp(const std::string& path, uint64_t& size, int64_t& time) {
+        std::error_code ec;
+        size = (uint64_t)std::filesystem::file_size(path, ec);
+        if (ec) return false;
+        auto stamp = std::filesystem::last_write_time(path, ec);
+        if (ec) return false;
+        time = (int64_t)stamp.time_since_epoch().count();
+        return true;
+    }
+
+    // Read-only view of a whole file: mmap where available, otherwise read
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string& path) {
+#ifndef _WIN32
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return;
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+                void* mapped = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped != MAP_FAILED) {
+                    bytes = static_cast<const unsigned char*>(mapped);
+                    length = (size_t)st.st_size;
+                }
+            }
+            ::close(fd);
+#else
+            std::ifstream in(path, std::ios::binary | std::ios::ate);
+            if (!in) return;
+            buffer.resize((size_t)in.tellg());
+            in.seekg(0);
+            in.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+            bytes = buffer.data();
+            length = buffer.size();
+#endif
+        }
+
+        ~MappedFile() {
+#ifndef _WIN32
+            if (bytes) ::munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const unsigned char* data() const { return bytes; }
+        size_t size() const { return length; }
+
+    private:
+        const unsigned char* bytes = nullptr;
+        size_t length = 0;
+#ifdef _WIN32
+        std::vector<unsigned char> buffer;
+#endif
+    };
+
+    class Writer {
+    public:
+        explicit Writer(std::ofstream& out) : out(out) {}
+
+        template <typename T>
+        void value(const T& v) { out.write(reinterpret_cast<const char*>(&v), sizeof(T)); }
+
+        template <typename T>
+        void array(const std::vector<T>& v) {
+            value((uint64_t)v.size());
+            out.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+        }
+
+        void string(const std::string& s) {
+            value((uint32_t)s.size());
+            out.write(s.data(), s.size());
+        }
+
+        void node(const AssimpNodeData& n) {
+            string(n.name);
+            value(n.transformation);
+            value((uint32_t)n.children.size());
+            for (const auto& child : n.children) {
+                node(child);
+            }
+        }
+
+    private:
+        std::ofstream& out;
+    };
+
+    // Whole triangles whose indices all name one of the mesh's vertices, so a
+    // corrupt cache can't send the GPU past the mesh or overflow 16-bit indices
+    bool validTriangles(const std::vector<unsigned int>& indices, size_t vertexCount) {
+        if (indices.size() % 3 != 0) return false;
+        for (unsigned int index : indices) {
+            if (index >= vertexCount) return false;
+        }
+        return true;
+    }
+
+    // Smallest encoding of each record the file counts, as Writer lays it out
+    constexpr size_t MIN_STRING_BYTES = sizeof(uint32_t);
+    constexpr size_t MIN_ARRAY_BYTES = sizeof(uint64_t);
+    constexpr size_t MIN_MESH_BYTES = 2 * MIN_ARRAY_BYTES + 2 * sizeof(uint32_t); // LOD and texture counts
+    constexpr size_t MIN_TEXTURE_BYTES = 2 * MIN_STRING_BYTES;
+    constexpr size_t MIN_BONE_BYTES = MIN_STRING_BYTES + sizeof(int32_t) + sizeof(glm::mat4);
+    constexpr size_t MIN_NODE_BYTES = MIN_STRING_BYTES + sizeof(glm::mat4) + sizeof(uint32_t);
+    constexpr size_t MIN_ANIMATION_BYTES = MIN_STRING_BYTES + 2 * sizeof(float) + sizeof(uint32_t);
+    constexpr size_t MIN_CHANNEL_BYTES = MIN_STRING_BYTES + 3 * MIN_ARRAY_BYTES;
+
+    // Bounds checked reads out of the mapping; any overrun, or a count the
+    // rest of the file can't hold, marks the whole file bad
+    class Reader {
+    public:
+        Reader(const unsigned char* data, size_t size) : data(data), size(size) {}
+
+        bool ok() const { return good; }
+
+        template <typename T>
+        T value() {
+            T v{};
+            if (take(sizeof(T))) std::memcpy(&v, data + offset - sizeof(T), sizeof(T));
+            return v;
+        }
+
+        // Number of records of at least minBytes each that follow; 0 when the
+        // rest of the file is too short for them
+        uint32_t count(size_t minBytes) {
+            uint32_t n = value<uint32_t>();
+            if (!good || n > (size - offset) / minBytes) {
+                good = false;
+                return 0;
+            }
+            return n;
+        }
+
+        template <typename T>
+        void array(std::vector<T>& v) {
+            uint64_t count = value<uint64_t>();
+            if (!good || count > (size - offset) / sizeof(T)) {
+                good = false;
+                return;
+            }
+            v.resize((size_t)count);
+            std::memcpy(v.data(), data + offset, (size_t)count * sizeof(T));
+            offset += (size_t)count * sizeof(T);
+        }
+
+        template <typename T>
+        void skipArray() {
+            uint64_t count = value<uint64_t>();
+            if (!good || count > (size - offset) / sizeof(T)) {
+                good = false;
+                return;
+            }
+            offset += (size_t)count * sizeof(T);
+        }
+
+        std::string string() {
+            uint32_t length = value<uint32_t>();
+            if (!take(length)) return std::string();
+            return std::string(reinterpret_cast<const char*>(data + offset - length), length);
+        }
+
+        void node(AssimpNodeData& n, int depth = 0) {
+            n.name = string();
+            n.transformation = value<glm::mat4>();
+            uint32_t childCount = count(MIN_NODE_BYTES);
+            if (!good || depth > 256) {
+                good = false;
+                return;
+            }
+            n.childrenCount = (int)childCount;
+            n.children.resize(childCount);
+            for (auto& child : n.children) {
+                node(child, depth + 1);
+                if (!good) return;
+            }
+        }
+
+    private:
+        bool take(size_t bytes) {
+            if (!good || bytes > size - offset) {
+                good = false;
+                return false;
+            }
+            offset += bytes;
+            return true;
+        }
+
+        const unsigned char* data;
+        size_t size;
+        size_t offset = 0;
+        bool good = true;
+    };
+}
+
+std::string ModelCache::cachePath(const std::string& sourcePath) {
+    return sourcePath + ".bake";
+}
+
+BakedChannel ModelCache::bakeChannel(const aiNodeAnim* channel) {
+    BakedChannel baked;
+    baked.name = channel->mNodeName.C_Str();
+
+    for (unsigned int i = 0; i < channel->mNumPositionKeys; ++i) {
+        KeyPosition key;
+        key.position = AssimpGLMHelpers::GetGLMVec(channel->mPositionKeys[i].mValue);
+        key.timeStamp = (float)channel->mPositionKeys[i].mTime;
+        baked.positions.push_back(key);
+    }
+    for (unsigned int i = 0; i < channel->mNumRotationKeys; ++i) {
+        KeyRotation key;
+        key.orientation = AssimpGLMHelpers::GetGLMQuat(channel->mRotationKeys[i].mValue);
+        key.timeStamp = (float)channel->mRotationKeys[i].mTime;
+        baked.rotations.push_back(key);
+    }
+    for (unsigned int i = 0; i < channel->mNumScalingKeys; ++i) {
+        KeyScale key;
+        key.scale = AssimpGLMHelpers::GetGLMVec(channel->mScalingKeys[i].mValue);
+        key.timeStamp = (float)channel->mScalingKeys[i].mTime;
+        baked.scales.push_back(key);
+    }
+    return baked;
+}
+
+BakedAnimation ModelCache::bakeAnimation(const aiAnimation* animation) {
+    BakedAnimation baked;
+    baked.name = animation->mName.C_Str();
+    baked.duration = (float)animation->mDuration;
+    baked.ticksPerSecond = (float)animation->mTicksPerSecond;
+    for (unsigned int i = 0; i < animation->mNumChannels; ++i) {
+        baked.channels.push_back(bakeChannel(animation->mChannels[i]));
+    }
+    return baked;
+}
+
+bool ModelCache::save(const std::string& sourcePath, const BakedModel& model) {
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.vertexSize = sizeof(Vertex);
+    header.reserved = 0;
+    int64_t sourceTime = 0;
+    if (!sourceStamp(sourcePath, header.sourceSize, sourceTime)) {
+        return false;
+    }
+    header.sourceTime = sourceTime;
+
+    // write to a temporary file and rename, a crash never leaves a torn cache
+    std::string path = cachePath(sourcePath);
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Model cache: cannot write " << tempPath << std::endl;
+            return false;
+        }
+        Writer w(out);
+        w.value(header);
+
+        w.value(model.boxMin);
+        w.value(model.boxMax);
+        w.value((uint32_t)model.meshes.size());
+        for (const auto& mesh : model.meshes) {
+            w.array(mesh.vertices);
+            w.array(mesh.indices);
+            w.value((uint32_t)mesh.lodIndices.size());
+            for (const auto& lod : mesh.lodIndices) {
+                w.array(lod);
+            }
+        }
+        // texture references after the bulk data so load(withMeshes = false)
+        // can skip every mesh array in one pass
+        for (const auto& mesh : model.meshes) {
+            w.value((uint32_t)mesh.textures.size());
+            for (const auto& texture : mesh.textures) {
+                w.string(texture.type);
+                w.string(texture.path);
+            }
+        }
+
+        w.value((int32_t)model.boneCounter);
+        w.value((uint32_t)model.boneInfo.size());
+        for (const auto& bone : model.boneInfo) {
+            w.string(bone.first);
+            w.value((int32_t)bone.second.id);
+            w.value(bone.second.offset);
+        }
+
+        w.node(model.rootNode);
+        w.value(model.globalInverseTransform);
+
+        w.value((uint32_t)model.animations.size());
+        for (const auto& animation : model.animations) {
+            w.string(animation.name);
+            w.value(animation.duration);
+            w.value(animation.ticksPerSecond);
+            w.value((uint32_t)animation.channels.size());
+            for (const auto& channel : animation.channels) {
+                w.string(channel.name);
+                w.array(channel.positions);
+                w.array(channel.rotations);
+                w.array(channel.scales);
+            }
+        }
+
+        if (!out) {
+            std::cerr << "Model cache: write failed for " << tempPath << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool ModelCache::load(const std::string& sourcePath, BakedModel& out, bool withMeshes) {
+    MappedFile file(cachePath(sourcePath));
+    if (!file.data() || file.size() < sizeof(Header)) {
+        return false;
+    }
+
+    Reader r(file.data(), file.size());
+    Header header = r.value<Header>();
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION
+        || header.vertexSize != sizeof(Vertex)
+        || !sourceStamp(sourcePath, sourceSize, sourceTime)
+        || header.sourceSize != sourceSize || header.sourceTime != sourceTime) {
+        std::cout << "Model cache: " << cachePath(sourcePath) << " is stale" << std::endl;
+        return false;
+    }
+
+    out = BakedModel();
+    out.boxMin = r.value<glm::vec3>();
+    out.boxMax = r.value<glm::vec3>();
+    uint32_t meshCount = r.count(MIN_MESH_BYTES);
+    if (!r.ok()) return false;
+
+    out.meshes.resize(meshCount);
+    for (auto& mesh : out.meshes) {
+        if (withMeshes) {
+            r.array(mesh.vertices);
+            r.array(mesh.indices);
+        }
+        else {
+            r.skipArray<Vertex>();
+            r.skipArray<unsigned int>();
+        }
+        uint32_t lodCount = r.value<uint32_t>();
+        if (!r.ok() || lodCount > MESH_MAX_LODS) return false;
+        mesh.lodIndices.resize(withMeshes ? lodCount : 0);
+        for (uint32_t lod = 0; lod < lodCount; ++lod) {
+            if (withMeshes) r.array(mesh.lodIndices[lod]);
+            else r.skipArray<unsigned int>();
+        }
+        if (!withMeshes || !r.ok()) continue;
+
+        bool valid = validTriangles(mesh.indices, mesh.vertices.size());
+        for (const auto& lod : mesh.lodIndices) {
+            valid = valid && validTriangles(lod, mesh.vertices.size());
+        }
+        if (!valid) {
+            std::cerr << "Model cache: " << cachePath(sourcePath) << " has indices outside its meshes" << std::endl;
+            return false;
+        }
+    }
+    for (auto& mesh : out.meshes) {
+        uint32_t textureCount = r.count(MIN_TEXTURE_BYTES);
+        if (!r.ok()) return false;
+        mesh.textures.resize(textureCount);
+        for (auto& texture : mesh.textures) {
+            texture.id = 0;
+            texture.type = r.string();
+            texture.path = r.string();
+        }
+    }
+
+    out.boneCounter = r.value<int32_t>();
+    uint32_t boneCount = r.count(MIN_BONE_BYTES);
+    for (uint32_t i = 0; i < boneCount && r.ok(); ++i) {
+        std::string name = r.string();
+        BoneInfo info;
+        info.id = r.value<int32_t>();
+        info.offset = r.value<glm::mat4>();
+        out.boneInfo[name] = info;
+    }
+
+    r.node(out.rootNode);
+    out.globalInverseTransform = r.value<glm::mat4>();
+
+    uint32_t animationCount = r.count(MIN_ANIMATION_BYTES);
+    if (!r.ok()) return false;
+    out.animations.resize(animationCount);
+    for (auto& animation : out.animations) {
+        animation.name = r.string();
+        animation.duration = r.value<float>();
+        animation.ticksPerSecond = r.value<float>();
+        uint32_t channelCount = r.count(MIN_CHANNEL_BYTES);
+        if (!r.ok()) return false;
+        animation.channels.resize(channelCount);
+        for (auto& channel : animation.channels) {
+            channel.name = r.string();
+            r.array(channel.positions);
+            r.array(channel.rotations);
+            r.array(channel.scales);
+        }
+    }
+
+    if (!r.ok()) {
+        std::cerr << "Model cache: " << cachePath(sourcePath) << " is truncated" << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "AssimpMesh.h"
+#include "Animation.h"
+#include "Bone.h"
+
+// Everything AssimpModel and Animation build from an Assimp import, in the
+// final form they use it (optimized vertices, LOD indices, converted keys).
+struct BakedMesh {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<std::vector<unsigned int>> lodIndices; // LOD1 and up
+    std::vector<AssimpTexture> textures; // ids are reloaded from path
+};
+
+struct BakedChannel {
+    std::string name;
+    std::vector<KeyPosition> positions;
+    std::vector<KeyRotation> rotations;
+    std::vector<KeyScale> scales;
+};
+
+struct BakedAnimation {
+    std::string name;
+    float duration = 0.0f;
+    float ticksPerSecond = 0.0f;
+    std::vector<BakedChannel> channels;
+};
+
+struct BakedModel {
+    glm::vec3 boxMin = glm::vec3(0.0f);
+    glm::vec3 boxMax = glm::vec3(0.0f);
+    std::vector<BakedMesh> meshes;
+    std::map<std::string, BoneInfo> boneInfo;
+    int boneCounter = 0;
+    AssimpNodeData rootNode;
+    glm::mat4 globalInverseTransform = glm::mat4(1.0f);
+    std::vector<BakedAnimation> animations;
+};
+
+// Versioned binary cache written next to each source asset (<path>.bake) the
+// first time it is imported. Later runs memory-map the file and copy the
+// arrays straight out of it instead of running Assimp. A cache is stale when
+// the version, the source size/timestamp or sizeof(Vertex) don't match.
+namespace ModelCache {
+    // Bump whenever the baked data would change: file layout, MeshOptimizer,
+    // MeshSimplifier or the import post-processing flags.
+    constexpr unsigned int VERSION = 1;
+
+    std::string cachePath(const std::string& sourcePath);
+
+    // false when there is no usable cache. withMeshes = false skips the vertex
+    // and index data, for loaders that only want the animations.
+    bool load(const std::string& sourcePath, BakedModel& out, bool withMeshes = true);
+    bool save(const std::string& sourcePath, const BakedModel& model);
+
+    // Converts an Assimp channel the same way Bone's constructor does
+    BakedChannel bakeChannel(const aiNodeAnim* channel);
+    BakedAnimation bakeAnimation(const aiAnimation* animation);
+}
+
+#endif // MODEL_CACHE_H
@@ -0,0 +1,99 @@
+#include "OcclusionQueryPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+OcclusionQueryPool::~OcclusionQueryPool() {
+    for (auto& slot : slots) {
+        releaseSlot(slot);
+    }
+}
+
+void OcclusionQueryPool::releaseSlot(Slot& slot) {
+    if (slot.queries[0] != 0) {
+        glDeleteQueries(FRAMES_IN_FLIGHT, slot.queries);
+    }
+}
+
+void OcclusionQueryPool::resize(int slotCount) {
+    assert(activeSlot < 0);
+
+    for (int i = slotCount; i < (int)slots.size(); ++i) {
+        releaseSlot(slots[i]);
+    }
+
+    int oldCount = std::min((int)slots.size(), slotCount);
+    slots.resize(slotCount);
+
+    for (int i = 0; i < oldCount; ++i) {
+        Slot& slot = slots[i];
+        std::fill(std::begin(slot.pending), std::end(slot.pending), false);
+        slot.resultFrame = -1;
+        slot.visible = true;
+    }
+
+    for (int i = oldCount; i < slotCount; ++i) {
+        glGenQueries(FRAMES_IN_FLIGHT, slots[i].queries);
+    }
+}
+
+void OcclusionQueryPool::beginFrame() {
+    frameCount++;
+    ringIndex = (ringIndex + 1) % FRAMES_IN_FLIGHT;
+
+    for (auto& slot : slots) {
+        // walk the ring oldest -> newest so the freshest finished result wins
+        for (int k = 0; k < FRAMES_IN_FLIGHT; ++k) {
+            int r = (ringIndex + k) % FRAMES_IN_FLIGHT;
+            if (!slot.pending[r]) {
+                continue;
+            }
+
+            GLuint available = 0;
+            glGetQueryObjectuiv(slot.queries[r], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                // results arrive in order, nothing newer can be ready either
+                break;
+            }
+
+            GLuint samplesPassed = 0;
+            glGetQueryObjectuiv(slot.queries[r], GL_QUERY_RESULT, &samplesPassed);
+            slot.pending[r] = false;
+            slot.visible = samplesPassed != 0;
+            slot.resultFrame = slot.issuedFrame[r];
+        }
+
+        // this entry is about to be reused; if the GPU is still behind, drop it
+        slot.pending[ringIndex] = false;
+    }
+}
+
+void OcclusionQueryPool::beginQuery(int slot) {
+    assert(activeSlot < 0 && slot >= 0 && slot < (int)slots.size());
+
+    Slot& s = slots[slot];
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, s.queries[ringIndex]);
+    s.pending[ringIndex] = true;
+    s.issuedFrame[ringIndex] = frameCount;
+    activeSlot = slot;
+}
+
+void OcclusionQueryPool::endQuery() {
+    assert(activeSlot >= 0);
+
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+    activeSlot = -1;
+}
+
+bool OcclusionQueryPool::isVisible(int slot) const {
+    if (slot < 0 || slot >= (int)slots.size()) {
+        return true;
+    }
+
+    const Slot& s = slots[slot];
+    if (s.resultFrame < 0 || frameCount - s.resultFrame > 2 * FRAMES_IN_FLIGHT) {
+        return true; // never tested or stale
+    }
+    return s.visible;
+}
@@ -0,0 +1,64 @@
+#ifndef OCCLUSION_QUERY_POOL_H
+#define OCCLUSION_QUERY_POOL_H
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Node in the occlusion hierarchy. A node is only tested (and its contents only
+// drawn) while its parent is visible, e.g. boss room region -> boss room chunk.
+struct OcclusionNode {
+    glm::vec3 boxMin;
+    glm::vec3 boxMax;
+    int parent = -1; // index of the parent node, -1 for a root region
+    int slot = -1;   // query slot in the OcclusionQueryPool
+};
+
+// Ring of GL_ANY_SAMPLES_PASSED queries, one query object per slot per frame in
+// flight. Results are harvested with GL_QUERY_RESULT_AVAILABLE a few frames after
+// they were issued, so the CPU never waits on the GPU to drain the pipeline.
+class OcclusionQueryPool {
+    public:
+        static constexpr int FRAMES_IN_FLIGHT = 3;
+
+        OcclusionQueryPool() = default;
+        ~OcclusionQueryPool();
+
+        OcclusionQueryPool(const OcclusionQueryPool&) = delete;
+        OcclusionQueryPool& operator=(const OcclusionQueryPool&) = delete;
+
+        // Grows or shrinks the pool for a new set of boxes. Slots keep their
+        // query objects but drop every result and query in flight, which
+        // belonged to the old boxes, so they read as never tested.
+        void resize(int slotCount);
+        int getSlotCount() const { return (int)slots.size(); }
+
+        // Call once per frame before any query is issued: reads back every
+        // finished query and advances the ring
+        void beginFrame();
+
+        void beginQuery(int slot);
+        void endQuery();
+
+        // Last known result. Slots that were never tested, or whose result is
+        // older than the ring, report visible so nothing pops in late.
+        bool isVisible(int slot) const;
+
+    private:
+        struct Slot {
+            GLuint queries[FRAMES_IN_FLIGHT] = {};
+            bool pending[FRAMES_IN_FLIGHT] = {};
+            long long issuedFrame[FRAMES_IN_FLIGHT] = {};
+            long long resultFrame = -1; // frame the current result was issued in
+            bool visible = true;
+        };
+
+        void releaseSlot(Slot& slot);
+
+        std::vector<Slot> slots;
+        int ringIndex = 0;
+        long long frameCount = 0;
+        int activeSlot = -1;
+};
+
+#endif // OCCLUSION_QUERY_POOL_H
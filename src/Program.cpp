@@ -3,8 +3,12 @@
 #include <iostream>
 #include <cassert>
 #include <fstream>
+#include <algorithm>
+#include <cstring>
 
 #include "GLSL.h"
+#include "GLStateCache.h"
+#include "ProgramCache.h"
 
 
 std::string readFileAsString(const std::string &fileName)
@@ -34,17 +38,90 @@ void Program::setShaderNames(const std::string &v, const std::string &f)
 	fShaderName = f;
 }
 
+namespace
+{
+	std::string variantName(unsigned features)
+	{
+		std::string name;
+		for (int i = 0; i < FEATURE_COUNT; ++i)
+		{
+			if (features & (1u << i))
+			{
+				name += (name.empty() ? "" : "_") + std::string(SHADER_FEATURE_DEFINES[i]);
+			}
+		}
+		return name;
+	}
+
+	// The feature #defines go right after #version; #line keeps compiler
+	// messages on the file's own line numbers
+	std::string withDefines(const std::string &source, unsigned features)
+	{
+		if (features == 0)
+		{
+			return source;
+		}
+		std::string defines;
+		for (int i = 0; i < FEATURE_COUNT; ++i)
+		{
+			if (features & (1u << i))
+			{
+				defines += std::string("#define ") + SHADER_FEATURE_DEFINES[i] + "\n";
+			}
+		}
+
+		size_t version = source.find("#version");
+		size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+		if (lineEnd == std::string::npos)
+		{
+			return defines + "#line 1\n" + source;
+		}
+		int nextLine = (int)std::count(source.begin(), source.begin() + lineEnd, '\n') + 2;
+		return source.substr(0, lineEnd + 1) + defines + "#line " + std::to_string(nextLine) + "\n" + source.substr(lineEnd + 1);
+	}
+}
+
 bool Program::init()
+{
+	// Read shader sources
+	std::string vShaderString = readFileAsString(vShaderName);
+	std::string fShaderString = readFileAsString(fShaderName);
+
+	// one program per subset of the permutation mask
+	variants.assign(permutable + 1, Variant());
+	for (unsigned bits = 0; bits <= permutable; ++bits)
+	{
+		if ((bits & ~permutable) || variantBits(bits) != bits)
+		{
+			continue;
+		}
+		GLuint pid = link(withDefines(vShaderString, bits), withDefines(fShaderString, bits), variantName(bits));
+		if (!pid)
+		{
+			return false;
+		}
+		variants[bits].pid = pid;
+		resolveHandles(variants[bits]);
+	}
+
+	return true;
+}
+
+GLuint Program::link(const std::string &vShaderString, const std::string &fShaderString, const std::string &variant)
 {
 	GLint rc;
 
+	// A binary from an earlier run skips compiling and linking
+	GLuint pid = ProgramCache::load(vShaderName, fShaderName, variant, vShaderString, fShaderString);
+	if (pid)
+	{
+		return pid;
+	}
+	std::string suffix = variant.empty() ? "" : " (" + variant + ")";
+
 	// Create shader handles
 	GLuint VS = glCreateShader(GL_VERTEX_SHADER);
 	GLuint FS = glCreateShader(GL_FRAGMENT_SHADER);
-
-	// Read shader sources
-	std::string vShaderString = readFileAsString(vShaderName);
-	std::string fShaderString = readFileAsString(fShaderName);
 	const char *vshader = vShaderString.c_str();
 	const char *fshader = fShaderString.c_str();
 	CHECKED_GL_CALL(glShaderSource(VS, 1, &vshader, NULL));
@@ -58,9 +135,9 @@ bool Program::init()
 		if (isVerbose())
 		{
 			GLSL::printShaderInfoLog(VS);
-			std::cout << "Error compiling vertex shader " << vShaderName << std::endl;
+			std::cout << "Error compiling vertex shader " << vShaderName << suffix << std::endl;
 		}
-		return false;
+		return 0;
 	}
 
 	// Compile fragment shader
@@ -71,15 +148,19 @@ bool Program::init()
 		if (isVerbose())
 		{
 			GLSL::printShaderInfoLog(FS);
-			std::cout << "Error compiling fragment shader " << fShaderName << std::endl;
+			std::cout << "Error compiling fragment shader " << fShaderName << suffix << std::endl;
 		}
-		return false;
+		return 0;
 	}
 
 	// Create the program and link
 	pid = glCreateProgram();
 	CHECKED_GL_CALL(glAttachShader(pid, VS));
 	CHECKED_GL_CALL(glAttachShader(pid, FS));
+	if (ProgramCache::supported())
+	{
+		CHECKED_GL_CALL(glProgramParameteri(pid, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+	}
 	CHECKED_GL_CALL(glLinkProgram(pid));
 	CHECKED_GL_CALL(glGetProgramiv(pid, GL_LINK_STATUS, &rc));
 	if (!rc)
@@ -87,36 +168,158 @@ bool Program::init()
 		if (isVerbose())
 		{
 			GLSL::printProgramInfoLog(pid);
-			std::cout << "Error linking shaders " << vShaderName << " and " << fShaderName << std::endl;
+			std::cout << "Error linking shaders " << vShaderName << " and " << fShaderName << suffix << std::endl;
 		}
-		return false;
+		return 0;
 	}
 
-	return true;
+	// the program keeps the binary, a permutation set would pile up shader objects
+	CHECKED_GL_CALL(glDetachShader(pid, VS));
+	CHECKED_GL_CALL(glDetachShader(pid, FS));
+	glDeleteShader(VS);
+	glDeleteShader(FS);
+
+	ProgramCache::save(pid, vShaderName, fShaderName, variant, vShaderString, fShaderString);
+	return pid;
+}
+
+void Program::resolveHandles(Variant &variant)
+{
+	GLuint pid = variant.pid;
+	for (int i = 0; i < (int)UniformId::COUNT; ++i)
+	{
+		variant.handles[i] = glGetUniformLocation(pid, UNIFORM_ID_NAMES[i]);
+	}
+
+	// Shared blocks always live on the same binding points
+	GLuint block = glGetUniformBlockIndex(pid, FRAME_DATA_BLOCK);
+	if (block != GL_INVALID_INDEX)
+	{
+		CHECKED_GL_CALL(glUniformBlockBinding(pid, block, FRAME_DATA_BINDING));
+	}
+	block = glGetUniformBlockIndex(pid, MATERIAL_DATA_BLOCK);
+	if (block != GL_INVALID_INDEX)
+	{
+		CHECKED_GL_CALL(glUniformBlockBinding(pid, block, MATERIAL_DATA_BINDING));
+	}
 }
 
 void Program::bind()
 {
-	CHECKED_GL_CALL(glUseProgram(pid));
+	Variant &v = active();
+	CHECKED_GL_CALL(GLStateCache::useProgram(v.pid));
+	sendStale(v);
 }
 
 void Program::unbind()
 {
-	CHECKED_GL_CALL(glUseProgram(0));
+	CHECKED_GL_CALL(GLStateCache::useProgram(0));
+}
+
+void Program::setFeatures(unsigned featureBits)
+{
+	unsigned previous = variantBits(features);
+	features = featureBits;
+	if (variantBits(featureBits) == previous)
+	{
+		return;
+	}
+	// swap the bound permutation, it gets whatever uniforms it missed
+	if (GLStateCache::boundProgram() == variants[previous].pid)
+	{
+		bind();
+	}
+}
+
+void Program::store(UniformId id, ValueType type, const void *values, int count)
+{
+	Carried &c = carried[(int)id];
+	c.type = type;
+	c.count = count;
+	c.data.resize((size_t)count * (type == ValueType::Mat4 ? 16 : 1));
+	std::memcpy(c.data.data(), values, c.data.size() * sizeof(float));
+	c.version = nextVersion++;
+}
+
+void Program::send(Variant &variant, UniformId id)
+{
+	const Carried &c = carried[(int)id];
+	GLint location = variant.handles[(int)id];
+	variant.sent[(int)id] = c.version;
+	if (location < 0)
+	{
+		return;
+	}
+	switch (c.type)
+	{
+	case ValueType::Int:
+		glUniform1iv(location, c.count, reinterpret_cast<const GLint *>(c.data.data()));
+		break;
+	case ValueType::Float:
+		glUniform1fv(location, c.count, c.data.data());
+		break;
+	case ValueType::Mat4:
+		glUniformMatrix4fv(location, c.count, GL_FALSE, c.data.data());
+		break;
+	}
+}
+
+void Program::sendStale(Variant &variant)
+{
+	for (int i = 0; i < (int)UniformId::COUNT; ++i)
+	{
+		if (carried[i].version != 0 && variant.sent[i] != carried[i].version)
+		{
+			send(variant, (UniformId)i);
+		}
+	}
+}
+
+void Program::setUniform(UniformId id, const GLint *values, int count)
+{
+	static_assert(sizeof(GLint) == sizeof(float), "ints are carried in float storage");
+	store(id, ValueType::Int, values, count);
+	bind();
+}
+
+void Program::setUniform(UniformId id, float value)
+{
+	store(id, ValueType::Float, &value, 1);
+	bind();
+}
+
+void Program::setUniform(UniformId id, const glm::mat4 *values, int count)
+{
+	store(id, ValueType::Mat4, values, count);
+	bind();
 }
 
 void Program::addAttribute(const std::string &name)
 {
-	attributes[name] = GLSL::getAttribLocation(pid, name.c_str(), isVerbose());
+	// permutations may compile a name out, only the plain program warns
+	for (size_t bits = 0; bits < variants.size(); ++bits)
+	{
+		if (variants[bits].pid)
+		{
+			variants[bits].attributes[name] = GLSL::getAttribLocation(variants[bits].pid, name.c_str(), isVerbose() && bits == 0);
+		}
+	}
 }
 
 void Program::addUniform(const std::string &name)
 {
-	uniforms[name] = GLSL::getUniformLocation(pid, name.c_str(), isVerbose());
+	for (size_t bits = 0; bits < variants.size(); ++bits)
+	{
+		if (variants[bits].pid)
+		{
+			variants[bits].uniforms[name] = GLSL::getUniformLocation(variants[bits].pid, name.c_str(), isVerbose() && bits == 0);
+		}
+	}
 }
 
 GLint Program::getAttribute(const std::string &name) const
 {
+	const std::map<std::string, GLint> &attributes = active().attributes;
 	std::map<std::string, GLint>::const_iterator attribute = attributes.find(name.c_str());
 	if (attribute == attributes.end())
 	{
@@ -130,6 +333,7 @@ GLint Program::getAttribute(const std::string &name) const
 }
 
 GLint Program::getUniform(const std::string &name) const {
+	const std::map<std::string, GLint> &uniforms = active().uniforms;
 	std::map<std::string, GLint>::const_iterator uniform = uniforms.find(name.c_str());
 	if (uniform == uniforms.end())
 	{
@@ -143,6 +347,7 @@ GLint Program::getUniform(const std::string &name) const {
 }
 
 bool Program::hasUniform(const std::string& name) const {
+	const std::map<std::string, GLint> &uniforms = active().uniforms;
 	std::map<std::string, GLint>::const_iterator uniform = uniforms.find(name.c_str());
 	if (uniform == uniforms.end()) {
 		return false;
@@ -6,31 +6,87 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "UniformBlocks.h"
 
 
 std::string readFileAsString(const std::string &fileName);
 
+// Features a shader can be specialized for. Each bit is a #define injected
+// after the #version line, so a permutation only contains the code its draws
+// use instead of branching on bool uniforms.
+enum ShaderFeature : unsigned
+{
+	FEATURE_SKINNED = 1 << 0,   // bone palette skinning
+	FEATURE_MATERIAL = 1 << 1,  // MaterialData colors as the fallback of the texture maps
+	FEATURE_TEX_ONLY = 1 << 2,  // every term straight from the texture maps
+	FEATURE_INSTANCED = 1 << 3, // model matrix from the per-instance attribute
+	FEATURE_BAKED = 1 << 4,     // with SKINNED: bones from a baked clip texture (AnimationBaker)
+	FEATURE_COUNT = 5
+};
+
+constexpr const char* SHADER_FEATURE_DEFINES[FEATURE_COUNT] = {
+	"SKINNED",
+	"MATERIAL",
+	"TEX_ONLY",
+	"INSTANCED",
+	"BAKED",
+};
+
 class Program
 {
 
 public:
 
+	Program()
+	{
+		variants.resize(1);
+	}
+
 	void setVerbose(const bool v) { verbose = v; }
 	bool isVerbose() const { return verbose; }
 
 	void setShaderNames(const std::string &v, const std::string &f);
+	// Features to build permutations for, call before init(); init() then
+	// links one program per subset of the mask
+	void setPermutations(unsigned featureMask) { permutable = featureMask; }
 	virtual bool init();
 	virtual void bind();
 	virtual void unbind();
 
+	// Selects the permutation for the next draws, rebinding if the program is
+	// bound. Features outside the permutation mask are ignored. The selection
+	// persists like uniform state did, until changed again.
+	void setFeatures(unsigned featureBits);
+	void setFeature(ShaderFeature feature, bool enabled)
+	{
+		setFeatures(enabled ? (features | feature) : (features & ~(unsigned)feature));
+	}
+	unsigned getFeatures() const { return features; }
+	bool supports(ShaderFeature feature) const { return (permutable & feature) != 0; }
+
 	void addAttribute(const std::string &name);
 	void addUniform(const std::string &name);
 	GLint getAttribute(const std::string &name) const;
 	GLint getUniform(const std::string &name) const;
 	bool Program::hasUniform(const std::string& name) const;
-	GLuint getPid() const { return pid; }
+	GLuint getPid() const { return active().pid; }
+
+	// Pre-resolved locations, -1 when the shader doesn't declare the uniform
+	GLint getUniform(UniformId id) const { return active().handles[(int)id]; }
+	bool hasUniform(UniformId id) const { return active().handles[(int)id] >= 0; }
+
+	// Binds the program and sets the uniform on the current permutation; the
+	// value is remembered and sent to other permutations when they get selected
+	void setUniform(UniformId id, GLint value) { setUniform(id, &value, 1); }
+	void setUniform(UniformId id, const GLint* values, int count);
+	void setUniform(UniformId id, float value);
+	void setUniform(UniformId id, const glm::mat4& value) { setUniform(id, &value, 1); }
+	void setUniform(UniformId id, const glm::mat4* values, int count);
 
 protected:
 
@@ -39,11 +95,55 @@ protected:
 
 private:
 
-	GLuint pid = 0;
-	std::map<std::string, GLint> attributes;
-	std::map<std::string, GLint> uniforms;
+	struct Variant
+	{
+		GLuint pid = 0;
+		std::map<std::string, GLint> attributes;
+		std::map<std::string, GLint> uniforms;
+		GLint handles[(int)UniformId::COUNT];
+		unsigned sent[(int)UniformId::COUNT]; // version of the carried value it has
+
+		Variant()
+		{
+			for (GLint& h : handles) h = -1;
+			for (unsigned& v : sent) v = 0;
+		}
+	};
+
+	enum class ValueType { Int, Float, Mat4 };
+
+	// last value set through setUniform, per id
+	struct Carried
+	{
+		unsigned version = 0; // 0: never set
+		ValueType type = ValueType::Float;
+		int count = 0;
+		std::vector<float> data; // ints stored bit for bit
+	};
+
+	std::vector<Variant> variants; // indexed by feature bits, pid 0 if not built
+	unsigned permutable = 0;
+	unsigned features = 0;
+	Carried carried[(int)UniformId::COUNT];
+	unsigned nextVersion = 1;
 	bool verbose = true;
 
+	const Variant& active() const { return variants[variantBits(features)]; }
+	Variant& active() { return variants[variantBits(features)]; }
+	// Permutation a feature selection draws with: BAKED only exists on top of
+	// SKINNED, so those combinations aren't linked on their own
+	unsigned variantBits(unsigned featureBits) const
+	{
+		unsigned bits = featureBits & permutable;
+		return (bits & FEATURE_SKINNED) ? bits : bits & ~(unsigned)FEATURE_BAKED;
+	}
+
+	GLuint link(const std::string& vSource, const std::string& fSource, const std::string& variantName);
+	void resolveHandles(Variant& variant);
+	void store(UniformId id, ValueType type, const void* values, int count);
+	void send(Variant& variant, UniformId id);
+	void sendStale(Variant& variant);
+
 };
 
 #endif // LAB471_PROGRAM_H_INCLUDED
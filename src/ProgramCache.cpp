@@ -0,0 +1,165 @@
+#include "ProgramCache.h"
+#include "Config.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+    const char MAGIC[4] = { 'W', 'L', 'P', 'B' };
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceHash;
+        uint64_t driverHash;
+        uint32_t binaryFormat;
+        uint32_t binaryLength;
+    };
+
+    uint64_t fnv1a(const void* data, size_t bytes, uint64_t hash = 14695981039346656037ull) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < bytes; ++i) {
+            hash = (hash ^ p[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    uint64_t sourceHash(const std::string& vSource, const std::string& fSource) {
+        // the separator keeps "ab"+"c" and "a"+"bc" apart
+        uint64_t hash = fnv1a(vSource.data(), vSource.size());
+        hash = fnv1a("\0", 1, hash);
+        return fnv1a(fSource.data(), fSource.size(), hash);
+    }
+
+    // binaries are only valid for the driver build that produced them
+    uint64_t driverHash() {
+        static uint64_t hash = [] {
+            uint64_t h = fnv1a(nullptr, 0);
+            for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+                const char* s = reinterpret_cast<const char*>(glGetString(name));
+                if (s) h = fnv1a(s, std::strlen(s), h);
+                h = fnv1a("\0", 1, h);
+            }
+            return h;
+        }();
+        return hash;
+    }
+
+    std::string stem(const std::string& path) {
+        return std::filesystem::path(path).stem().string();
+    }
+}
+
+bool ProgramCache::supported() {
+    static bool formats = [] {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+        if (count == 0) {
+            std::cout << "Program cache: driver has no binary formats, compiling from source" << std::endl;
+        }
+        return count > 0;
+    }();
+    return Config::USE_PROGRAM_CACHE && formats;
+}
+
+std::string ProgramCache::cachePath(const std::string& vShaderName, const std::string& fShaderName, const std::string& variant) {
+    std::filesystem::path dir = std::filesystem::path(vShaderName).parent_path();
+    std::string name = stem(vShaderName) + "+" + stem(fShaderName);
+    if (!variant.empty()) {
+        name += "." + variant;
+    }
+    return (dir / (name + ".progbin")).string();
+}
+
+GLuint ProgramCache::load(const std::string& vShaderName, const std::string& fShaderName, const std::string& variant,
+    const std::string& vSource, const std::string& fSource) {
+    if (!supported()) {
+        return 0;
+    }
+    std::string path = cachePath(vShaderName, fShaderName, variant);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return 0;
+    }
+
+    Header header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return 0;
+    }
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION
+        || header.sourceHash != sourceHash(vSource, fSource) || header.driverHash != driverHash()) {
+        std::cout << "Program cache: " << path << " is stale" << std::endl;
+        return 0;
+    }
+
+    std::vector<char> binary(header.binaryLength);
+    if (!in.read(binary.data(), binary.size())) {
+        std::cerr << "Program cache: " << path << " is truncated" << std::endl;
+        return 0;
+    }
+
+    GLuint pid = glCreateProgram();
+    glProgramBinary(pid, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+    GLint linked = GL_FALSE;
+    glGetProgramiv(pid, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        // the driver changed in a way its version string didn't show
+        std::cout << "Program cache: driver rejected " << path << ", compiling from source" << std::endl;
+        glDeleteProgram(pid);
+        return 0;
+    }
+    return pid;
+}
+
+bool ProgramCache::save(GLuint pid, const std::string& vShaderName, const std::string& fShaderName, const std::string& variant,
+    const std::string& vSource, const std::string& fSource) {
+    if (!supported()) {
+        return false;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(pid, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return false;
+    }
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(pid, length, &length, &format, binary.data());
+
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.sourceHash = sourceHash(vSource, fSource);
+    header.driverHash = driverHash();
+    header.binaryFormat = format;
+    header.binaryLength = (uint32_t)length;
+
+    // write to a temporary file and rename, a crash never leaves a torn binary
+    std::string path = cachePath(vShaderName, fShaderName, variant);
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Program cache: cannot write " << tempPath << std::endl;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(binary.data(), length);
+        if (!out) {
+            std::cerr << "Program cache: write failed for " << tempPath << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,31 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <string>
+#include <glad/glad.h>
+
+// Linked program binaries saved next to the shaders
+// (<vert>+<frag>[.<permutation>].progbin) so later runs skip compiling and
+// linking. A binary only loads when the hash
+// of both sources and of the driver (vendor, renderer, version) matches; the
+// driver may still reject it after an update, then Program compiles from
+// source and saves a fresh one.
+namespace ProgramCache {
+    // Bump when the file layout changes
+    constexpr unsigned int VERSION = 1;
+
+    // variant names the permutation, empty for the plain program
+    std::string cachePath(const std::string& vShaderName, const std::string& fShaderName, const std::string& variant);
+
+    // A linked program, or 0 when there is no binary or the driver rejected it
+    GLuint load(const std::string& vShaderName, const std::string& fShaderName, const std::string& variant,
+        const std::string& vSource, const std::string& fSource);
+    // pid must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    bool save(GLuint pid, const std::string& vShaderName, const std::string& fShaderName, const std::string& variant,
+        const std::string& vSource, const std::string& fSource);
+
+    // False when the driver offers no binary formats, nothing is cached then
+    bool supported();
+}
+
+#endif // PROGRAM_CACHE_H
@@ -0,0 +1,86 @@
+#include "Skeleton.h"
+#include "Animation.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+Skeleton Skeleton::compile(const AssimpNodeData& root, const std::map<std::string, BoneInfo>& boneInfo,
+    const std::vector<std::string>& channelNames) {
+    std::unordered_map<std::string, int> channelOf;
+    for (int i = 0; i < (int)channelNames.size(); ++i) {
+        channelOf.emplace(channelNames[i], i); // keeps the first
+    }
+
+    Skeleton s;
+    // explicit stack, children pushed in reverse so the order matches the old recursion
+    std::vector<std::pair<const AssimpNodeData*, int>> stack = { { &root, -1 } };
+    while (!stack.empty()) {
+        const AssimpNodeData* node = stack.back().first;
+        int parent = stack.back().second;
+        stack.pop_back();
+
+        int index = (int)s.parents.size();
+        s.parents.push_back(parent);
+        s.bindLocal.push_back(node->transformation);
+        glm::vec3 position, scale;
+        glm::quat rotation;
+        Bone::DecomposeTRS(node->transformation, position, rotation, scale);
+        s.bindPositions.push_back(position);
+        s.bindRotations.push_back(rotation);
+        s.bindScales.push_back(scale);
+
+        auto channel = channelOf.find(node->name);
+        s.channels.push_back(channel != channelOf.end() ? channel->second : -1);
+
+        auto bone = boneInfo.find(node->name);
+        if (bone != boneInfo.end()) {
+            s.boneSlots.push_back(bone->second.id);
+            s.offsets.push_back(bone->second.offset);
+            s.boneSlotCount = std::max(s.boneSlotCount, bone->second.id + 1);
+        }
+        else {
+            s.boneSlots.push_back(-1);
+            s.offsets.push_back(glm::mat4(1.0f));
+        }
+
+        for (int i = node->childrenCount - 1; i >= 0; --i) {
+            stack.push_back({ &node->children[i], index });
+        }
+    }
+    return s;
+}
+
+Skeleton Skeleton::reduced(int maxBoneDepth) const {
+    Skeleton r;
+    r.boneSlotCount = boneSlotCount;
+    std::vector<int> depth(size());      // bones on the path from the root, minus one
+    std::vector<int> remap(size(), -1);  // index in r, -1 if dropped
+    std::vector<int> keptSlot(size(), -1); // closest kept bone slot at or above the node
+    for (size_t i = 0; i < size(); ++i) {
+        int parent = parents[i];
+        depth[i] = (parent < 0 ? -1 : depth[parent]) + (boneSlots[i] >= 0 ? 1 : 0);
+        int inherited = parent < 0 ? -1 : keptSlot[parent];
+        bool keep = (parent < 0 || remap[parent] >= 0) && depth[i] <= maxBoneDepth;
+        if (!keep) {
+            keptSlot[i] = inherited;
+            if (boneSlots[i] >= 0 && inherited >= 0) {
+                r.copySlots.push_back(boneSlots[i]);
+                r.copyFrom.push_back(inherited);
+            }
+            continue;
+        }
+
+        remap[i] = (int)r.size();
+        r.parents.push_back(parent < 0 ? -1 : remap[parent]);
+        r.bindLocal.push_back(bindLocal[i]);
+        r.bindPositions.push_back(bindPositions[i]);
+        r.bindRotations.push_back(bindRotations[i]);
+        r.bindScales.push_back(bindScales[i]);
+        r.channels.push_back(channels[i]);
+        r.boneSlots.push_back(boneSlots[i]);
+        r.offsets.push_back(offsets[i]);
+        keptSlot[i] = boneSlots[i] >= 0 ? boneSlots[i] : inherited;
+    }
+    return r;
+}
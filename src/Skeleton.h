@@ -0,0 +1,51 @@
+#ifndef SKELETON_H
+#define SKELETON_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "AssimpModel.h"
+
+struct AssimpNodeData;
+class Bone;
+
+// An Animation's node hierarchy flattened once into parallel arrays, in
+// depth-first order so every parent comes before its children. Evaluating a
+// pose is then a single forward loop over these arrays: no recursion, no
+// name lookups and no allocations.
+struct Skeleton {
+    std::vector<int> parents;          // -1 for the root
+    std::vector<glm::mat4> bindLocal;  // node transform when no channel drives it
+    std::vector<glm::vec3> bindPositions; // bindLocal as TRS, for blended poses
+    std::vector<glm::quat> bindRotations;
+    std::vector<glm::vec3> bindScales;
+    std::vector<int> channels;         // index into the animation's bones, -1 if not animated
+    std::vector<int> boneSlots;        // index into the final bone matrices, -1 if not a bone
+    std::vector<glm::mat4> offsets;    // model space -> bone space, where boneSlots >= 0
+    int boneSlotCount = 0;             // one past the highest slot
+    // reduced skeletons: slots of dropped bones and the kept ancestor slot each copies
+    std::vector<int> copySlots;
+    std::vector<int> copyFrom;
+
+    size_t size() const { return parents.size(); }
+    // Same hierarchy writing the same bone slots, so poses of the two line
+    // up node for node and can be blended
+    bool sameRig(const Skeleton& other) const {
+        return this == &other || (parents == other.parents && boneSlots == other.boneSlots);
+    }
+
+    // Far animation LOD: nodes more than maxBoneDepth bones below the first
+    // bone are dropped (fingers, toe tips), their slots follow the closest
+    // kept ancestor bone rigidly
+    Skeleton reduced(int maxBoneDepth) const;
+
+    // channelNames[i] is the node driven by bones[i]; the first channel of a
+    // name wins, as Animation::FindBone did
+    static Skeleton compile(const AssimpNodeData& root, const std::map<std::string, BoneInfo>& boneInfo,
+        const std::vector<std::string>& channelNames);
+};
+
+#endif // SKELETON_H
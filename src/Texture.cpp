@@ -1,5 +1,6 @@
 #include "Texture.h"
 #include "GLSL.h"
+#include "GLStateCache.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
@@ -10,72 +11,63 @@ using namespace std;
 
 Texture::Texture() :
 	filename(""),
+	width(0),
+	height(0),
 	tid(0)
 {
-	
+	sampler.wrapS = GL_CLAMP_TO_EDGE;
+	sampler.wrapT = GL_CLAMP_TO_EDGE;
 }
 
 Texture::~Texture()
 {
-	
+	TextureCache::release(tid);
 }
 
 void Texture::init()
 {
-	// Load texture
-	int w, h, ncomps;
 	stbi_set_flip_vertically_on_load(true);
-	unsigned char *data = stbi_load(filename.c_str(), &w, &h, &ncomps, 0);
-	if(!data) {
+	decode();
+	upload();
+}
+
+void Texture::decode()
+{
+	// Load texture, the .ktx2 from texconv when there is an up to date one
+	if(!TextureCache::decode(filename, image)) {
 		cerr << filename << " not found" << endl;
 	}
-	if(ncomps != 3) {
-		cerr << filename << " must have 3 components (RGB)" << endl;
-	}
-	if((w & (w - 1)) != 0 || (h & (h - 1)) != 0) {
-		cerr << filename << " must be a power of 2" << endl;
-	}
-	width = w;
-	height = h;
+	width = image.width;
+	height = image.height;
+}
 
-	// Generate a texture buffer object
-	glGenTextures(1, &tid);
-	// Bind the current texture to be the newly generated texture object
-	glBindTexture(GL_TEXTURE_2D, tid);
-	// Load the actual texture data
-	// Base level is 0, number of channels is 3, and border is 0.
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-	// Generate image pyramid
-	glGenerateMipmap(GL_TEXTURE_2D);
-	// Set texture wrap modes for the S and T directions
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	// Set filtering mode for magnification and minimification
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	// Unbind
-	glBindTexture(GL_TEXTURE_2D, 0);
+void Texture::upload()
+{
+	// Shared with every other Texture or model map holding the same pixels
+	// and sampler state, see TextureCache.h
+	tid = TextureCache::acquire(image, sampler);
 	// Free image, since the data is now on the GPU
-	stbi_image_free(data);
+	image.pixels.reset();
 }
 
 void Texture::setWrapModes(GLint wrapS, GLint wrapT)
 {
-	// Must be called after init()
-	glBindTexture(GL_TEXTURE_2D, tid);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapS);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT);
+	TextureSampler wanted = sampler;
+	wanted.wrapS = wrapS;
+	wanted.wrapT = wrapT;
+	if(tid && !TextureCache::setSampler(tid, wanted)) {
+		return;
+	}
+	sampler = wanted;
 }
 
 void Texture::bind(GLint handle)
 {
-	glActiveTexture(GL_TEXTURE0 + unit);
-	glBindTexture(GL_TEXTURE_2D, tid);
+	GLStateCache::bindTexture(unit, tid);
 	glUniform1i(handle, unit);
 }
 
 void Texture::unbind()
 {
-	glActiveTexture(GL_TEXTURE0 + unit);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLStateCache::bindTexture(unit, 0);
 }
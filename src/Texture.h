@@ -4,6 +4,7 @@
 
 #include <glad/glad.h>
 #include <string>
+#include "TextureCache.h"
 
 class Texture
 {
@@ -12,18 +13,26 @@ public:
 	virtual ~Texture();
 	void setFilename(const std::string &f) { filename = f; }
 	void init();
+	// init() in two halves for AssetLoader: decode() only reads the file and
+	// is safe on a worker thread, upload() does the GL part on the main thread
+	void decode();
+	void upload();
 	void setUnit(GLint u) { unit = u; }
 	GLint getUnit() const { return unit; }
 	void bind(GLint handle);
 	void unbind();
-	void setWrapModes(GLint wrapS, GLint wrapT); // Must be called after init()
+	// Part of the TextureCache key, so best set before init(); afterwards it
+	// only applies when no other Texture shares the same image
+	void setWrapModes(GLint wrapS, GLint wrapT);
 	GLint getID() const { return tid;}
 private:
 	std::string filename;
 	int width;
 	int height;
-	GLuint tid;
+	GLuint tid; // a TextureCache reference
 	GLint unit;
+	TextureSampler sampler;
+	DecodedImage image; // between decode() and upload()
 	
 };
 
@@ -0,0 +1,302 @@
+#include "TextureCache.h"
+#include "GLStateCache.h"
+#include "TextureStreamer.h"
+#include "Config.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "stb_image.h"
+
+// S3TC is an extension in core profiles, but every desktop driver has it
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+namespace {
+    // written once on the GL thread before any loading, read by decoders
+    std::atomic<bool> s3tcSupported{ false };
+    std::atomic<bool> s3tcSrgbSupported{ false };
+
+    bool readCompressed(const std::string& filename, DecodedImage& out) {
+        Ktx2::Image image;
+        if (!Ktx2::read(Ktx2::pathFor(filename), image)) {
+            return false;
+        }
+        if (!image.flippedY) {
+            // stb_image loads are flipped for GL here, texconv writes them that way
+            std::cerr << "Texture: " << Ktx2::pathFor(filename) << " is stored top-down, using the source image" << std::endl;
+            return false;
+        }
+
+        auto data = std::make_shared<std::vector<unsigned char>>(std::move(image.data));
+        out.width = image.width;
+        out.height = image.height;
+        out.channels = image.vkFormat == Ktx2::BC4_UNORM ? 1 : (Ktx2::blockBytes(image.vkFormat) == 16 ? 4 : 3);
+        out.compressedFormat = image.vkFormat;
+        out.levels = std::move(image.levels);
+        out.byteSize = data->size();
+        out.pixels = std::shared_ptr<unsigned char>(data, data->data());
+        out.contentHash = TextureCache::contentHash(out.pixels.get(), out.byteSize, out.width, out.height, (int)out.compressedFormat);
+        return true;
+    }
+}
+
+void TextureCache::detectCompressedFormats() {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (!name) continue;
+        if (std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0) s3tcSupported = true;
+        if (std::strcmp(name, "GL_EXT_texture_sRGB") == 0) s3tcSrgbSupported = true;
+    }
+    std::cout << "Texture cache: compressed textures " << (s3tcSupported ? "enabled" : "unsupported, loading source images") << std::endl;
+}
+
+bool TextureCache::decode(const std::string& filename, DecodedImage& out) {
+    out.filename = filename;
+    if (Config::USE_COMPRESSED_TEXTURES && s3tcSupported && Ktx2::upToDate(filename) && readCompressed(filename, out)) {
+        return true;
+    }
+
+    unsigned char* data = stbi_load(filename.c_str(), &out.width, &out.height, &out.channels, 0);
+    if (!data) {
+        return false;
+    }
+    out.pixels.reset(data, stbi_image_free);
+    out.byteSize = (size_t)out.width * out.height * out.channels;
+    out.contentHash = contentHash(data, out.byteSize, out.width, out.height, out.channels);
+    return true;
+}
+
+uint64_t TextureCache::contentHash(const unsigned char* pixels, size_t bytes, int width, int height, int channels) {
+    // FNV-1a over 8-byte words, with the dimensions mixed in so a 2x8 and a
+    // 4x4 image of the same bytes don't collide
+    const uint64_t prime = 1099511628211ull;
+    uint64_t h = 14695981039346656037ull;
+    h = (h ^ (uint64_t)width) * prime;
+    h = (h ^ (uint64_t)height) * prime;
+    h = (h ^ (uint64_t)channels) * prime;
+
+    size_t words = bytes / 8;
+    for (size_t i = 0; i < words; ++i) {
+        uint64_t w;
+        std::memcpy(&w, pixels + i * 8, 8);
+        h = (h ^ w) * prime;
+    }
+    for (size_t i = words * 8; i < bytes; ++i) {
+        h = (h ^ pixels[i]) * prime;
+    }
+    return h ? h : 1; // 0 means "not computed"
+}
+
+GLuint TextureCache::acquire(const DecodedImage& image, const TextureSampler& sampler) {
+    if (!image.pixels) {
+        return 0; // failed decode, materials fall back to TextureManager's 1x1 maps
+    }
+
+    TextureCache& c = get();
+    size_t bytes = image.byteSize ? image.byteSize : (size_t)image.width * image.height * image.channels;
+    uint64_t hash = image.contentHash ? image.contentHash
+        : contentHash(image.pixels.get(), bytes, image.width, image.height, image.channels);
+
+    Key key{ hash, sampler };
+    auto found = c.byKey.find(key);
+    if (found != c.byKey.end()) {
+        GLuint id = found->second;
+        Entry& e = c.entries[id];
+        e.hits++;
+        c.uploadedBytesSaved += e.bytes;
+        retain(id);
+        if (Config::DEBUG_TEX_LOADING) {
+            std::cout << "Texture cache hit: " << image.filename << " -> " << e.name << std::endl;
+        }
+        return id;
+    }
+
+    GLuint id;
+    glGenTextures(1, &id);
+    GLStateCache::bindTexture(0, id);
+
+    GLenum internalFormat, format;
+    formatsFor(image, sampler.srgb, internalFormat, format);
+    size_t residentBytes = image.compressedFormat ? image.byteSize
+        // RGB is padded to RGBA by drivers, the mip chain adds a third
+        : (size_t)image.width * image.height * (image.channels == 3 ? 4 : image.channels) * 4 / 3;
+    size_t sourceBytes = image.compressedFormat ? image.byteSize : (size_t)image.width * image.height * image.channels;
+
+    if (Config::STREAM_TEXTURES && TextureStreamer::enabled() && sourceBytes >= (size_t)Config::TEXTURE_STREAM_MIN_KB * 1024
+        && TextureStreamer::stream(id, image, sampler)) {
+        // contents arrive over the next frames, see TextureStreamer::update
+    }
+    else if (image.compressedFormat) {
+        // precomputed mips, straight to the driver without conversion
+        for (size_t level = 0; level < image.levels.size(); ++level) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, internalFormat,
+                std::max(1, image.width >> level), std::max(1, image.height >> level), 0,
+                (GLsizei)image.levels[level].size, image.pixels.get() + image.levels[level].offset);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+    }
+    else {
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get());
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    // the streamer may have bound another texture
+    GLStateCache::bindTexture(0, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler.wrapS);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler.wrapT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+
+    Entry e;
+    e.key = key;
+    e.name = image.filename;
+    e.width = image.width;
+    e.height = image.height;
+    e.channels = image.channels;
+    e.compressed = image.compressedFormat != 0;
+    e.bytes = residentBytes;
+    e.refs = 1;
+    c.entries[id] = e;
+    c.byKey[key] = id;
+    c.resident += e.bytes;
+    return id;
+}
+
+void TextureCache::formatsFor(const DecodedImage& image, bool srgb, GLenum& internalFormat, GLenum& format) {
+    format = 0;
+    if (image.compressedFormat) {
+        srgb = srgb && s3tcSrgbSupported;
+        switch (image.compressedFormat) {
+        case Ktx2::BC1_RGB_UNORM: internalFormat = srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT; break;
+        case Ktx2::BC1_RGB_SRGB: internalFormat = GL_COMPRESSED_SRGB_S3TC_DXT1_EXT; break;
+        case Ktx2::BC3_UNORM: internalFormat = srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+        case Ktx2::BC3_SRGB: internalFormat = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT; break;
+        default: internalFormat = GL_COMPRESSED_RED_RGTC1; // BC4, core since 3.0
+        }
+    }
+    else if (image.channels == 1) {
+        format = GL_RED;
+        internalFormat = GL_RED;
+    }
+    else if (image.channels == 4) {
+        format = GL_RGBA;
+        internalFormat = srgb ? GL_SRGB_ALPHA : GL_RGBA;
+    }
+    else {
+        if (image.channels != 3) {
+            std::cout << "Unusual number of components in image: " << image.channels << std::endl;
+        }
+        format = GL_RGB;
+        internalFormat = srgb ? GL_SRGB : GL_RGB;
+    }
+}
+
+void TextureCache::retain(GLuint id) {
+    TextureCache& c = get();
+    auto it = c.entries.find(id);
+    if (it == c.entries.end()) {
+        return;
+    }
+    Entry& e = it->second;
+    if (e.refs++ == 0) {
+        c.unused.erase(e.unusedIt);
+        c.unusedBytes -= e.bytes;
+    }
+}
+
+void TextureCache::release(GLuint id) {
+    TextureCache& c = get();
+    auto it = c.entries.find(id);
+    if (it == c.entries.end() || it->second.refs <= 0) {
+        return;
+    }
+    Entry& e = it->second;
+    if (--e.refs == 0) {
+        e.unusedIt = c.unused.insert(c.unused.end(), id);
+        c.unusedBytes += e.bytes;
+        c.trimUnused((size_t)Config::TEXTURE_CACHE_UNUSED_MB << 20);
+    }
+}
+
+bool TextureCache::setSampler(GLuint id, const TextureSampler& sampler) {
+    TextureCache& c = get();
+    auto it = c.entries.find(id);
+    if (it == c.entries.end()) {
+        return false;
+    }
+    Entry& e = it->second;
+    Key key{ e.key.hash, sampler };
+    if (!(e.key.sampler < sampler) && !(sampler < e.key.sampler)) {
+        return true;
+    }
+    if (e.refs > 1 || c.byKey.count(key)) {
+        std::cerr << "Texture cache: " << e.name << " is shared, sampler state left unchanged" << std::endl;
+        return false;
+    }
+
+    c.byKey.erase(e.key);
+    e.key = key;
+    c.byKey[key] = id;
+
+    GLStateCache::bindTexture(0, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler.wrapS);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler.wrapT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+    return true;
+}
+
+void TextureCache::evict(GLuint id) {
+    auto it = entries.find(id);
+    Entry& e = it->second;
+    unused.erase(e.unusedIt);
+    unusedBytes -= e.bytes;
+    resident -= e.bytes;
+    byKey.erase(e.key);
+    entries.erase(it);
+
+    // the texture may still be bound on some unit or streaming in
+    TextureStreamer::cancel(id);
+    GLStateCache::invalidate();
+    glDeleteTextures(1, &id);
+}
+
+void TextureCache::trimUnused(size_t budget) {
+    while (unusedBytes > budget && !unused.empty()) {
+        evict(unused.front());
+    }
+}
+
+void TextureCache::evictUnused() {
+    TextureCache& c = get();
+    size_t before = c.resident;
+    c.trimUnused(0);
+    std::cout << "Texture cache: evicted " << (before - c.resident) / 1024 << " KB of unused textures" << std::endl;
+}
+
+void TextureCache::report() {
+    TextureCache& c = get();
+    std::vector<const Entry*> sorted;
+    for (const auto& entry : c.entries) {
+        sorted.push_back(&entry.second);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b) { return a->bytes > b->bytes; });
+
+    std::cout << "Texture cache: " << sorted.size() << " textures, " << c.resident / (1024 * 1024) << " MB resident, "
+        << c.uploadedBytesSaved / (1024 * 1024) << " MB of duplicate uploads avoided" << std::endl;
+    for (const Entry* e : sorted) {
+        std::cout << "  " << std::setw(8) << e->bytes / 1024 << " KB  " << e->width << "x" << e->height << "x" << e->channels
+            << (e->compressed ? " BCn" : "") << "  refs " << e->refs << "  hits " << e->hits << "  " << e->name << std::endl;
+    }
+}
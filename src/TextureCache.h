@@ -0,0 +1,138 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <glad/glad.h>
+
+#include "Ktx2.h"
+
+// An image read into memory but not uploaded yet, see AssetLoader.h
+struct DecodedImage {
+    std::string filename;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::shared_ptr<unsigned char> pixels; // null when decoding failed
+    uint64_t contentHash = 0; // TextureCache::contentHash of the pixels, 0 = not computed yet
+
+    // Set when pixels hold a block compressed mip chain from a .ktx2 instead
+    // of RGBA8 rows; levels index into pixels, largest first
+    uint32_t compressedFormat = 0; // Ktx2::Format
+    std::vector<Ktx2::Level> levels;
+    size_t byteSize = 0;
+};
+
+// Sampler parameters baked into the texture object, part of the cache key
+struct TextureSampler {
+    GLint wrapS = GL_REPEAT;
+    GLint wrapT = GL_REPEAT;
+    GLint minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLint magFilter = GL_LINEAR;
+    bool srgb = false;
+
+    bool operator<(const TextureSampler& o) const {
+        return std::tie(wrapS, wrapT, minFilter, magFilter, srgb) < std::tie(o.wrapS, o.wrapT, o.minFilter, o.magFilter, o.srgb);
+    }
+};
+
+// Process-wide GL texture cache keyed by (pixel content hash, sampler). Two
+// models pointing at copies of the same image under different paths get one
+// texture. Entries are reference counted; once unreferenced they stay around
+// (a later load may want them back) until the unused ones pass
+// Config::TEXTURE_CACHE_UNUSED_MB, oldest first, or evictUnused() is called.
+// GL thread only.
+class TextureCache {
+public:
+    // Reads an image for acquire(), safe on any thread. Prefers an up to date
+    // <filename>.ktx2 from texconv (Config::USE_COMPRESSED_TEXTURES, and only
+    // once detectCompressedFormats() found driver support), else stb_image.
+    static bool decode(const std::string& filename, DecodedImage& out);
+    // Checks for S3TC support, call once on the GL thread before loading
+    static void detectCompressedFormats();
+
+    // Returns a texture with one reference taken, uploading it on a miss
+    static GLuint acquire(const DecodedImage& image, const TextureSampler& sampler = TextureSampler());
+    static void retain(GLuint id);
+    static void release(GLuint id);
+
+    // Re-keys a texture for new sampler state; fails (false) when the texture
+    // is shared, since the change would leak into the other users
+    static bool setSampler(GLuint id, const TextureSampler& sampler);
+
+    // Deletes every texture nobody references
+    static void evictUnused();
+
+    // Per-texture memory, references and hit counts
+    static void report();
+    static size_t bytesResident() { return get().resident; }
+
+    // GL formats for an image; format is 0 for compressed images
+    static void formatsFor(const DecodedImage& image, bool srgb, GLenum& internalFormat, GLenum& format);
+
+    // Hash used as the key, safe on any thread (decoders fill it in)
+    static uint64_t contentHash(const unsigned char* pixels, size_t bytes, int width, int height, int channels);
+
+private:
+    struct Key {
+        uint64_t hash;
+        TextureSampler sampler;
+        bool operator<(const Key& o) const {
+            return hash != o.hash ? hash < o.hash : sampler < o.sampler;
+        }
+    };
+    struct Entry {
+        Key key;
+        std::string name;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        bool compressed = false;
+        size_t bytes = 0; // estimate including the mip chain
+        int refs = 0;
+        int hits = 0; // acquires served without an upload
+        std::list<GLuint>::iterator unusedIt; // valid while refs == 0
+    };
+
+    std::map<Key, GLuint> byKey;
+    std::map<GLuint, Entry> entries;
+    std::list<GLuint> unused; // refs == 0, least recently released first
+    size_t resident = 0;
+    size_t unusedBytes = 0;
+    size_t uploadedBytesSaved = 0;
+
+    void evict(GLuint id);
+    void trimUnused(size_t budget);
+
+    // never destroyed: models and textures may release after static teardown began
+    static TextureCache& get() {
+        static TextureCache* s = new TextureCache();
+        return *s;
+    }
+};
+
+// Owning reference to a cached texture: copies retain, destruction releases
+class TextureRef {
+public:
+    TextureRef() = default;
+    // Adopts the reference acquire() took
+    explicit TextureRef(GLuint id) : texture(id) {}
+    TextureRef(const TextureRef& o) : texture(o.texture) { if (texture) TextureCache::retain(texture); }
+    TextureRef(TextureRef&& o) noexcept : texture(o.texture) { o.texture = 0; }
+    TextureRef& operator=(TextureRef o) { std::swap(texture, o.texture); return *this; }
+    ~TextureRef() { if (texture) TextureCache::release(texture); }
+
+    GLuint id() const { return texture; }
+
+private:
+    GLuint texture = 0;
+};
+
+#endif // TEXTURE_CACHE_H
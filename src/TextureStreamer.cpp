@@ -0,0 +1,269 @@
+#include "TextureStreamer.h"
+#include "GLStateCache.h"
+#include "Config.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    const size_t PLACEMENT_ALIGN = 16;
+}
+
+void TextureStreamer::init() {
+    TextureStreamer& t = get();
+    if (t.initialized) {
+        return;
+    }
+    t.stagingSize = (size_t)Config::TEXTURE_STREAM_BUFFER_MB << 20;
+    for (int i = 0; i < Config::TEXTURE_STREAM_BUFFERS; ++i) {
+        auto s = std::make_unique<Staging>();
+        glGenBuffers(1, &s->buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s->buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, t.stagingSize, nullptr, GL_STREAM_DRAW);
+        t.staging.push_back(std::move(s));
+    }
+    // an unpack buffer left bound would turn every client memory upload into an offset
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    t.copyPool = std::make_unique<ThreadPool>(2);
+    t.initialized = true;
+}
+
+bool TextureStreamer::stream(GLuint texture, const DecodedImage& image, const TextureSampler& sampler) {
+    TextureStreamer& t = get();
+    auto job = std::make_shared<Job>();
+    job->texture = texture;
+    job->image = image;
+    TextureCache::formatsFor(image, sampler.srgb, job->internalFormat, job->format);
+
+    bool compressed = image.compressedFormat != 0;
+    int levels = compressed ? (int)image.levels.size() : 1;
+    job->chunksLeft.assign(levels, 0);
+
+    // split every level into chunks of whole rows (of 4x4 blocks when compressed),
+    // smallest level first so the texture is usable early
+    size_t total = 0;
+    for (int level = levels - 1; level >= 0; --level) {
+        int w = std::max(1, image.width >> level);
+        int h = std::max(1, image.height >> level);
+        int rowHeight = compressed ? 4 : 1;
+        size_t rowBytes = compressed ? (size_t)((w + 3) / 4) * Ktx2::blockBytes(image.compressedFormat)
+                                     : (size_t)w * image.channels;
+        size_t levelOffset = compressed ? image.levels[level].offset : 0;
+        if (rowBytes > t.stagingSize) {
+            return false;
+        }
+
+        int rowsPerChunk = (int)std::min<size_t>(t.stagingSize / rowBytes, (size_t)(h + rowHeight - 1) / rowHeight);
+        for (int row = 0; row * rowHeight < h; row += rowsPerChunk) {
+            Chunk c;
+            c.level = level;
+            c.y = row * rowHeight;
+            c.rows = std::min(rowsPerChunk * rowHeight, h - c.y);
+            c.srcOffset = levelOffset + (size_t)row * rowBytes;
+            c.bytes = (size_t)((c.rows + rowHeight - 1) / rowHeight) * rowBytes;
+            job->chunks.push_back(c);
+            job->chunksLeft[level]++;
+            total += c.bytes;
+        }
+    }
+
+    // storage only, contents arrive through update(); until then only the
+    // levels already streamed are sampled
+    GLStateCache::bindTexture(0, texture);
+    if (compressed) {
+        for (int level = 0; level < levels; ++level) {
+            int w = std::max(1, image.width >> level);
+            int h = std::max(1, image.height >> level);
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, job->internalFormat, w, h, 0,
+                (GLsizei)Ktx2::levelBytes(image.compressedFormat, w, h), nullptr);
+        }
+        job->baseLevel = levels - 1;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, levels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    }
+    else {
+        glTexImage2D(GL_TEXTURE_2D, 0, job->internalFormat, image.width, image.height, 0, job->format, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0); // mips are generated once level 0 is in
+    }
+
+    t.pending += total;
+    t.jobs.push_back(job);
+    return true;
+}
+
+void TextureStreamer::cancel(GLuint texture) {
+    TextureStreamer& t = get();
+    for (auto it = t.jobs.begin(); it != t.jobs.end();) {
+        Job& job = **it;
+        if (job.texture == texture && !job.cancelled) {
+            job.cancelled = true;
+            for (const Chunk& c : job.chunks) {
+                t.pending -= c.bytes;
+            }
+            job.chunks.clear();
+            it = t.jobs.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    // chunks already staged see the flag through their placement
+    for (auto& s : t.staging) {
+        for (auto& p : s->placements) {
+            if (p.job->texture == texture) {
+                p.job->cancelled = true;
+            }
+        }
+    }
+}
+
+void TextureStreamer::fill(Staging& s) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.buffer);
+    // the fence said the GPU is done with this buffer, no need for the driver to sync again
+    unsigned char* mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, stagingSize,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+    if (!mapped) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+
+    size_t offset = 0;
+    while (!jobs.empty()) {
+        std::shared_ptr<Job> job = jobs.front();
+        const Chunk& c = job->chunks.front();
+        size_t aligned = (offset + PLACEMENT_ALIGN - 1) / PLACEMENT_ALIGN * PLACEMENT_ALIGN;
+        if (aligned + c.bytes > stagingSize) {
+            break;
+        }
+        s.placements.push_back({ job, c, aligned });
+        offset = aligned + c.bytes;
+        job->chunks.pop_front();
+        if (job->chunks.empty()) {
+            jobs.pop_front();
+        }
+    }
+
+    if (s.placements.empty()) {
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // the memcpy runs on a worker, this thread only unmaps once it is done
+    s.state = StagingState::Copying;
+    s.copied.store(false);
+    Staging* target = &s;
+    copyPool->submit([target, mapped] {
+        for (const Placement& p : target->placements) {
+            std::memcpy(mapped + p.offset, p.job->image.pixels.get() + p.chunk.srcOffset, p.chunk.bytes);
+        }
+        target->copied.store(true, std::memory_order_release);
+    });
+}
+
+void TextureStreamer::upload(Staging& s) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.buffer);
+    bool intact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // chunks are tightly packed rows
+
+    for (const Placement& p : s.placements) {
+        pending -= p.chunk.bytes;
+        Job& job = *p.job;
+        if (job.cancelled) {
+            continue;
+        }
+        if (!intact) {
+            // the driver lost the mapping (display mode change etc.), copy again next fill
+            job.chunks.push_front(p.chunk);
+            pending += p.chunk.bytes;
+            if (std::find(jobs.begin(), jobs.end(), p.job) == jobs.end()) {
+                jobs.push_front(p.job);
+            }
+            continue;
+        }
+
+        const void* offset = reinterpret_cast<const void*>(p.offset);
+        int w = std::max(1, job.image.width >> p.chunk.level);
+        GLStateCache::bindTexture(0, job.texture);
+        if (job.image.compressedFormat) {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, p.chunk.level, 0, p.chunk.y, w, p.chunk.rows,
+                job.internalFormat, (GLsizei)p.chunk.bytes, offset);
+        }
+        else {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, p.chunk.y, w, p.chunk.rows, job.format, GL_UNSIGNED_BYTE, offset);
+        }
+        finishChunk(job, p.chunk.level);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    s.placements.clear();
+    s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    s.state = StagingState::InFlight;
+}
+
+void TextureStreamer::finishChunk(Job& job, int level) {
+    if (--job.chunksLeft[level] > 0) {
+        return;
+    }
+
+    // texture already bound by upload()
+    if (!job.image.compressedFormat) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+        return;
+    }
+
+    // sample from the largest level with every smaller one complete
+    int base = job.baseLevel;
+    while (base > 0 && job.chunksLeft[base - 1] == 0) {
+        base--;
+    }
+    if (base != job.baseLevel) {
+        job.baseLevel = base;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, base);
+    }
+}
+
+void TextureStreamer::update() {
+    TextureStreamer& t = get();
+    if (!t.initialized) {
+        return;
+    }
+
+    for (auto& s : t.staging) {
+        if (s->state == StagingState::InFlight) {
+            GLenum status = glClientWaitSync(s->fence, 0, 0);
+            if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+                glDeleteSync(s->fence);
+                s->fence = 0;
+                s->state = StagingState::Free;
+            }
+        }
+    }
+    for (auto& s : t.staging) {
+        if (s->state == StagingState::Copying && s->copied.load(std::memory_order_acquire)) {
+            t.upload(*s);
+        }
+    }
+    for (auto& s : t.staging) {
+        if (s->state == StagingState::Free && !t.jobs.empty()) {
+            t.fill(*s);
+        }
+    }
+}
+
+bool TextureStreamer::idle() {
+    TextureStreamer& t = get();
+    if (!t.jobs.empty()) {
+        return false;
+    }
+    for (auto& s : t.staging) {
+        if (s->state == StagingState::Copying) {
+            return false;
+        }
+    }
+    return true;
+}
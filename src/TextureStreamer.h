@@ -0,0 +1,99 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <vector>
+#include <glad/glad.h>
+
+#include "TextureCache.h"
+#include "ThreadPool.h"
+
+// Asynchronous texture uploads through a small pool of pixel unpack buffers.
+// stream() only allocates the texture; update() (once a frame, GL thread)
+// then moves the image through the staging buffers:
+//  - a free buffer is mapped unsynchronized and a worker copies the next
+//    chunks of image data into it
+//  - once the copy is done the buffer is unmapped, glTex(Sub)Image reads from
+//    it asynchronously and a fence marks when the buffer may be reused
+// Large images are split into row chunks, so they arrive over several frames
+// instead of stalling one. Compressed mip chains go smallest level first and
+// GL_TEXTURE_BASE_LEVEL follows, so a texture sharpens as it streams in.
+// GL 4.1 has no persistent mapping (ARB_buffer_storage), hence map/unmap per fill.
+class TextureStreamer {
+public:
+    // Creates the staging buffers, needs the GL context
+    static void init();
+    static bool enabled() { return get().initialized; }
+
+    // Allocates storage for texture and queues the image, whose pixels stay
+    // referenced until they are copied out. sampler.srgb picks the format.
+    // False (nothing done) when a single row wouldn't fit a staging buffer.
+    static bool stream(GLuint texture, const DecodedImage& image, const TextureSampler& sampler);
+    // Drops pending uploads of a texture that is being deleted
+    static void cancel(GLuint texture);
+
+    // Retires, uploads and refills staging buffers; never waits on the GPU
+    static void update();
+    static bool idle();
+
+    static size_t pendingBytes() { return get().pending; }
+
+private:
+    struct Job;
+
+    struct Chunk {
+        int level = 0;
+        int y = 0;        // first row (in pixels)
+        int rows = 0;
+        size_t srcOffset = 0; // into the image data
+        size_t bytes = 0;
+    };
+
+    struct Job {
+        GLuint texture = 0;
+        DecodedImage image;
+        GLenum internalFormat = 0;
+        GLenum format = 0; // uncompressed only
+        bool cancelled = false;
+        std::list<Chunk> chunks; // not staged yet
+        std::vector<int> chunksLeft; // per level, staged or not
+        int baseLevel = 0;
+    };
+
+    struct Placement {
+        std::shared_ptr<Job> job;
+        Chunk chunk;
+        size_t offset; // in the staging buffer
+    };
+
+    enum class StagingState { Free, Copying, InFlight };
+
+    struct Staging {
+        GLuint buffer = 0;
+        StagingState state = StagingState::Free;
+        GLsync fence = 0;
+        std::atomic<bool> copied{ false };
+        std::vector<Placement> placements;
+    };
+
+    bool initialized = false;
+    size_t stagingSize = 0;
+    std::vector<std::unique_ptr<Staging>> staging;
+    std::list<std::shared_ptr<Job>> jobs; // with chunks still to stage
+    size_t pending = 0; // bytes not uploaded yet
+    std::unique_ptr<ThreadPool> copyPool;
+
+    void fill(Staging& s);
+    void upload(Staging& s);
+    static void finishChunk(Job& job, int level);
+
+    // never destroyed, like TextureCache
+    static TextureStreamer& get() {
+        static TextureStreamer* s = new TextureStreamer();
+        return *s;
+    }
+};
+
+#endif // TEXTURE_STREAMER_H
@@ -0,0 +1,37 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running queued jobs in FIFO order. Jobs must not
+// touch GL, the context only lives on the main thread.
+class ThreadPool {
+public:
+    // 0 = one thread per core minus the main thread (at least one)
+    explicit ThreadPool(unsigned int threads = 0);
+    // Runs whatever is still queued, then joins the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> job);
+
+    unsigned int size() const { return (unsigned int)workers.size(); }
+
+private:
+    void run();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,95 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glm/glm.hpp>
+
+// Uniforms set on the hot path. Program resolves their locations once after
+// linking, so lookups are an array index instead of a string search. Names
+// must match the shader declarations. Values set through Program::setUniform
+// follow the program across permutation switches.
+enum class UniformId {
+    M,
+    enemyAlpha,
+    boneBase,
+    bonePalette,
+    LP,
+    LV,
+    uMaps,
+    shadowDepth,
+    bakedBones,
+    bakedTime,
+    bakedFrameRate,
+    projection,
+    model,
+    healthPercent,
+    BarStartX,
+    BarWidth,
+    alpha,
+    COUNT
+};
+
+constexpr const char* UNIFORM_ID_NAMES[(int)UniformId::COUNT] = {
+    "M",
+    "enemyAlpha",
+    "boneBase",
+    "bonePalette",
+    "LP",
+    "LV",
+    "uMaps[0]",
+    "shadowDepth",
+    "bakedBones",
+    "bakedTime",
+    "bakedFrameRate",
+    "projection",
+    "model",
+    "healthPercent",
+    "BarStartX",
+    "BarWidth",
+    "alpha",
+};
+
+// Binding points of the shared uniform blocks, set on every program that
+// declares the block when it is linked
+enum UniformBlockBinding {
+    FRAME_DATA_BINDING = 0,
+    MATERIAL_DATA_BINDING = 1
+};
+
+constexpr const char* FRAME_DATA_BLOCK = "FrameData";
+constexpr const char* MATERIAL_DATA_BLOCK = "MaterialData";
+
+// std140 mirror of the FrameData block, uploaded once per frame:
+//   layout(std140) uniform FrameData {
+//       mat4 P; mat4 V; mat4 LV;
+//       vec3 lightDir; float exposure;
+//       vec3 lightColor; float saturation;
+//       vec3 cameraPos;
+//   };
+struct FrameData {
+    glm::mat4 P;
+    glm::mat4 V;
+    glm::mat4 LV; // light space (projection * view)
+    glm::vec3 lightDir;
+    float exposure;
+    glm::vec3 lightColor;
+    float saturation;
+    glm::vec3 cameraPos;
+    float pad0;
+};
+
+// std140 mirror of the MaterialData block, one entry per Material:
+//   layout(std140) uniform MaterialData {
+//       vec3 MatAlbedo; float MatRough;
+//       vec3 MatEmit; float MatMetal;
+//   };
+struct MaterialData {
+    glm::vec3 albedo;
+    float rough;
+    glm::vec3 emit;
+    float metal;
+};
+
+static_assert(sizeof(FrameData) == 3 * 64 + 3 * 16, "FrameData must match std140 layout");
+static_assert(sizeof(MaterialData) == 32, "MaterialData must match std140 layout");
+
+#endif // UNIFORM_BLOCKS_H
@@ -0,0 +1,47 @@
+#include "UniformBuffer.h"
+
+#include <iostream>
+
+UniformBuffer::~UniformBuffer() {
+    if (ubo != 0) {
+        glDeleteBuffers(1, &ubo);
+    }
+}
+
+void UniformBuffer::init(GLsizeiptr size, GLenum usage) {
+    if (ubo == 0) {
+        glGenBuffers(1, &ubo);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, usage);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    capacity = size;
+}
+
+void UniformBuffer::update(const void* data, GLsizeiptr size, GLintptr offset) {
+    if (offset + size > capacity) {
+        std::cerr << "UniformBuffer: update of " << size << " bytes at " << offset
+            << " overflows buffer of " << capacity << std::endl;
+        return;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::bindBase(GLuint binding) const {
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+}
+
+void UniformBuffer::bindRange(GLuint binding, GLintptr offset, GLsizeiptr size) const {
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, ubo, offset, size);
+}
+
+GLsizeiptr UniformBuffer::alignedSize(GLsizeiptr size) {
+    static GLint alignment = 0;
+    if (alignment == 0) {
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        if (alignment <= 0) alignment = 256;
+    }
+    return (size + alignment - 1) / alignment * alignment;
+}
@@ -0,0 +1,33 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+
+// Thin wrapper around a GL_UNIFORM_BUFFER
+class UniformBuffer {
+public:
+    UniformBuffer() = default;
+    ~UniformBuffer();
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    void init(GLsizeiptr size, GLenum usage = GL_DYNAMIC_DRAW);
+    void update(const void* data, GLsizeiptr size, GLintptr offset = 0);
+
+    // Attach the whole buffer, or a slice of it, to a block binding point
+    void bindBase(GLuint binding) const;
+    void bindRange(GLuint binding, GLintptr offset, GLsizeiptr size) const;
+
+    // size rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, use as the
+    // stride when packing several blocks for bindRange
+    static GLsizeiptr alignedSize(GLsizeiptr size);
+
+    GLuint getID() const { return ubo; }
+
+private:
+    GLuint ubo = 0;
+    GLsizeiptr capacity = 0;
+};
+
+#endif // UNIFORM_BUFFER_H
@@ -0,0 +1,107 @@
+#ifndef VERTEX_FORMATS_H
+#define VERTEX_FORMATS_H
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+// GPU vertex layouts. Meshes are loaded into the full Vertex struct and
+// packed into one of these when uploaded to the matching GeometryArena.
+enum class VertexFormat {
+    Static,  // props, walls, floors: no bone attributes
+    Skinned, // meshes with bone weights
+    COUNT
+};
+
+// 24 bytes (Vertex is 88)
+struct StaticVertex {
+    glm::vec3 position;
+    int16_t normal[2];  // octahedral, snorm16
+    int8_t tangent[4];  // octahedral xy (snorm8), z = bitangent sign, w unused
+    uint16_t uv[2];     // half floats
+};
+
+// 32 bytes
+struct SkinnedVertex {
+    glm::vec3 position;
+    int16_t normal[2];
+    int8_t tangent[4];
+    uint16_t uv[2];
+    uint8_t boneIds[4]; // unused slots are 0 with a weight of 0
+    uint8_t weights[4]; // unorm8, sum to 255
+};
+
+static_assert(sizeof(StaticVertex) == 24, "StaticVertex should stay tightly packed");
+static_assert(sizeof(SkinnedVertex) == 32, "SkinnedVertex should stay tightly packed");
+
+namespace VertexPacking {
+
+    // Unit vector -> octahedral coordinates in [-1, 1], see octDecode in shadow_vert.glsl
+    inline glm::vec2 octEncode(glm::vec3 n) {
+        float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        if (l1 <= 0.0f) {
+            return glm::vec2(0.0f, 0.0f);
+        }
+        n /= l1;
+        glm::vec2 e(n.x, n.y);
+        if (n.z < 0.0f) {
+            glm::vec2 s(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+            e = (glm::vec2(1.0f) - glm::vec2(std::abs(e.y), std::abs(e.x))) * s;
+        }
+        return e;
+    }
+
+    inline int16_t toSnorm16(float v) {
+        return (int16_t)std::round(std::min(std::max(v, -1.0f), 1.0f) * 32767.0f);
+    }
+
+    inline int8_t toSnorm8(float v) {
+        return (int8_t)std::round(std::min(std::max(v, -1.0f), 1.0f) * 127.0f);
+    }
+
+    inline void packNormalFrame(const glm::vec3& normal, const glm::vec3& tangent, const glm::vec3& bitangent,
+        int16_t outNormal[2], int8_t outTangent[4]) {
+        glm::vec2 n = octEncode(normal);
+        outNormal[0] = toSnorm16(n.x);
+        outNormal[1] = toSnorm16(n.y);
+
+        glm::vec2 t = octEncode(tangent);
+        // bitangent is rebuilt in the shader as cross(N, T) * sign
+        float sign = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+        outTangent[0] = toSnorm8(t.x);
+        outTangent[1] = toSnorm8(t.y);
+        outTangent[2] = toSnorm8(sign);
+        outTangent[3] = 0;
+    }
+
+    inline void packUV(const glm::vec2& uv, uint16_t out[2]) {
+        out[0] = glm::packHalf1x16(uv.x);
+        out[1] = glm::packHalf1x16(uv.y);
+    }
+
+    // Quantizes up to 4 weights to unorm8 keeping the sum at exactly 255
+    inline void packWeights(const int ids[4], const float weights[4], uint8_t outIds[4], uint8_t outWeights[4]) {
+        float total = 0.0f;
+        for (int i = 0; i < 4; ++i) {
+            if (ids[i] >= 0 && weights[i] > 0.0f) total += weights[i];
+        }
+
+        int sum = 0;
+        int heaviest = 0;
+        for (int i = 0; i < 4; ++i) {
+            bool used = ids[i] >= 0 && ids[i] < 256 && weights[i] > 0.0f && total > 0.0f;
+            outIds[i] = used ? (uint8_t)ids[i] : 0;
+            outWeights[i] = used ? (uint8_t)std::round(weights[i] / total * 255.0f) : 0;
+            sum += outWeights[i];
+            if (outWeights[i] > outWeights[heaviest]) heaviest = i;
+        }
+        if (sum > 0) {
+            // push the rounding error onto the dominant influence
+            outWeights[heaviest] = (uint8_t)std::min(255, std::max(0, (int)outWeights[heaviest] + 255 - sum));
+        }
+    }
+}
+
+#endif // VERTEX_FORMATS_H
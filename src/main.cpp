@@ -11,6 +11,7 @@
 #include <set>
 #include <algorithm>
 #include <limits>
+#include <cstring>
 
 #include "GLSL.h"
 #include "Program.h"
@@ -21,6 +22,10 @@
 #include "stb_image.h"
 #include "AssimpModel.h"
 #include "Animator.h"
+#include "AnimationSystem.h"
+#include "BonePalette.h"
+#include "AnimationBaker.h"
+#include "AnimatedCrowd.h"
 #include "LightTrail.h"
 #include "LibraryGen.h"
 // #include "Grid.h"
@@ -29,6 +34,14 @@
 #include "Player.h"
 #include "BossRoomGen.h"
 #include "FrustumCulling.h"
+#include "OcclusionQueryPool.h"
+#include "DrawQueue.h"
+#include "AssetRegistry.h"
+#include "AssetLoader.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "GLStateCache.h"
+#include "UniformBuffer.h"
 #include "BossEnemy.h"
 #include "Config.h"
 #include "GameObjectTypes.h"
@@ -129,6 +142,10 @@ public:
 	AssimpModel* player_rig;
 	Animation *player_walk, *player_idle;
 	Animator *catwizard_animator;
+	// Config::DEBUG_CROWD_SIZE copies of player_rig walking from a baked clip
+	BakedBoneTexture crowdWalk;
+	unique_ptr<AnimatedCrowd> crowd;
+	float crowdTime = 0.0f;
 
 	AssimpModel *CatWizard;
 
@@ -213,17 +230,38 @@ public:
 	bool bossfightended = false;
 
 	// -- Camera Occlusion Query --
-	GLuint occlusionQueryID = 0; // Occlusion query ID
 	GLuint visible = 0;
 	GLuint occlusionBoxVAO = 0;
 	GLuint occlusionBoxVBO = 0;
 
+	// -- Hierarchical Occlusion Culling --
+	static constexpr int CAMERA_QUERY_SLOT = 0; // Slot 0 is the camera sphere, nodes follow
+	OcclusionQueryPool occlusionPool;
+	std::vector<OcclusionNode> occlusionNodes; // Room regions and the chunks beneath them
+	std::vector<bool> occlusionCulled; // Per node, decided once per frame from older results
+	std::vector<int> libraryChunkNodes; // Library chunk -> node index (-1 if empty)
+	std::vector<int> bossChunkNodes; // Boss room chunk -> node index (-1 if empty)
+
+	// Static props are queued and drawn sorted by program/material/VAO
+	DrawQueue staticDraws;
+	LodSelector lodSelector; // screen-size LOD with per-instance hysteresis
+	AssetLoader assetLoader; // startup models/textures decoded on worker threads
+	MultiDrawBatch quadBatch; // per-draw command list for walls and library grounds
+	int glStatsFrames = 0;
+	int animStatsFrames = 0;
+
 	float cameraVisibleCooldown = 0.0f; // Cooldown for camera visibility check
 	bool wasVisibleLastFrame = true;
 
 	SpellType currentPlayerSpellType = SpellType::FIRE; // Player starts with Fire spell by default
 	int nextSpellTypeIndex = 1; // Used to cycle spell types for new orbs: 1=FIRE, 2=ICE, 3=LIGHTNING
 
+	// Shared uniform blocks (see UniformBlocks.h)
+	UniformBuffer frameUBO; // FrameData, refilled once per frame
+	UniformBuffer materialUBO; // MaterialData for every Material, bound by range
+	GLsizeiptr materialStride = 0;
+	FrameData frameData;
+
 	// Shadows
 	GLuint depthMapFBO;
 	const GLuint S_WIDTH = 2048, S_HEIGHT = 2048;
@@ -237,7 +275,7 @@ public:
 	void initShadow() {
 		glGenFramebuffers(1, &depthMapFBO); // Generate FBO for shadow depth
 		glGenTextures(1, &depthMap); // Generate texture for shadow depth
-		glBindTexture(GL_TEXTURE_2D, depthMap);
+		GLStateCache::bindTexture(0, depthMap);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, S_WIDTH, S_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -373,6 +411,10 @@ public:
 	void init(const std::string& resourceDirectory)
 	{
 		GLSL::checkVersion();
+		// before any texture request, the loader's decoders check it
+		TextureCache::detectCompressedFormats();
+		TextureStreamer::init();
+		BonePalette::init();
 
 		// Set background color and enable z-buffer test
 		glClearColor(.12f, .34f, .56f, 1.0f);
@@ -382,16 +424,20 @@ public:
 		DepthProg = make_shared<Program>();
 		DepthProg->setVerbose(Config::DEBUG_SHADER);
 		DepthProg->setShaderNames(resourceDirectory + "/depth_vert.glsl", resourceDirectory + "/depth_frag.glsl");
+		DepthProg->setPermutations(FEATURE_SKINNED | FEATURE_INSTANCED | FEATURE_BAKED);
 		DepthProg->init();
 
 		DepthProgDebug = make_shared<Program>();
 		DepthProgDebug->setVerbose(Config::DEBUG_SHADER);
 		DepthProgDebug->setShaderNames(resourceDirectory + "/depth_vertDebug.glsl", resourceDirectory + "/depth_fragDebug.glsl");
+		DepthProgDebug->setPermutations(FEATURE_INSTANCED);
 		DepthProgDebug->init();
 
 		ShadowProg = make_shared<Program>();
 		ShadowProg->setVerbose(Config::DEBUG_SHADER);
 		ShadowProg->setShaderNames(resourceDirectory + "/shadow_vert.glsl", resourceDirectory + "/shadow_frag.glsl");
+		// one program per draw kind instead of branching on bool uniforms
+		ShadowProg->setPermutations(FEATURE_SKINNED | FEATURE_MATERIAL | FEATURE_TEX_ONLY | FEATURE_INSTANCED | FEATURE_BAKED);
 		ShadowProg->init();
 
 		DebugProg = make_shared<Program>();
@@ -411,13 +457,7 @@ public:
 		DepthProgDebug->addUniform("M");
 		DepthProgDebug->addAttribute("vertPos");
 
-		ShadowProg->addUniform("P");
-		ShadowProg->addUniform("V");
 		ShadowProg->addUniform("M");
-		ShadowProg->addUniform("LV");
-		ShadowProg->addUniform("lightDir");
-		ShadowProg->addUniform("lightColor");
-		ShadowProg->addUniform("cameraPos");
 		ShadowProg->addAttribute("vertPos");
 		ShadowProg->addAttribute("vertNor");
 		ShadowProg->addAttribute("vertTex");
@@ -425,30 +465,21 @@ public:
 		ShadowProg->addUniform("uMaps");
 		ShadowProg->addUniform("shadowDepth");
 
-		ShadowProg->addUniform("hasMaterial");
-		ShadowProg->addUniform("hasBones");
-
-		ShadowProg->addUniform("MatAlbedo");
-		ShadowProg->addUniform("MatRough");
-		ShadowProg->addUniform("MatMetal");
-		ShadowProg->addUniform("MatEmit");
-
 		ShadowProg->addUniform("enemyAlpha");
 
-		ShadowProg->addUniform("texOnly");
-
-		ShadowProg->addUniform("exposure");
-		ShadowProg->addUniform("saturation");
-
-		for (int i = 0; i < Config::MAX_BONES; i++) {
-			ShadowProg->addUniform("finalBonesMatrices[" + to_string(i) + "]");
-		}
-
-		ShadowProg->bind();
-		GLint loc = ShadowProg->getUniform("uMaps");
+		// Samplers never change, set them once (every permutation gets them)
 		GLint units[6] = { 0,1,2,3,4,5 };
-		glUniform1iv(loc, 6, units);
+		ShadowProg->setUniform(UniformId::uMaps, units, 6);
+		ShadowProg->setUniform(UniformId::shadowDepth, 10);
+		ShadowProg->setUniform(UniformId::bonePalette, BonePalette::TEXTURE_UNIT);
+		ShadowProg->setUniform(UniformId::bakedBones, AnimationBaker::TEXTURE_UNIT);
 		ShadowProg->unbind();
+		DepthProg->setUniform(UniformId::bonePalette, BonePalette::TEXTURE_UNIT);
+		DepthProg->setUniform(UniformId::bakedBones, AnimationBaker::TEXTURE_UNIT);
+		DepthProg->unbind();
+
+		initUniformBlocks();
+		staticDraws.setLodSelector(&lodSelector);
 
 		initShadow();
 
@@ -467,8 +498,6 @@ public:
 		particleProg->setVerbose(true);
 		particleProg->setShaderNames(resourceDirectory + "/particle_vert.glsl", resourceDirectory + "/particle_frag.glsl");
 		particleProg->init();
-		particleProg->addUniform("P");
-		particleProg->addUniform("V");
 		particleProg->addUniform("M");
 		particleProg->addUniform("alphaTexture");
 		particleProg->addAttribute("vertPos");
@@ -489,28 +518,28 @@ public:
 		borderWallTex = make_shared<Texture>();
 		//borderWallTex->setFilename(resourceDirectory + "/sky_sphere/sky_sphere.fbm/infinite_lib2.png");
 		borderWallTex->setFilename(resourceDirectory + "/Wall/textures/mossCastle.png");
-		borderWallTex->init();
 		borderWallTex->setUnit(0);
 		borderWallTex->setWrapModes(GL_REPEAT, GL_REPEAT);
+		assetLoader.requestTexture(borderWallTex);
 
 		libraryGroundTex = make_shared<Texture>();
 		libraryGroundTex->setFilename(resourceDirectory + "/book_shelf/textures/wood_texture.png");
-		libraryGroundTex->init();
 		libraryGroundTex->setUnit(0);
 		libraryGroundTex->setWrapModes(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+		assetLoader.requestTexture(libraryGroundTex);
 
 		carpetTex = make_shared<Texture>();
 		carpetTex->setFilename(resourceDirectory + "/cluster_assets/carpet_texture1.png");
-		carpetTex->init();
 		carpetTex->setUnit(0);
 		carpetTex->setWrapModes(GL_REPEAT, GL_REPEAT);
+		assetLoader.requestTexture(carpetTex);
 
 		// Initialize particle alpha texture
 		particleAlphaTex = make_shared<Texture>();
 		particleAlphaTex->setFilename(resourceDirectory + "/alpha.bmp");
-		particleAlphaTex->init();
 		particleAlphaTex->setUnit(0);
 		particleAlphaTex->setWrapModes(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+		assetLoader.requestTexture(particleAlphaTex);
 
 		// Initialize particle system
 		particleSystem = make_shared<particleGen>(vec3(0.0f), 0.0f, 0.2f, 0.6f, 0.8f, 0.8f, 1.0f, 0.1f, 0.2f);
@@ -529,7 +558,7 @@ public:
 	GLuint genSolidTexture(const unsigned char* pixel, GLenum format) {
 		GLuint id;
 		glGenTextures(1, &id);
-		glBindTexture(GL_TEXTURE_2D, id);
+		GLStateCache::bindTexture(0, id);
 		glTexImage2D(GL_TEXTURE_2D, 0, format, 1, 1, 0, format, GL_UNSIGNED_BYTE, pixel);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -575,86 +604,214 @@ public:
 		bossRoom->generate(bossGridSize, gridSize, glm::vec3(0, 0, 0), bossEntranceDir);
 		bossGrid = bossRoom->getGrid();
 		addLibGrnd(bossGridSize.x * 2, bossGridSize.y * 2, 0.0f, bossRoom->getWorldOrigin(), libraryGroundTex);
+
+		buildOcclusionHierarchy();
+	}
+
+	// Group grid cells into chunks, each chunk gets a box tested against the depth buffer
+	template <typename Gen, typename CellGrid, typename IsOccupied>
+	void addOcclusionChunks(const Gen& gen, const CellGrid& cells, IsOccupied isOccupied, std::vector<int>& chunkNodes) {
+		const int C = Config::OCCLUSION_CHUNK_CELLS;
+		ivec2 size = cells.getSize();
+		ivec2 chunks = (size + ivec2(C - 1)) / C;
+		chunkNodes.assign(chunks.x * chunks.y, -1);
+
+		// Props are scaled past their cell, so pad each cell by more than half a cell
+		float margin = (gen.mapGridXtoWorldX(1) - gen.mapGridXtoWorldX(0)) * 1.5f;
+
+		OcclusionNode region;
+		region.boxMin = vec3(std::numeric_limits<float>::max());
+		region.boxMax = vec3(-std::numeric_limits<float>::max());
+		int regionIndex = (int)occlusionNodes.size();
+		occlusionNodes.push_back(region);
+
+		for (int z = 0; z < size.y; ++z) {
+			for (int x = 0; x < size.x; ++x) {
+				if (!isOccupied(cells[ivec2(x, z)])) continue;
+
+				int& nodeIndex = chunkNodes[(z / C) * chunks.x + (x / C)];
+				if (nodeIndex < 0) {
+					OcclusionNode chunk;
+					chunk.boxMin = vec3(std::numeric_limits<float>::max());
+					chunk.boxMax = vec3(-std::numeric_limits<float>::max());
+					chunk.parent = regionIndex;
+					nodeIndex = (int)occlusionNodes.size();
+					occlusionNodes.push_back(chunk);
+				}
+
+				vec3 center = vec3(gen.mapGridXtoWorldX(x), groundY, gen.mapGridYtoWorldZ(z));
+				OcclusionNode& chunk = occlusionNodes[nodeIndex];
+				chunk.boxMin = glm::min(chunk.boxMin, center - vec3(margin, 0.0f, margin));
+				chunk.boxMax = glm::max(chunk.boxMax, center + vec3(margin, Config::OCCLUSION_CHUNK_HEIGHT, margin));
+
+				OcclusionNode& room = occlusionNodes[regionIndex];
+				room.boxMin = glm::min(room.boxMin, chunk.boxMin);
+				room.boxMax = glm::max(room.boxMax, chunk.boxMax);
+			}
+		}
+	}
+
+	void buildOcclusionHierarchy() {
+		occlusionNodes.clear();
+
+		addOcclusionChunks(*library, grid, [](const LibraryGen::Cell& cell) {
+			return cell.type == LibraryGen::CellType::CLUSTER;
+		}, libraryChunkNodes);
+
+		addOcclusionChunks(*bossRoom, bossGrid, [](const BossRoomGen::Cell& cell) {
+			return cell.type == BossRoomGen::CellType::BORDER || cell.type == BossRoomGen::CellType::ENTRANCE
+				|| cell.type == BossRoomGen::CellType::EXIT || cell.type == BossRoomGen::CellType::CLUSTER;
+		}, bossChunkNodes);
+
+		for (size_t n = 0; n < occlusionNodes.size(); ++n) {
+			occlusionNodes[n].slot = CAMERA_QUERY_SLOT + 1 + (int)n;
+		}
+		occlusionPool.resize(CAMERA_QUERY_SLOT + 1 + (int)occlusionNodes.size());
+		occlusionCulled.assign(occlusionNodes.size(), false);
+	}
+
+	bool eyeInsideBox(const OcclusionNode& node) const {
+		const float nearPad = 0.5f; // The box face is clipped by the near plane before the eye reaches it
+		return all(greaterThanEqual(eye, node.boxMin - vec3(nearPad))) && all(lessThanEqual(eye, node.boxMax + vec3(nearPad)));
+	}
+
+	// Decide which nodes to skip this frame from the newest finished query results.
+	// Nodes are stored parent-first, so a hidden region hides all of its chunks.
+	void updateOcclusionCulling() {
+		for (size_t n = 0; n < occlusionNodes.size(); ++n) {
+			const OcclusionNode& node = occlusionNodes[n];
+			bool culled = Config::OCCLUSION_CULLING && !eyeInsideBox(node) && !occlusionPool.isVisible(node.slot);
+			if (node.parent >= 0 && occlusionCulled[node.parent]) {
+				culled = true;
+			}
+			occlusionCulled[n] = culled;
+		}
+	}
+
+	bool isChunkOcclusionCulled(const std::vector<int>& chunkNodes, int gridSizeX, int x, int z) const {
+		const int C = Config::OCCLUSION_CHUNK_CELLS;
+		int chunksX = (gridSizeX + C - 1) / C;
+		int node = chunkNodes[(z / C) * chunksX + (x / C)];
+		return node >= 0 && occlusionCulled[node];
+	}
+
+	/* Progress bar from scissored clears, drawn between upload batches while
+	   initGeom waits on the asset loader (no shaders or geometry needed) */
+	void drawLoadingScreen(float progress) {
+		int width, height;
+		glfwGetFramebufferSize(windowManager->getHandle(), &width, &height);
+		glViewport(0, 0, width, height);
+
+		GLfloat clearColor[4];
+		glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+		glClearColor(0.05f, 0.04f, 0.08f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		int barWidth = width / 2;
+		int barHeight = std::max(height / 40, 4);
+		int barX = (width - barWidth) / 2;
+		int barY = height / 4;
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(barX, barY, barWidth, barHeight);
+		glClearColor(0.2f, 0.18f, 0.25f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glScissor(barX, barY, (int)(barWidth * progress), barHeight);
+		glClearColor(0.85f, 0.65f, 0.3f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glDisable(GL_SCISSOR_TEST);
+
+		glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+		glfwSwapBuffers(windowManager->getHandle());
+		glfwPollEvents();
 	}
 
 	void initGeom(const std::string& resourceDirectory) { // NOTE: PROBLEMS GETTING ANIMATION FROM "Fixed" FBX
 		string errStr;
 
-		// load the walking character moded
-		player_rig = new AssimpModel(resourceDirectory + "/CatWizard/CatWizardAnimation2.fbx");
-		player_rig->assignTexture("texture_diffuse", resourceDirectory + "/CatWizard/textures/ImphenziaPalette02-Albedo.png");
-		//PROBLEM GETTING ANIMATION FROM "Fixed" FBX
-		player_walk = new Animation(resourceDirectory + "/CatWizard/CatWizardAnimation2.fbx", player_rig, 2);
-		player_idle = new Animation(resourceDirectory + "/CatWizard/CatWizardAnimation2.fbx", player_rig, 1);
-		//player_idle = new Animation(resourceDirectory + "/Vanguard/Vanguard.fbx", player_rig, 1);
-
-		//TEST Load the cat
-		//CatWizard = new AssimpModel(resourceDirectory + "/CatWizard/BlendWalkFix.fbx");
-		calculatePlayerLocalAABB();
+		// Every model below is only requested here: the workers import and
+		// decode them while the loop at the end uploads and shows a loading bar
 
-		catwizard_animator = new Animator(player_walk);
+		// load the walking character moded
+		assetLoader.requestModel(resourceDirectory + "/CatWizard/CatWizardAnimation2.fbx",
+			{ { "texture_diffuse", resourceDirectory + "/CatWizard/textures/ImphenziaPalette02-Albedo.png" } },
+			[this, resourceDirectory](AssimpModel* model) {
+				player_rig = model;
+				//PROBLEM GETTING ANIMATION FROM "Fixed" FBX
+				player_walk = new Animation(resourceDirectory + "/CatWizard/CatWizardAnimation2.fbx", player_rig, 2);
+				player_idle = new Animation(resourceDirectory + "/CatWizard/CatWizardAnimation2.fbx", player_rig, 1);
+				//player_idle = new Animation(resourceDirectory + "/Vanguard/Vanguard.fbx", player_rig, 1);
+
+				//TEST Load the cat
+				//CatWizard = new AssimpModel(resourceDirectory + "/CatWizard/BlendWalkFix.fbx");
+				calculatePlayerLocalAABB();
+
+				catwizard_animator = new Animator(player_walk);
+				catwizard_animator->SetSpeed(1.5f);
+				AnimationSystem::add(catwizard_animator);
+
+				if (Config::DEBUG_CROWD_SIZE > 0) {
+					initCrowd();
+				}
+			});
 
-		cube = new AssimpModel(resourceDirectory + "/cube.obj");
+		assetLoader.requestModel(resourceDirectory + "/cube.obj", cube);
 
-		bookCover = new AssimpModel(resourceDirectory + "/cornerCube/sideCube.fbx");
-		bookCover->assignTexture("texture_diffuse", resourceDirectory + "/cornerCube/brown-leather-tex/brown-leather_albedo.png");
-		bookCover->assignTexture("texture_roughness", resourceDirectory + "/cornerCube/brown-leather-tex/brown-leather_roughness.png");
-		bookCover->assignTexture("texture_metalness", resourceDirectory + "/cornerCube/brown-leather-tex/brown-leather_metallic.png");
-		bookCover->assignTexture("texture_normal", resourceDirectory + "/cornerCube/brown-leather-tex/brown-leather_normal-ogl.png");
+		assetLoader.requestModel(resourceDirectory + "/cornerCube/sideCube.fbx", bookCover, {
+			{ "texture_diffuse", resourceDirectory + "/cornerCube/brown-leather-tex/brown-leather_albedo.png" },
+			{ "texture_roughness", resourceDirectory + "/cornerCube/brown-leather-tex/brown-leather_roughness.png" },
+			{ "texture_metalness", resourceDirectory + "/cornerCube/brown-leather-tex/brown-leather_metallic.png" },
+			{ "texture_normal", resourceDirectory + "/cornerCube/brown-leather-tex/brown-leather_normal-ogl.png" }
+		});
 
-		bookPaper = new AssimpModel(resourceDirectory + "/cornerCube/sideCube.fbx");
-		bookPaper->assignTexture("texture_diffuse", resourceDirectory + "/cornerCube/wrinkled-paper-tex/wrinkled-paper-albedo.png");
-		bookPaper->assignTexture("texture_roughness", resourceDirectory + "/cornerCube/wrinkled-paper-tex/wrinkled-paper-roughness.png");
-		bookPaper->assignTexture("texture_metalness", resourceDirectory + "/cornerCube/wrinkled-paper-tex/wrinkled-paper-metalness.png");
-		bookPaper->assignTexture("texture_normal", resourceDirectory + "/cornerCube/wrinkled-paper-tex/wrinkled-paper-normal-ogl.png");
+		assetLoader.requestModel(resourceDirectory + "/cornerCube/sideCube.fbx", bookPaper, {
+			{ "texture_diffuse", resourceDirectory + "/cornerCube/wrinkled-paper-tex/wrinkled-paper-albedo.png" },
+			{ "texture_roughness", resourceDirectory + "/cornerCube/wrinkled-paper-tex/wrinkled-paper-roughness.png" },
+			{ "texture_metalness", resourceDirectory + "/cornerCube/wrinkled-paper-tex/wrinkled-paper-metalness.png" },
+			{ "texture_normal", resourceDirectory + "/cornerCube/wrinkled-paper-tex/wrinkled-paper-normal-ogl.png" }
+		});
 
-		book_shelf1 = new AssimpModel(resourceDirectory + "/cluster_assets/bookshelf_texture2.obj");
-		book_shelf1->assignTexture("texture_diffuse", resourceDirectory + "/cluster_assets/darker_bookshelf_diffuse.png");
+		assetLoader.requestModel(resourceDirectory + "/cluster_assets/bookshelf_texture2.obj", book_shelf1, { { "texture_diffuse", resourceDirectory + "/cluster_assets/darker_bookshelf_diffuse.png" } });
 
-		book_shelf2 = new AssimpModel(resourceDirectory + "/cluster_assets/bookshelf_texture2.obj");
-		book_shelf2->assignTexture("texture_diffuse", resourceDirectory + "/cluster_assets/glowing_bookshelf_bake_diffuse.png");
+		assetLoader.requestModel(resourceDirectory + "/cluster_assets/bookshelf_texture2.obj", book_shelf2, { { "texture_diffuse", resourceDirectory + "/cluster_assets/glowing_bookshelf_bake_diffuse.png" } });
 
-		candelabra = new AssimpModel(resourceDirectory + "/cluster_assets/candelabrum/Candelabrum.obj");
-		candelabra->assignTexture("texture_diffuse", resourceDirectory + "/cluster_assets/candelabrum/textures/defaultobject_gloss.png");
-		candelabra->assignTexture("texture_specular", resourceDirectory + "/cluster_assets/candelabrum/textures/defaultobject_specular.png");
-		candelabra->assignTexture("texture_normal", resourceDirectory + "/cluster_assets/candelabrum/textures/defaultobject_normal.png");
+		assetLoader.requestModel(resourceDirectory + "/cluster_assets/candelabrum/Candelabrum.obj", candelabra, {
+			{ "texture_diffuse", resourceDirectory + "/cluster_assets/candelabrum/textures/defaultobject_gloss.png" },
+			{ "texture_specular", resourceDirectory + "/cluster_assets/candelabrum/textures/defaultobject_specular.png" },
+			{ "texture_normal", resourceDirectory + "/cluster_assets/candelabrum/textures/defaultobject_normal.png" }
+		});
 
-		chest = new AssimpModel(resourceDirectory + "/cluster_assets/chest/Chest.obj");
-		chest->assignTexture("texture_diffuse", resourceDirectory + "/cluster_assets/chest/textures/TreasureChestDiffuse_2.png");
-		chest->assignTexture("texture_roughness", resourceDirectory + "/cluster_assets/chest/textures/TreasureChestRoughness_2.png");
-		chest->assignTexture("texture_metalness", resourceDirectory + "/cluster_assets/chest/textures/TreasureChestMetal_2.png");
-		chest->assignTexture("texture_normal", resourceDirectory + "/cluster_assets/chest/textures/TreasureChestNormal_2.png");
+		assetLoader.requestModel(resourceDirectory + "/cluster_assets/chest/Chest.obj", chest, {
+			{ "texture_diffuse", resourceDirectory + "/cluster_assets/chest/textures/TreasureChestDiffuse_2.png" },
+			{ "texture_roughness", resourceDirectory + "/cluster_assets/chest/textures/TreasureChestRoughness_2.png" },
+			{ "texture_metalness", resourceDirectory + "/cluster_assets/chest/textures/TreasureChestMetal_2.png" },
+			{ "texture_normal", resourceDirectory + "/cluster_assets/chest/textures/TreasureChestNormal_2.png" }
+		});
 
-		library_bench = new AssimpModel(resourceDirectory + "/cluster_assets/library_bench/library_bench.obj");
-		library_bench->assignTexture("texture_diffuse", resourceDirectory + "/cluster_assets/library_bench/textures/bench_diffuse.png");
+		assetLoader.requestModel(resourceDirectory + "/cluster_assets/library_bench/library_bench.obj", library_bench, { { "texture_diffuse", resourceDirectory + "/cluster_assets/library_bench/textures/bench_diffuse.png" } });
 
-		table_chairs1 = new AssimpModel(resourceDirectory + "/cluster_assets/table_chairs/table_chairs_3.obj");
-		table_chairs1->assignTexture("texture_diffuse", resourceDirectory + "/cluster_assets/table_chairs/textures/table_chairs_3_diffuse.png");
+		assetLoader.requestModel(resourceDirectory + "/cluster_assets/table_chairs/table_chairs_3.obj", table_chairs1, { { "texture_diffuse", resourceDirectory + "/cluster_assets/table_chairs/textures/table_chairs_3_diffuse.png" } });
 
-		table_chairs2 = new AssimpModel(resourceDirectory + "/cluster_assets/table_chairs/table_chairs_4.obj");
-		table_chairs2->assignTexture("texture_diffuse", resourceDirectory + "/cluster_assets/table_chairs/textures/table_chairs_4_diffuse.png");
+		assetLoader.requestModel(resourceDirectory + "/cluster_assets/table_chairs/table_chairs_4.obj", table_chairs2, { { "texture_diffuse", resourceDirectory + "/cluster_assets/table_chairs/textures/table_chairs_4_diffuse.png" } });
 
-		grandfather_clock = new AssimpModel(resourceDirectory + "/cluster_assets/grandfather_clock/grandfather_clock.obj");
-		grandfather_clock->assignTexture("texture_diffuse", resourceDirectory + "/cluster_assets/grandfather_clock/textures/Clock_L_lambert1_BaseColor.tga.png");
-		grandfather_clock->assignTexture("texture_metalness", resourceDirectory + "/cluster_assets/grandfather_clock/textures/Clock_L_lambert1_Metallic.tga.png");
-		grandfather_clock->assignTexture("texture_roughness", resourceDirectory + "/cluster_assets/grandfather_clock/textures/Clock_L_lambert1_Roughness.tga.png");
-		grandfather_clock->assignTexture("texture_normal", resourceDirectory + "/cluster_assets/grandfather_clock/textures/Clock_L_lambert1_Normal.tga.jpg");
+		assetLoader.requestModel(resourceDirectory + "/cluster_assets/grandfather_clock/grandfather_clock.obj", grandfather_clock, {
+			{ "texture_diffuse", resourceDirectory + "/cluster_assets/grandfather_clock/textures/Clock_L_lambert1_BaseColor.tga.png" },
+			{ "texture_metalness", resourceDirectory + "/cluster_assets/grandfather_clock/textures/Clock_L_lambert1_Metallic.tga.png" },
+			{ "texture_roughness", resourceDirectory + "/cluster_assets/grandfather_clock/textures/Clock_L_lambert1_Roughness.tga.png" },
+			{ "texture_normal", resourceDirectory + "/cluster_assets/grandfather_clock/textures/Clock_L_lambert1_Normal.tga.jpg" }
+		});
 
-		bookstand = new AssimpModel(resourceDirectory + "/cluster_assets/bookstand/bookstand.obj");
-		bookstand->assignTexture("texture_diffuse", resourceDirectory + "/cluster_assets/bookstand/textures/bookstand_diffuse.png");
+		assetLoader.requestModel(resourceDirectory + "/cluster_assets/bookstand/bookstand.obj", bookstand, { { "texture_diffuse", resourceDirectory + "/cluster_assets/bookstand/textures/bookstand_diffuse.png" } });
 
-		door = new AssimpModel(resourceDirectory + "/cluster_assets/door/door.obj");
-		door->assignTexture("texture_diffuse", resourceDirectory + "/cluster_assets/door/Door_diffuse.png");
+		assetLoader.requestModel(resourceDirectory + "/cluster_assets/door/door.obj", door, { { "texture_diffuse", resourceDirectory + "/cluster_assets/door/Door_diffuse.png" } });
 
-		sky_sphere = new AssimpModel(resourceDirectory + "/sky_sphere/skybox_sphere.obj");
-		sky_sphere->assignTexture("texture_diffuse", resourceDirectory + "/sky_sphere/sky_sphere.fbm/infinite_lib2.png");
+		assetLoader.requestModel(resourceDirectory + "/sky_sphere/skybox_sphere.obj", sky_sphere, { { "texture_diffuse", resourceDirectory + "/sky_sphere/sky_sphere.fbm/infinite_lib2.png" } });
 
-		sphere = new AssimpModel(resourceDirectory + "/SmoothSphere.obj");
+		assetLoader.requestModel(resourceDirectory + "/SmoothSphere.obj", sphere);
 
-		iceElemental = new AssimpModel(resourceDirectory + "/IceElemental/IceElem.fbx");
+		assetLoader.requestModel(resourceDirectory + "/IceElemental/IceElem.fbx", iceElemental);
 
-		healthBar = new AssimpModel(resourceDirectory + "/Quad/hud_quad.obj");
-		healthBar->assignTexture("texture_diffuse", resourceDirectory + "/healthbar.bmp");
+		assetLoader.requestModel(resourceDirectory + "/Quad/hud_quad.obj", healthBar, { { "texture_diffuse", resourceDirectory + "/healthbar.bmp" } });
 
 		/*
 		* KEY COLLECTIBLE IS BROKEN. THIS IS THE COMMENTED OUT PROGRESS OF MADILINE SINCE PROJECT DOESN'T COMPILE WITH IT
@@ -666,8 +823,14 @@ public:
 		*/
 		//lock
 
-		lock = new AssimpModel(resourceDirectory + "/Key_and_Lock/lockCopy.obj");
-		lockHandle = new AssimpModel(resourceDirectory + "/Key_and_Lock/lockHandle.obj");
+		assetLoader.requestModel(resourceDirectory + "/Key_and_Lock/lockCopy.obj", lock);
+		assetLoader.requestModel(resourceDirectory + "/Key_and_Lock/lockHandle.obj", lockHandle);
+
+		// upload what the workers finished, a budget's worth per frame
+		while (!assetLoader.pump(Config::LOADING_UPLOAD_BUDGET_MS)) {
+			TextureStreamer::update();
+			drawLoadingScreen(assetLoader.progress());
+		}
 
 		baseSphereLocalAABBMin = sphere->getBoundingBoxMin();
 		baseSphereLocalAABBMax = sphere->getBoundingBoxMax();
@@ -678,9 +841,16 @@ public:
 		
 		initEnemies();
 		bossEnemy = new BossEnemy(bossSpawnPos, BOSS_HP_MAX, sphere, vec3(1.0f), vec3(0, 1, 0), BOSS_SPECIAL_ATTACK_COOLDOWN, SpellType::FIRE);
+
+		// every model and animation is loaded, drop the Assimp scenes
+		AssetRegistry::releaseImports();
+		// maps replaced by assignTexture lost their last user with the prototypes
+		TextureCache::evictUnused();
+		TextureCache::report();
 	}
 
-	void SetMaterial(shared_ptr<Program> shader, Material color) {
+	/* PBR parameters for each Material, packed into the MaterialData UBO once at init */
+	static MaterialData getMaterialData(Material color) {
 		/*
 		Albedo(Base Color) :
 		Never use pure black (0,0,0) or pure white (1,1,1)
@@ -705,134 +875,86 @@ public:
 		Good reference values can be found at physicallybased.info.
 		*/
 
-		if (!shader->hasUniform("hasMaterial")) return;
-
-		glUniform1i(shader->getUniform("hasMaterial"), GL_TRUE);
-
+		// { albedo, roughness, emission, metalness }
 		switch (color) {
 		case Material::purple:
-				glUniform3f(shader->getUniform("MatAlbedo"), 0.3f, 0.1f, 0.4f);
-				glUniform1f(shader->getUniform("MatRough"), 0.7f);
-				glUniform1f(shader->getUniform("MatMetal"), 0.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 0.0f, 0.0f, 0.0f);
-				break;
-			case Material::black:
-				glUniform3f(shader->getUniform("MatAlbedo"), 0.04f, 0.04f, 0.04f);
-				glUniform1f(shader->getUniform("MatRough"), 0.8f);
-				glUniform1f(shader->getUniform("MatMetal"), 0.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 0.0f, 0.0f, 0.0f);
-				break;
-			case Material::eye_white:
-				glUniform3f(shader->getUniform("MatAlbedo"), 0.95f, 0.95f, 0.95f);
-				glUniform1f(shader->getUniform("MatRough"), 0.2f);
-				glUniform1f(shader->getUniform("MatMetal"), 0.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 0.0f, 0.0f, 0.0f);
-				break;
-			case Material::pupil_white:
-				glUniform3f(shader->getUniform("MatAlbedo"), 0.85f, 0.85f, 0.9f);
-				glUniform1f(shader->getUniform("MatRough"), 0.1f);
-				glUniform1f(shader->getUniform("MatMetal"), 0.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 0.0f, 0.0f, 0.0f);
-				break;
-			case Material::bronze:
-				glUniform3f(shader->getUniform("MatAlbedo"), 0.714f, 0.4284f, 0.181f);
-				glUniform1f(shader->getUniform("MatRough"), 0.4f);
-				glUniform1f(shader->getUniform("MatMetal"), 1.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 0.0f, 0.0f, 0.0f);
-				break;
-			case Material::silver:
-				glUniform3f(shader->getUniform("MatAlbedo"), 0.972f, 0.960f, 0.915f);
-				glUniform1f(shader->getUniform("MatRough"), 0.2f);
-				glUniform1f(shader->getUniform("MatMetal"), 1.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 0.0f, 0.0f, 0.0f);
-				break;
-			case Material::brown:
-				glUniform3f(shader->getUniform("MatAlbedo"), 0.25f, 0.15f, 0.08f);
-				glUniform1f(shader->getUniform("MatRough"), 0.7f);
-				glUniform1f(shader->getUniform("MatMetal"), 0.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 0.0f, 0.0f, 0.0f);
-				break;
-			case Material::orb_glowing_blue:
-				glUniform3f(shader->getUniform("MatAlbedo"), 0.1f, 0.2f, 0.5f);
-				glUniform1f(shader->getUniform("MatRough"), 0.7f);
-				glUniform1f(shader->getUniform("MatMetal"), 0.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 0.1f, 0.2f, 1.0f);
-				break;
-			case Material::orb_glowing_red:
-				glUniform3f(shader->getUniform("MatAlbedo"), 0.5f, 0.1f, 0.1f);
-				glUniform1f(shader->getUniform("MatRough"), 1.0f);
-				glUniform1f(shader->getUniform("MatMetal"), 1.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 0.9f, 0.3f, 0.2f);
-				break;
-			case Material::orb_glowing_yellow:
-				glUniform3f(shader->getUniform("MatAlbedo"), 0.5f, 0.4f, 0.1f);
-				glUniform1f(shader->getUniform("MatRough"), 1.0f);
-				glUniform1f(shader->getUniform("MatMetal"), 1.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 0.9f, 0.8f, 0.2f);
-				break;
-			case Material::grey:
-				glUniform3f(shader->getUniform("MatAlbedo"), 0.8f, 0.8f, 0.8f);
-				glUniform1f(shader->getUniform("MatRough"), 0.6f);
-				glUniform1f(shader->getUniform("MatMetal"), 0.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 0.0f, 0.0f, 0.0f);
-				break;
-			case Material::wood:
-				glUniform3f(shader->getUniform("MatAlbedo"), 0.65f, 0.45f, 0.25f);
-				glUniform1f(shader->getUniform("MatRough"), 0.8f);
-				glUniform1f(shader->getUniform("MatMetal"), 0.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 0.0f, 0.0f, 0.0f);
-				break;
-			case Material::mini_map:
-				glUniform3f(shader->getUniform("MatAlbedo"), 0.65f, 0.45f, 0.25f);
-				glUniform1f(shader->getUniform("MatRough"), 0.0f);
-				glUniform1f(shader->getUniform("MatMetal"), 0.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 1.0f, 1.0f, 1.0f);
-				break;
-			case Material::defaultMaterial:
-				glUniform3f(shader->getUniform("MatAlbedo"), 0.5f, 0.5f, 0.5f);
-				glUniform1f(shader->getUniform("MatRough"), 0.0f);
-				glUniform1f(shader->getUniform("MatMetal"), 0.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 0.0f, 0.0f, 0.0f);
-				break;
-			case Material::blue_body:
-				glUniform3f(shader->getUniform("MatAlbedo"), 0.35f, 0.4f, 0.914f);
-				glUniform1f(shader->getUniform("MatRough"), 0.8f);
-				glUniform1f(shader->getUniform("MatMetal"), 0.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 0.0f, 0.0f, 0.0f);
-				break;
-			case Material::gold:
-				glUniform3f(shader->getUniform("MatAlbedo"), 1.0f, 0.766f, 0.336f);
-				glUniform1f(shader->getUniform("MatRough"), 0.2f);
-				glUniform1f(shader->getUniform("MatMetal"), 1.0f);
-				glUniform3f(shader->getUniform("MatEmit"), 0.0f, 0.0f, 0.0f);
-				break;
+			return { vec3(0.3f, 0.1f, 0.4f), 0.7f, vec3(0.0f, 0.0f, 0.0f), 0.0f };
+		case Material::black:
+			return { vec3(0.04f, 0.04f, 0.04f), 0.8f, vec3(0.0f, 0.0f, 0.0f), 0.0f };
+		case Material::eye_white:
+			return { vec3(0.95f, 0.95f, 0.95f), 0.2f, vec3(0.0f, 0.0f, 0.0f), 0.0f };
+		case Material::pupil_white:
+			return { vec3(0.85f, 0.85f, 0.9f), 0.1f, vec3(0.0f, 0.0f, 0.0f), 0.0f };
+		case Material::bronze:
+			return { vec3(0.714f, 0.4284f, 0.181f), 0.4f, vec3(0.0f, 0.0f, 0.0f), 1.0f };
+		case Material::silver:
+			return { vec3(0.972f, 0.960f, 0.915f), 0.2f, vec3(0.0f, 0.0f, 0.0f), 1.0f };
+		case Material::brown:
+			return { vec3(0.25f, 0.15f, 0.08f), 0.7f, vec3(0.0f, 0.0f, 0.0f), 0.0f };
+		case Material::orb_glowing_blue:
+			return { vec3(0.1f, 0.2f, 0.5f), 0.7f, vec3(0.1f, 0.2f, 1.0f), 0.0f };
+		case Material::orb_glowing_red:
+			return { vec3(0.5f, 0.1f, 0.1f), 1.0f, vec3(0.9f, 0.3f, 0.2f), 1.0f };
+		case Material::orb_glowing_yellow:
+			return { vec3(0.5f, 0.4f, 0.1f), 1.0f, vec3(0.9f, 0.8f, 0.2f), 1.0f };
+		case Material::grey:
+			return { vec3(0.8f, 0.8f, 0.8f), 0.6f, vec3(0.0f, 0.0f, 0.0f), 0.0f };
+		case Material::wood:
+			return { vec3(0.65f, 0.45f, 0.25f), 0.8f, vec3(0.0f, 0.0f, 0.0f), 0.0f };
+		case Material::mini_map:
+			return { vec3(0.65f, 0.45f, 0.25f), 0.0f, vec3(1.0f, 1.0f, 1.0f), 0.0f };
+		case Material::defaultMaterial:
+			return { vec3(0.5f, 0.5f, 0.5f), 0.0f, vec3(0.0f, 0.0f, 0.0f), 0.0f };
+		case Material::blue_body:
+			return { vec3(0.35f, 0.4f, 0.914f), 0.8f, vec3(0.0f, 0.0f, 0.0f), 0.0f };
+		case Material::gold:
+			return { vec3(1.0f, 0.766f, 0.336f), 0.2f, vec3(0.0f, 0.0f, 0.0f), 1.0f };
+		default:
+			return { vec3(0.5f, 0.5f, 0.5f), 0.0f, vec3(0.0f, 0.0f, 0.0f), 0.0f };
 		}
 	}
 
-	void setProgFlags(shared_ptr<Program> shader, bool hasMat, bool hasBones) {
-		if (hasMat && shader->hasUniform("hasMaterial")) {
-			glUniform1i(shader->getUniform("hasMaterial"), GL_TRUE);
-		}
-		else if (shader->hasUniform("hasMaterial")) {
-			glUniform1i(shader->getUniform("hasMaterial"), GL_FALSE);
-		}
+	void initUniformBlocks() {
+		frameUBO.init(sizeof(FrameData));
+		frameUBO.bindBase(FRAME_DATA_BINDING);
 
-		if (hasBones && shader->hasUniform("hasBones")) {
-			glUniform1i(shader->getUniform("hasBones"), GL_TRUE);
-		}
-		else if (shader->hasUniform("hasBones")) {
-			glUniform1i(shader->getUniform("hasBones"), GL_FALSE);
+		// every material gets its own aligned slice so SetMaterial is just a range bind
+		materialStride = UniformBuffer::alignedSize(sizeof(MaterialData));
+		std::vector<unsigned char> materials(materialStride * MATERIAL_COUNT, 0);
+		for (int i = 0; i < MATERIAL_COUNT; ++i) {
+			MaterialData data = getMaterialData((Material)i);
+			memcpy(&materials[i * materialStride], &data, sizeof(MaterialData));
 		}
+		materialUBO.init(materials.size(), GL_STATIC_DRAW);
+		materialUBO.update(materials.data(), materials.size());
+		materialUBO.bindRange(MATERIAL_DATA_BINDING, (int)Material::defaultMaterial * materialStride, sizeof(MaterialData));
+	}
+
+	/* upload the per-frame block shared by every program that declares FrameData */
+	void uploadFrameData() {
+		frameUBO.update(&frameData, sizeof(FrameData));
+	}
+
+	void SetMaterial(shared_ptr<Program> shader, Material color) {
+		if (!shader->supports(FEATURE_MATERIAL)) return;
+
+		shader->setFeature(FEATURE_MATERIAL, true);
+		materialUBO.bindRange(MATERIAL_DATA_BINDING, (int)color * materialStride, sizeof(MaterialData));
+	}
+
+	/* selects the permutation for a draw, features a program wasn't built with are ignored */
+	void setProgFlags(shared_ptr<Program> shader, bool hasMat, bool hasBones) {
+		shader->setFeature(FEATURE_MATERIAL, hasMat);
+		shader->setFeature(FEATURE_SKINNED, hasBones);
 	}
 
 	void clearProgFlags(shared_ptr<Program> shader) {
-		if (shader->hasUniform("hasMaterial")) glUniform1i(shader->getUniform("hasMaterial"), GL_FALSE);
-		if (shader->hasUniform("hasBones")) glUniform1i(shader->getUniform("hasBones"), GL_FALSE);
+		shader->setFeatures(shader->getFeatures() & ~(FEATURE_MATERIAL | FEATURE_SKINNED));
 	}
 
 	/* helper for sending top of the matrix strack to GPU */
 	void setModel(std::shared_ptr<Program> prog, std::shared_ptr<MatrixStack>M) {
-		glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE, value_ptr(M->topMatrix()));
+		prog->setUniform(UniformId::M, M->topMatrix());
 	}
 
 	/* helper function to set model trasnforms */
@@ -842,7 +964,7 @@ public:
 		mat4 RotY = glm::rotate(glm::mat4(1.0f), rotY, vec3(0, 1, 0));
 		mat4 ScaleS = glm::scale(glm::mat4(1.0f), vec3(sc));
 		mat4 ctm = Trans * RotX * RotY * ScaleS;
-		glUniformMatrix4fv(curS->getUniform("M"), 1, GL_FALSE, value_ptr(ctm));
+		curS->setUniform(UniformId::M, ctm);
 	}
 
 	void updateBoundingBox(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& transform, glm::vec3& outWorldMin, glm::vec3& outWorldMax) {
@@ -897,7 +1019,7 @@ public:
 
 		// Generate VAO
 		glGenVertexArrays(1, &GroundVertexArrayID);
-		glBindVertexArray(GroundVertexArrayID);
+		GLStateCache::bindVertexArray(GroundVertexArrayID);
 
 		// Position buffer (Attribute 0)
 		glGenBuffers(1, &GrndBuffObj);
@@ -919,7 +1041,7 @@ public:
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(idx), idx, GL_STATIC_DRAW);
 
 		// Unbind VAO and buffers (good practice)
-		glBindVertexArray(0);
+		GLStateCache::bindVertexArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
@@ -935,7 +1057,7 @@ public:
 
 		shader->bind(); // Bind the simple shader
 
-		glBindVertexArray(GroundVertexArrayID); // Bind ground VAO
+		GLStateCache::bindVertexArray(GroundVertexArrayID); // Bind ground VAO
 
 		// 1. Draw Library Ground
 		// Model->pushMatrix();
@@ -977,74 +1099,48 @@ public:
 		// Model->popMatrix();
 
 		// Unbind VAO after drawing all ground parts
-		glBindVertexArray(0);
+		GLStateCache::bindVertexArray(0);
 
 		shader->unbind(); // Unbind the simple shader
 	}
 
-	void initLibGrnd(float length, float width, float height, vec3 center_pos,
-		GLuint& LibGrndVertexArrayID, GLuint& LibGrndBuffObj, GLuint& LibGrndNormBuffObj, GLuint& LibGrndIndxBuffObj, GLuint& LibGrndTexBuffObj, int& g_GiboLen) {
-		// Define vertices for the library ground
-		float LibGrndPos[] = {
-			center_pos.x - length / 2, center_pos.y, center_pos.z - width / 2,
-			center_pos.x - length / 2, center_pos.y, center_pos.z + width / 2,
-			center_pos.x + length / 2, center_pos.y, center_pos.z + width / 2,
-			center_pos.x + length / 2, center_pos.y, center_pos.z - width / 2
-		};
-
-		// Normals point straight up
-		float LibGrndNorm[] = {
-			0, 1, 0,
-			0, 1, 0,
-			0, 1, 0,
-			0, 1, 0,
-			0, 1, 0,
-			0, 1, 0,
-		};
-
-		float LibGrndTex[] = {
-			0, 0,
-			0, 1,
-			1, 1,
-			1, 0,
-		};
+	/* builds a world space quad in the shared mesh arena, drawn with M = identity */
+	ArenaRange addArenaQuad(const vec3 pos[4], vec3 normal, const vec2 tex[4]) {
+		vector<Vertex> quad(4);
+		for (int i = 0; i < 4; ++i) {
+			quad[i] = Vertex{};
+			quad[i].Position = pos[i];
+			quad[i].Normal = normal;
+			quad[i].TexCoords = tex[i];
+			for (int k = 0; k < MAX_BONE_INFLUENCE; ++k) {
+				quad[i].m_BoneIDs[k] = -1;
+				quad[i].m_Weights[k] = 0.0f;
+			}
+		}
 
 		// Indices for two triangles covering the quad
-		unsigned short idx[] = { 0, 1, 2, 0, 2, 3 };
-		g_GiboLen = 6; // Number of indices
-
-		// Generate VAO
-		glGenVertexArrays(1, &LibGrndVertexArrayID);
-		glBindVertexArray(LibGrndVertexArrayID);
-
-		// Position buffer (Attribute 0)
-		glGenBuffers(1, &LibGrndBuffObj);
-		glBindBuffer(GL_ARRAY_BUFFER, LibGrndBuffObj);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(LibGrndPos), LibGrndPos, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-		// Normal buffer (Attribute 1)
-		glGenBuffers(1, &LibGrndNormBuffObj);
-		glBindBuffer(GL_ARRAY_BUFFER, LibGrndNormBuffObj);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(LibGrndNorm), LibGrndNorm, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		vector<unsigned int> idx = { 0, 1, 2, 0, 2, 3 };
+		return AssimpMesh::upload(quad, idx, VertexFormat::Static);
+	}
 
-		// Texture buffer (Attribute 2)
-		glGenBuffers(1, &LibGrndTexBuffObj);
-		glBindBuffer(GL_ARRAY_BUFFER, LibGrndTexBuffObj);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(LibGrndTex), LibGrndTex, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	ArenaRange initLibGrnd(float length, float width, float height, vec3 center_pos) {
+		// Define vertices for the library ground
+		vec3 LibGrndPos[] = {
+			vec3(center_pos.x - length / 2, center_pos.y, center_pos.z - width / 2),
+			vec3(center_pos.x - length / 2, center_pos.y, center_pos.z + width / 2),
+			vec3(center_pos.x + length / 2, center_pos.y, center_pos.z + width / 2),
+			vec3(center_pos.x + length / 2, center_pos.y, center_pos.z - width / 2)
+		};
 
-		// Index buffer
-		glGenBuffers(1, &LibGrndIndxBuffObj);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, LibGrndIndxBuffObj);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(idx), idx, GL_STATIC_DRAW);
+		vec2 LibGrndTex[] = {
+			vec2(0, 0),
+			vec2(0, 1),
+			vec2(1, 1),
+			vec2(1, 0),
+		};
 
-		// Unbind VAO and buffers (good practice)
-		glBindVertexArray(0);
+		// Normals point straight up
+		return addArenaQuad(LibGrndPos, vec3(0, 1, 0), LibGrndTex);
 	}
 
 	void addLibGrnd(float length, float width, float height, vec3 center_pos, shared_ptr<Texture> tex) {
@@ -1062,9 +1158,7 @@ public:
 		newLibGrnd.center_pos = center_pos;
 		newLibGrnd.texture = tex;
 
-		initLibGrnd(length, width, height, center_pos,
-			newLibGrnd.VAO, newLibGrnd.BuffObj, newLibGrnd.NorBuffObj,
-			newLibGrnd.IndxBuffObj, newLibGrnd.TexBuffObj, newLibGrnd.GiboLen);
+		newLibGrnd.range = initLibGrnd(length, width, height, center_pos);
 
 		libraryGrounds.push_back(newLibGrnd);
 		libraryGroundKeys.insert(key); // Add key to set to avoid duplicates
@@ -1080,63 +1174,61 @@ public:
 
 		// glUniform1i(shader->getUniform("hasTexture"), 1); // Set texture uniform
 
-		for (const auto& libGrnd : libraryGrounds) {
-			glBindVertexArray(libGrnd.VAO); // Bind each library ground VAO
+		// Grounds are in world space and share the mesh arena, one multi-draw per texture
+		Model->pushMatrix();
+		Model->loadIdentity();
+		setModel(shader, Model);
+		Model->popMatrix();
+		SetMaterial(shader, Material::wood);
+		GLStateCache::bindVertexArray(AssimpMesh::arena(VertexFormat::Static).getVAO());
+		drawArenaQuads(shader, libraryGrounds);
 
-			if (shader == ShadowProg) {
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, libGrnd.texture->getID());
-			}
+		GLStateCache::bindVertexArray(0); // Unbind VAO after drawing all library grounds
 
-			Model->pushMatrix();
-			Model->loadIdentity();
-			setModel(shader, Model);
+		shader->unbind(); // Unbind the simple shader
+	}
 
-			SetMaterial(shader, Material::wood);
-			glDrawElements(GL_TRIANGLES, libGrnd.GiboLen, GL_UNSIGNED_SHORT, 0);
-			Model->popMatrix();
+	/* batches world space arena quads by texture (only ShadowProg samples it) */
+	template <typename QuadObject>
+	void drawArenaQuads(shared_ptr<Program> shader, const vector<QuadObject>& quads) {
+		bool textured = shader == ShadowProg;
+		vector<bool> drawn(quads.size(), false);
+		for (size_t i = 0; i < quads.size(); ++i) {
+			if (drawn[i]) continue;
+
+			GLuint tex = quads[i].texture ? quads[i].texture->getID() : 0;
+			quadBatch.clear();
+			for (size_t j = i; j < quads.size(); ++j) {
+				GLuint otherTex = quads[j].texture ? quads[j].texture->getID() : 0;
+				if (!drawn[j] && (!textured || otherTex == tex)) {
+					quadBatch.add(quads[j].range);
+					drawn[j] = true;
+				}
+			}
 
-			if (shader == ShadowProg) {
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, 0);
-				libGrnd.texture->unbind(); // Unbind the texture after drawing each border
+			if (textured) {
+				GLStateCache::bindTexture(0, tex);
 			}
+			quadBatch.draw();
 		}
 
-		glBindVertexArray(0); // Unbind VAO after drawing all library grounds
-
-		shader->unbind(); // Unbind the simple shader
+		if (textured) {
+			GLStateCache::bindTexture(0, 0);
+		}
 	}
 
-
-	void initWall(float length, vec3 pos, vec3 dir, float height,
-		GLuint& WallVertexArrayID, GLuint& WallBuffObj, GLuint& WallNormBuffObj, GLuint& WIndxBuffObj, GLuint& WallTexBuffObj, int& w_GiboLen) {
+	ArenaRange initWall(float length, vec3 pos, vec3 dir, float height) {
 		vec3 dirNorm = normalize(dir);
 
 		// Define border vertices
 		// positioned relative to the bottom-left corner of the border
-		float WallPos[] = {
-			pos.x, pos.y, pos.z, // bottom-left
-			pos.x + dirNorm.x * length, pos.y, pos.z + dirNorm.z * length, // bottom-right
-			pos.x + dirNorm.x * length, pos.y + height, pos.z + dirNorm.z * length, // top-right
-			pos.x, pos.y + height, pos.z // top-left
-		};
-
-		// Normals face outward
-		float WallNorm[] = {
-			0, 0, 1,
-			0, 0, 1,
-			0, 0, 1,
-			0, 0, 1
+		vec3 WallPos[] = {
+			vec3(pos.x, pos.y, pos.z), // bottom-left
+			vec3(pos.x + dirNorm.x * length, pos.y, pos.z + dirNorm.z * length), // bottom-right
+			vec3(pos.x + dirNorm.x * length, pos.y + height, pos.z + dirNorm.z * length), // top-right
+			vec3(pos.x, pos.y + height, pos.z) // top-left
 		};
 
-		// float WallTex[] = {
-		// 	0, 0,
-		// 	1, 0,
-		// 	1, 1,
-		// 	0, 1
-		// };
-
 		// Repeating wall texture
 		float texRepeatPerUnit = 0.2f;
 
@@ -1144,48 +1236,15 @@ public:
 		float texRepeatX = length * texRepeatPerUnit;
 		float texRepeatY = height * texRepeatPerUnit;
 
-		float WallTex[] = {
-			0.0f,         0.0f,
-			texRepeatX,   0.0f,
-			texRepeatX,   texRepeatY,
-			0.0f,         texRepeatY
+		vec2 WallTex[] = {
+			vec2(0.0f,         0.0f),
+			vec2(texRepeatX,   0.0f),
+			vec2(texRepeatX,   texRepeatY),
+			vec2(0.0f,         texRepeatY)
 		};
 
-		unsigned short idx[] = { 0, 1, 2, 0, 2, 3 };
-		w_GiboLen = 6; // Number of indices
-
-		// Generate VAO
-		glGenVertexArrays(1, &WallVertexArrayID);
-		glBindVertexArray(WallVertexArrayID);
-
-		// Position buffer (Attribute 0)
-		glGenBuffers(1, &WallBuffObj);
-		glBindBuffer(GL_ARRAY_BUFFER, WallBuffObj);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(WallPos), WallPos, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-		// Normal buffer (Attribute 1)
-		glGenBuffers(1, &WallNormBuffObj);
-		glBindBuffer(GL_ARRAY_BUFFER, WallNormBuffObj);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(WallNorm), WallNorm, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-		// Texture buffer (Attribute 2)
-		glGenBuffers(1, &WallTexBuffObj);
-		glBindBuffer(GL_ARRAY_BUFFER, WallTexBuffObj);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(WallTex), WallTex, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-		// Index buffer
-		glGenBuffers(1, &WIndxBuffObj);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, WIndxBuffObj);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(idx), idx, GL_STATIC_DRAW);
-
-		// Unbind VAO and buffers (good practice)
-		glBindVertexArray(0);
+		// Normals face outward
+		return addArenaQuad(WallPos, vec3(0, 0, 1), WallTex);
 	}
 
 	void addWall(float length, vec3 pos, vec3 dir, float height, shared_ptr<Texture> tex) {
@@ -1201,9 +1260,7 @@ public:
 		newBorder.height = height;
 		newBorder.texture = tex;
 
-		initWall(length, pos, dir, height,
-			newBorder.WallVAID, newBorder.BuffObj, newBorder.NorBuffObj,
-			newBorder.IndxBuffObj, newBorder.TexBuffObj, newBorder.GiboLen);
+		newBorder.range = initWall(length, pos, dir, height);
 
 		borderWalls.push_back(newBorder);
 		borderWallKeys.insert(posKey); // Add key to set to avoid duplicates
@@ -1232,31 +1289,61 @@ public:
 
 		shader->bind(); // Bind the simple shader
 
-		for (const auto& border : borderWalls) {
-			glBindVertexArray(border.WallVAID); // Bind each border VAO
+		// Walls are in world space and share the mesh arena, one multi-draw per texture
+		Model->pushMatrix();
+		Model->loadIdentity();
+		setModel(shader, Model);
+		Model->popMatrix();
+		// SetMaterialMan(shader, 3); // Black material
+		GLStateCache::bindVertexArray(AssimpMesh::arena(VertexFormat::Static).getVAO());
+		drawArenaQuads(shader, borderWalls);
 
-			if (shader == ShadowProg) {
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, border.texture->getID());
-			}
+		GLStateCache::bindVertexArray(0); // Unbind VAO after drawing all borders
 
-			Model->pushMatrix();
-			Model->loadIdentity();
-			setModel(shader, Model);
-			// SetMaterialMan(shader, 3); // Black material
-			glDrawElements(GL_TRIANGLES, border.GiboLen, GL_UNSIGNED_SHORT, 0);
-			Model->popMatrix();
+		shader->unbind(); // Unbind the simple shader
+	}
 
-			if (shader == ShadowProg) {
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, 0);
-				border.texture->unbind(); // Unbind the texture after drawing each border
-			}
+	// Culling and screen size of the animated characters, for the next
+	// AnimationSystem::update's LOD choice
+	void reportAnimationViews() {
+		if (!catwizard_animator || !player_rig) {
+			return;
 		}
+		mat4 M = glm::translate(mat4(1.0f), player->getPosition())
+			* glm::rotate(mat4(1.0f), player->getRotY(), vec3(0, 1, 0))
+			* glm::scale(mat4(1.0f), vec3(0.01f)); // as drawPlayer
+		vec3 center;
+		float radius;
+		LodSelector::boundingSphere(player_rig, M, center, radius);
+		AnimationSystem::setView(catwizard_animator, !ViewFrustCull(center, radius, planes),
+			lodSelector.screenRadius(player_rig, M));
+	}
 
-		glBindVertexArray(0); // Unbind VAO after drawing all borders
+	// Stress test for the baked animation path: a ring of walking cats
+	// around the library center, each one instance of a single draw
+	void initCrowd() {
+		crowdWalk = AnimationBaker::bake(player_walk);
+		if (!crowdWalk.valid()) {
+			return;
+		}
+		crowd = make_unique<AnimatedCrowd>(player_rig, crowdWalk);
+		float clipSeconds = crowdWalk.frames / crowdWalk.frameRate;
+		for (int i = 0; i < Config::DEBUG_CROWD_SIZE; ++i) {
+			int ring = i / 16;
+			float angle = (i % 16) * (glm::two_pi<float>() / 16.0f) + ring * 0.2f;
+			float radius = 4.0f + ring * 1.5f;
+			vec3 pos = libraryCenter + vec3(cos(angle) * radius, 0.0f, sin(angle) * radius);
+			mat4 M = glm::translate(mat4(1.0f), pos)
+				* glm::rotate(mat4(1.0f), -angle, vec3(0, 1, 0))
+				* glm::scale(mat4(1.0f), vec3(0.01f)); // as drawPlayer
+			crowd->add(M, clipSeconds * (float)i / Config::DEBUG_CROWD_SIZE);
+		}
+	}
 
-		shader->unbind(); // Unbind the simple shader
+	void drawCrowd(const shared_ptr<Program>& curS) {
+		if (crowd) {
+			crowd->draw(curS, crowdTime);
+		}
 	}
 
 	void drawPlayer(shared_ptr<Program> curS, shared_ptr<MatrixStack> Model, float animTime) {
@@ -1273,29 +1360,22 @@ public:
 			manState = Man_State::IDLE;
 		}
 
-		if (animTime != 0.0) {
-			catwizard_animator->UpdateAnimation(1.5f * animTime);
-		}
-
-		// Animation update
+		// Animation update, no-op while the clip is already playing or fading in
 		if (manState == Man_State::WALKING) {
-			catwizard_animator->SetCurrentAnimation(player_walk);
+			catwizard_animator->CrossFade(player_walk, Config::ANIMATION_CROSSFADE_SECONDS);
 		}
 		else if (manState == Man_State::IDLE){
-			catwizard_animator->SetCurrentAnimation(player_idle);
+			catwizard_animator->CrossFade(player_idle, Config::ANIMATION_CROSSFADE_SECONDS);
 		}
 
-		// Update bone matrices
+		// Bone matrices AnimationSystem evaluated this frame, already in the bone palette
 
-		vector<glm::mat4> transforms = catwizard_animator->GetFinalBoneMatrices();
+		AnimationSystem::Palette palette = AnimationSystem::palette(catwizard_animator);
 
 
-		if (curS->hasUniform("finalBonesMatrices[0]")) {
-			int numBones = std::min((int)transforms.size(), Config::MAX_BONES);
-			for (int i = 0; i < numBones; ++i) {
-				string uniformName = "finalBonesMatrices[" + std::to_string(i) + "]";
-				glUniformMatrix4fv(curS->getUniform(uniformName), 1, GL_FALSE, value_ptr(transforms[i]));
-			}
+		// kept by the program until a SKINNED permutation is selected below
+		if (palette.count > 0) {
+			curS->setUniform(UniformId::boneBase, BonePalette::frameBase() + palette.offset);
 		}
 
 		// Model matrix setup
@@ -1320,19 +1400,17 @@ public:
 			manAABBmax);
 
 		// Set uniforms and draw
-		if (curS->hasUniform("texOnly")) glUniform1i(curS->getUniform("texOnly"), GL_TRUE);
-		if (curS->hasUniform("hasBones")) glUniform1i(curS->getUniform("hasBones"), GL_TRUE);
+		curS->setFeature(FEATURE_SKINNED, true);
 		setModel(curS, Model);
-		if (curS->hasUniform("texOnly")) glUniform1i(curS->getUniform("texOnly"), GL_FALSE);
-		player_rig->Draw(curS);
-		if (curS->hasUniform("hasBones")) glUniform1i(curS->getUniform("hasBones"), GL_FALSE);
+		player_rig->Draw(curS, lodSelector.select(player_rig, Model->topMatrix(), (size_t)player_rig));
+		curS->setFeature(FEATURE_SKINNED, false);
 		curS->unbind();
 		Model->popMatrix();
 	}
 
 	void drawBooks(shared_ptr<Program> shader, shared_ptr<MatrixStack> Model) {
 		shader->bind();
-		if (shader->hasUniform("texOnly")) glUniform1i(shader->getUniform("texOnly"), GL_TRUE);
+		shader->setFeature(FEATURE_TEX_ONLY, true);
 		for (const auto& book : books) {
 			// Common values for book halves
 			float bookThickness = book.scale.z * 0.15f;
@@ -1423,7 +1501,7 @@ public:
 				bookCover->Draw(shader);
 			} Model->popMatrix();
 		} // END draw books loop
-		if (shader->hasUniform("texOnly")) glUniform1i(shader->getUniform("texOnly"), GL_FALSE);
+		shader->setFeature(FEATURE_TEX_ONLY, false);
 		shader->unbind();
 	}
 
@@ -1577,9 +1655,9 @@ public:
 			//Model->scale(vec3(0.25f));
 			Model->rotate(glm::radians(-90.0f), vec3(1.0f, 0.0f, 0.0f));
 			setModel(shader, Model);
-			if (shader == ShadowProg) glUniform1i(shader->getUniform("texOnly"), GL_TRUE);
-			CatWizard->Draw(shader);
-			if (shader == ShadowProg) glUniform1i(shader->getUniform("texOnly"), GL_FALSE);
+			shader->setFeature(FEATURE_TEX_ONLY, true);
+			CatWizard->Draw(shader, lodSelector.select(CatWizard, Model->topMatrix()));
+			shader->setFeature(FEATURE_TEX_ONLY, false);
 		} Model->popMatrix();
 		shader->unbind();
 	}
@@ -1676,9 +1754,9 @@ public:
 				Model->rotate(enemy->getRotY(), glm::vec3(0, 1, 0));
 				Model->rotate(glm::radians(-90.0f), glm::vec3(1, 0, 0)); // rotate -90 degrees around x axis
 				SetMaterial(shader, Material::blue_body); // Set body material
-				if (shader->hasUniform("enemyAlpha")) glUniform1f(shader->getUniform("enemyAlpha"), enemy->getDamageTimer() / Config::ENEMY_HIT_DURATION);
+				shader->setUniform(UniformId::enemyAlpha, enemy->getDamageTimer() / Config::ENEMY_HIT_DURATION);
 				setModel(shader, Model);
-				iceElemental->Draw(shader); // Draw the scaled sphere as the body
+				iceElemental->Draw(shader, lodSelector.select(iceElemental, Model->topMatrix(), (size_t)enemy)); // Draw the scaled sphere as the body
 			} Model->popMatrix();
 			shader->unbind();
 		} // End loop through enemies
@@ -1688,9 +1766,6 @@ public:
 		if (!shader || !Model || !book_shelf1 || grid.getSize().x == 0 || grid.getSize().y == 0) return; // Safety checks
 
 		shader->bind();
-		//if (shader == ShadowProg) {
-		//	glUniform1i(shader->getUniform("hasMaterial"), 0); // Bookshelves should use texture
-		//}
 
 		float groundSize = Config::GROUND_SIZE;
 
@@ -1705,6 +1780,7 @@ public:
 				glm::ivec2 gridPos(x, z);
 				float i = library->mapGridXtoWorldX(x); // Center the shelf in the cell
 				float j = library->mapGridYtoWorldZ(z); // Center the shelf in the cell
+				if (cullFlag && isChunkOcclusionCulled(libraryChunkNodes, grid.getSize().x, x, z)) continue;
 				if (!cullFlag || !ViewFrustCull(glm::vec3(i, 0, j), 2.0f, planes)) {
 					if (grid[gridPos].type == LibraryGen::CellType::CLUSTER) {
 						if (grid[gridPos].clusterType == LibraryGen::ClusterType::SHELF1) {
@@ -1713,8 +1789,7 @@ public:
 							// Model->translate(vec3(worldX, libraryCenter.y, worldZ)); // Position shelf at cell center on ground
 							Model->translate(vec3(i, libraryCenter.y, j)); // Position wall at cell center on ground
 							Model->scale(grid[gridPos].transformData.scale);
-							setModel(shader, Model);
-							book_shelf1->Draw(shader);
+							staticDraws.submit(shader, book_shelf1, Model->topMatrix());
 							Model->popMatrix();
 						}
 						else if (grid[gridPos].clusterType == LibraryGen::ClusterType::SHELF2) {
@@ -1724,8 +1799,7 @@ public:
 							Model->loadIdentity();
 							Model->translate(vec3(i, libraryCenter.y, j)); // Position wall at cell center on ground
 							Model->scale(grid[gridPos].transformData.scale);
-							setModel(shader, Model);
-							book_shelf1->Draw(shader);
+							staticDraws.submit(shader, book_shelf1, Model->topMatrix());
 							Model->popMatrix();
 						}
 						else if (grid[gridPos].clusterType == LibraryGen::ClusterType::SHELF3) {
@@ -1734,8 +1808,7 @@ public:
 							Model->translate(vec3(i, libraryCenter.y, j)); // Position wall at cell center on ground
 							Model->rotate(glm::radians(90.0f), vec3(0, 1, 0)); // Rotate for left/right walls
 							Model->scale(grid[gridPos].transformData.scale);
-							setModel(shader, Model);
-							book_shelf1->Draw(shader);
+							staticDraws.submit(shader, book_shelf1, Model->topMatrix());
 							Model->popMatrix();
 						}
 						else if (grid[gridPos].clusterType == LibraryGen::ClusterType::ONLY_CANDELABRA) {
@@ -1743,8 +1816,7 @@ public:
 							Model->loadIdentity();
 							Model->translate(vec3(i, libraryCenter.y, j)); // Position wall at cell center on ground
 							Model->scale(grid[gridPos].transformData.scale);
-							setModel(shader, Model);
-							candelabra->Draw(shader);
+							staticDraws.submit(shader, candelabra, Model->topMatrix());
 							Model->popMatrix();
 						}
 						else if (grid[gridPos].clusterType == LibraryGen::ClusterType::ONLY_CHEST) {
@@ -1752,8 +1824,7 @@ public:
 							Model->loadIdentity();
 							Model->translate(vec3(i, libraryCenter.y, j)); // Position wall at cell center on ground
 							Model->scale(grid[gridPos].transformData.scale);
-							setModel(shader, Model);
-							chest->Draw(shader);
+							staticDraws.submit(shader, chest, Model->topMatrix());
 							Model->popMatrix();
 						}
 						else if (grid[gridPos].clusterType == LibraryGen::ClusterType::ONLY_TABLE) {
@@ -1761,8 +1832,7 @@ public:
 							Model->loadIdentity();
 							Model->translate(vec3(i, libraryCenter.y, j)); // Position wall at cell center on ground
 							Model->scale(grid[gridPos].transformData.scale);
-							setModel(shader, Model);
-							table_chairs1->Draw(shader);
+							staticDraws.submit(shader, table_chairs1, Model->topMatrix());
 							Model->popMatrix();
 
 							addLibGrnd(5.0f, 5.0f, 1.0f, vec3(i, libraryCenter.y + 0.1f, j), carpetTex);
@@ -1772,8 +1842,7 @@ public:
 							Model->loadIdentity();
 							Model->translate(vec3(i, libraryCenter.y, j)); // Position wall at cell center on ground
 							Model->scale(grid[gridPos].transformData.scale);
-							setModel(shader, Model);
-							grandfather_clock->Draw(shader);
+							staticDraws.submit(shader, grandfather_clock, Model->topMatrix());
 							Model->popMatrix();
 						}
 						else if (grid[gridPos].clusterType == LibraryGen::ClusterType::LAYOUT1) {
@@ -1782,8 +1851,7 @@ public:
 								Model->loadIdentity();
 								Model->translate(vec3(i, libraryCenter.y, j)); // Position shelf at cell center on ground
 								Model->scale(grid[gridPos].transformData.scale);
-								setModel(shader, Model);
-								book_shelf1->Draw(shader);
+								staticDraws.submit(shader, book_shelf1, Model->topMatrix());
 								Model->popMatrix();
 							}
 							else if (grid[gridPos].objectType == LibraryGen::CellObjType::ROTATED_BOOKSHELF) {
@@ -1792,8 +1860,7 @@ public:
 								Model->translate(vec3(i, libraryCenter.y, j)); // Position shelf at cell center on ground
 								Model->rotate(glm::radians(90.0f), vec3(0, 1, 0)); // Rotate for left/right walls
 								Model->scale(grid[gridPos].transformData.scale);
-								setModel(shader, Model);
-								book_shelf1->Draw(shader);
+								staticDraws.submit(shader, book_shelf1, Model->topMatrix());
 								Model->popMatrix();
 							}
 							else if (grid[gridPos].objectType == LibraryGen::CellObjType::TABLE_AND_CHAIR2) {
@@ -1801,8 +1868,7 @@ public:
 								Model->loadIdentity();
 								Model->translate(vec3(i, libraryCenter.y, j)); // Position shelf at cell center on ground
 								Model->scale(grid[gridPos].transformData.scale);
-								setModel(shader, Model);
-								table_chairs1->Draw(shader);
+								staticDraws.submit(shader, table_chairs1, Model->topMatrix());
 								Model->popMatrix();
 
 								addLibGrnd(5.0f, 5.0f, 1.0f, vec3(i, libraryCenter.y + 0.1f, j), carpetTex);
@@ -1813,8 +1879,7 @@ public:
 								Model->loadIdentity();
 								Model->translate(vec3(i, libraryCenter.y, j)); // Position shelf at cell center on ground
 								Model->scale(grid[gridPos].transformData.scale);
-								setModel(shader, Model);
-								table_chairs1->Draw(shader);
+								staticDraws.submit(shader, table_chairs1, Model->topMatrix());
 								Model->popMatrix();
 
 								addLibGrnd(5.0f, 5.0f, 1.0f, vec3(i, libraryCenter.y + 0.1f, j), carpetTex);
@@ -1824,8 +1889,7 @@ public:
 								Model->loadIdentity();
 								Model->translate(vec3(i, libraryCenter.y, j)); // Position shelf at cell center on ground
 								Model->scale(grid[gridPos].transformData.scale);
-								setModel(shader, Model);
-								candelabra->Draw(shader);
+								staticDraws.submit(shader, candelabra, Model->topMatrix());
 								Model->popMatrix();
 							}
 							else if (grid[gridPos].objectType == LibraryGen::CellObjType::GRANDFATHER_CLOCK) {
@@ -1833,8 +1897,7 @@ public:
 								Model->loadIdentity();
 								Model->translate(vec3(i, libraryCenter.y, j)); // Position shelf at cell center on ground
 								Model->scale(grid[gridPos].transformData.scale);
-								setModel(shader, Model);
-								grandfather_clock->Draw(shader);
+								staticDraws.submit(shader, grandfather_clock, Model->topMatrix());
 								Model->popMatrix();
 							}
 							else if (grid[gridPos].objectType == LibraryGen::CellObjType::CHEST) {
@@ -1842,8 +1905,7 @@ public:
 								Model->loadIdentity();
 								Model->translate(vec3(i, libraryCenter.y, j)); // Position shelf at cell center on ground
 								Model->scale(grid[gridPos].transformData.scale);
-								setModel(shader, Model);
-								chest->Draw(shader);
+								staticDraws.submit(shader, chest, Model->topMatrix());
 								Model->popMatrix();
 							}
 						}
@@ -1852,8 +1914,7 @@ public:
 							Model->loadIdentity();
 							Model->translate(vec3(i, libraryCenter.y, j)); // Position shelf at cell center on ground
 							Model->scale(grid[gridPos].transformData.scale);
-							setModel(shader, Model);
-							bookstand->Draw(shader);
+							staticDraws.submit(shader, bookstand, Model->topMatrix());
 							Model->popMatrix();
 						}
 						else if (grid[gridPos].clusterType == LibraryGen::ClusterType::GLOWING_SHELF1) {
@@ -1862,8 +1923,7 @@ public:
 								Model->loadIdentity();
 								Model->translate(vec3(i, libraryCenter.y, j)); // Position shelf at cell center on ground
 								Model->scale(grid[gridPos].transformData.scale);
-								setModel(shader, Model);
-								book_shelf2->Draw(shader);
+								staticDraws.submit(shader, book_shelf2, Model->topMatrix());
 								Model->popMatrix();
 							}
 							else if (grid[gridPos].objectType == LibraryGen::CellObjType::BOOKSHELF) {
@@ -1871,8 +1931,7 @@ public:
 								Model->loadIdentity();
 								Model->translate(vec3(i, libraryCenter.y, j)); // Position shelf at cell center on ground
 								Model->scale(grid[gridPos].transformData.scale);
-								setModel(shader, Model);
-								book_shelf1->Draw(shader);
+								staticDraws.submit(shader, book_shelf1, Model->topMatrix());
 								Model->popMatrix();
 							}
 						}
@@ -1883,8 +1942,7 @@ public:
 								Model->translate(vec3(i, libraryCenter.y, j)); // Position shelf at cell center on ground
 								Model->rotate(glm::radians(90.0f), vec3(0, 1, 0)); // Rotate for left/right walls
 								Model->scale(grid[gridPos].transformData.scale);
-								setModel(shader, Model);
-								book_shelf2->Draw(shader);
+								staticDraws.submit(shader, book_shelf2, Model->topMatrix());
 								Model->popMatrix();
 							}
 							else if (grid[gridPos].objectType == LibraryGen::CellObjType::ROTATED_BOOKSHELF) {
@@ -1893,8 +1951,7 @@ public:
 								Model->translate(vec3(i, libraryCenter.y, j)); // Position shelf at cell center on ground
 								Model->rotate(glm::radians(90.0f), vec3(0, 1, 0)); // Rotate for left/right walls
 								Model->scale(grid[gridPos].transformData.scale);
-								setModel(shader, Model);
-								book_shelf1->Draw(shader);
+								staticDraws.submit(shader, book_shelf1, Model->topMatrix());
 								Model->popMatrix();
 							}
 						}
@@ -1902,6 +1959,7 @@ public:
 				}
 			}
 		}
+		staticDraws.flush();
 		shader->unbind();
 	}
 
@@ -1909,15 +1967,12 @@ public:
 		if (!shader || !Model) return;
 		shader->bind();
 
-		/*if (shader == ShadowProg) {
-			glUniform1i(shader->getUniform("hasMaterial"), 0);
-		}*/
-
 		for (int z = 0; z < bossGrid.getSize().y; ++z) {
 			for (int x = 0; x < bossGrid.getSize().x; ++x) {
 				glm::ivec2 gridPos(x, z);
 				float i = bossRoom->mapGridXtoWorldX(x); // Center the shelf in the cell
 				float j = bossRoom->mapGridYtoWorldZ(z); // Center the shelf in the cell
+				if (cullFlag && isChunkOcclusionCulled(bossChunkNodes, bossGrid.getSize().x, x, z)) continue;
 				if (!cullFlag || !ViewFrustCull(glm::vec3(i, 0, j), 2.0f, planes)) {
 					if (bossGrid[gridPos].type == BossRoomGen::CellType::BORDER) {
 						int test = bossRoom->mapXtoGridX(i);
@@ -1927,8 +1982,7 @@ public:
 						Model->translate(vec3(i, libraryCenter.y, j)); // Position set in class members
 						Model->rotate(glm::radians(bossGrid[gridPos].transformData.rotation), vec3(0, 1, 0)); // Rotate for left/right walls
 						Model->scale(bossGrid[gridPos].transformData.scale); // Scale set in class members
-						setModel(shader, Model);
-						book_shelf1->Draw(shader); // Use the bookshelf model for the border
+						staticDraws.submit(shader, book_shelf1, Model->topMatrix()); // Use the bookshelf model for the border
 						Model->popMatrix();
 					}
 					else if (bossGrid[gridPos].type == BossRoomGen::CellType::ENTRANCE) {
@@ -1938,9 +1992,8 @@ public:
 							Model->translate(vec3(i, 0, j));
 							Model->rotate(glm::radians(bossGrid[gridPos].transformData.rotation), vec3(0, 1, 0)); // Rotate for left/right walls
 							Model->scale(bossGrid[gridPos].transformData.scale); // Scale set in class members
-							setModel(shader, Model);
 							if (unlock == false) {
-								door->Draw(shader); // Use the door model for the entrance
+								staticDraws.submit(shader, door, Model->topMatrix()); // Use the door model for the entrance
 							}
 
 							Model->popMatrix();
@@ -1951,8 +2004,7 @@ public:
 							Model->translate(vec3(i, 0, j));
 							Model->rotate(glm::radians(bossGrid[gridPos].transformData.rotation), vec3(0, 1, 0)); // Rotate for left/right walls
 							Model->scale(bossGrid[gridPos].transformData.scale); // Scale set in class members
-							setModel(shader, Model);
-							book_shelf1->Draw(shader); // Use the door model for the entrance
+							staticDraws.submit(shader, book_shelf1, Model->topMatrix()); // Use the door model for the entrance
 							Model->popMatrix();
 						}
 					}
@@ -1963,8 +2015,7 @@ public:
 							Model->translate(vec3(i, 0, j));
 							Model->rotate(glm::radians(bossGrid[gridPos].transformData.rotation), vec3(0, 1, 0)); // Rotate for left/right walls
 							Model->scale(bossGrid[gridPos].transformData.scale); // Scale set in class members
-							setModel(shader, Model);
-							door->Draw(shader); // Use the door model for the entrance
+							staticDraws.submit(shader, door, Model->topMatrix()); // Use the door model for the entrance
 							Model->popMatrix();
 						}
 						else if (bossGrid[gridPos].borderType == BossRoomGen::BorderType::EXIT_SIDE) {
@@ -1973,8 +2024,7 @@ public:
 							Model->translate(vec3(i, 0, j));
 							Model->rotate(glm::radians(bossGrid[gridPos].transformData.rotation), vec3(0, 1, 0)); // Rotate for left/right walls
 							Model->scale(bossGrid[gridPos].transformData.scale); // Scale set in class members
-							setModel(shader, Model);
-							book_shelf1->Draw(shader); // Use the door model for the entrance
+							staticDraws.submit(shader, book_shelf1, Model->topMatrix()); // Use the door model for the entrance
 							Model->popMatrix();
 						}
 					} else if (bossGrid[gridPos].type == BossRoomGen::CellType::CLUSTER) {
@@ -1985,8 +2035,7 @@ public:
 								Model->translate(vec3(i, libraryCenter.y, j)); // Position shelf at cell center on ground
 								Model->rotate(glm::radians(bossGrid[gridPos].transformData.rotation), vec3(0, 1, 0)); // Rotate for left/right walls
 								Model->scale(bossGrid[gridPos].transformData.scale); // Scale set in class members
-								setModel(shader, Model);
-								book_shelf2->Draw(shader);
+								staticDraws.submit(shader, book_shelf2, Model->topMatrix());
 								Model->popMatrix();
 							}
 						}
@@ -1994,6 +2043,7 @@ public:
 				}
 			}
 		}
+		staticDraws.flush();
 		shader->unbind();
 	}
 
@@ -3250,16 +3300,16 @@ public:
 	}
 
 	/* top down camera view  */
-	mat4 SetTopView(shared_ptr<Program> curShade) { /*MINI MAP*/
+	mat4 SetTopView() { /*MINI MAP*/
 		mat4 Cam = glm::lookAt(eye + vec3(0, 12, 0), eye, lookAt - eye);
-		glUniformMatrix4fv(curShade->getUniform("V"), 1, GL_FALSE, value_ptr(Cam));
+		frameData.V = Cam;
 		return Cam;
 	}
 
-	mat4 SetOrthoMatrix(shared_ptr<Program> curShade) {/*MINI MAP*/
+	mat4 SetOrthoMatrix() {/*MINI MAP*/
 		float wS = 1.5;
 		mat4 ortho = glm::ortho(-15.0f * wS, 15.0f * wS, -15.0f * wS, 15.0f * wS, 2.1f, 100.f);
-		glUniformMatrix4fv(curShade->getUniform("P"), 1, GL_FALSE, value_ptr(ortho));
+		frameData.P = ortho;
 		return ortho;
   }
 
@@ -3315,11 +3365,11 @@ public:
 		model = glm::scale(model, glm::vec3(heatlhBarWidth, healthBarHeight, 1.0f));                          // HUD size
 
 		hudProg->bind();
-		glUniformMatrix4fv(hudProg->getUniform("projection"), 1, GL_FALSE, value_ptr(projection));
-		glUniformMatrix4fv(hudProg->getUniform("model"), 1, GL_FALSE, value_ptr(model));
-		glUniform1f(hudProg->getUniform("healthPercent"), player->getHitpoints() / Config::PLAYER_HP_MAX); // Pass health value
-		glUniform1f(hudProg->getUniform("BarStartX"), healthBarStartX); // Pass max health value
-		glUniform1f(hudProg->getUniform("BarWidth"), heatlhBarWidth); // Pass max health value
+		hudProg->setUniform(UniformId::projection, projection);
+		hudProg->setUniform(UniformId::model, model);
+		hudProg->setUniform(UniformId::healthPercent, player->getHitpoints() / Config::PLAYER_HP_MAX); // Pass health value
+		hudProg->setUniform(UniformId::BarStartX, healthBarStartX); // Pass max health value
+		hudProg->setUniform(UniformId::BarWidth, heatlhBarWidth); // Pass max health value
 
 		healthBar->Draw(hudProg);
 		hudProg->unbind();
@@ -3341,7 +3391,7 @@ public:
 		// The Model stack is passed in, so push, load identity, then pop to keep it clean for the stack
 		Model->pushMatrix(); {
 			Model->loadIdentity();
-			glUniformMatrix4fv(shader->getUniform("M"), 1, GL_FALSE, value_ptr(Model->topMatrix())); // M is now identity
+			shader->setUniform(UniformId::M, Model->topMatrix()); // M is now identity
 			gen->drawMe(shader); // gen->drawMe will set its own blend/depth states and draw
 		} Model->popMatrix(); // Restore original Model stack state
 		// Restore state --- gen->drawMe() handles its own GL state restoration
@@ -3390,11 +3440,11 @@ public:
 			model = glm::scale(model, glm::vec3(healthBarWidth, healthBarHeight, 1.0f));
 
 			hudProg->bind();
-			glUniformMatrix4fv(hudProg->getUniform("projection"), 1, GL_FALSE, glm::value_ptr(hudProjection));
-			glUniformMatrix4fv(hudProg->getUniform("model"), 1, GL_FALSE, glm::value_ptr(model));
-			glUniform1f(hudProg->getUniform("healthPercent"), enemy->getHitpoints() / ENEMY_HP_MAX);
-			glUniform1f(hudProg->getUniform("BarStartX"), screenPos.x - (healthBarWidth / 2.0f));
-			glUniform1f(hudProg->getUniform("BarWidth"), healthBarWidth);
+			hudProg->setUniform(UniformId::projection, hudProjection);
+			hudProg->setUniform(UniformId::model, model);
+			hudProg->setUniform(UniformId::healthPercent, enemy->getHitpoints() / ENEMY_HP_MAX);
+			hudProg->setUniform(UniformId::BarStartX, screenPos.x - (healthBarWidth / 2.0f));
+			hudProg->setUniform(UniformId::BarWidth, healthBarWidth);
 
 			healthBar->Draw(hudProg);
 			hudProg->unbind();
@@ -3724,11 +3774,11 @@ public:
 			model = glm::scale(model, glm::vec3(healthBarWidth, healthBarHeight, 1.0f));
 
 			hudProg->bind();
-			glUniformMatrix4fv(hudProg->getUniform("projection"), 1, GL_FALSE, glm::value_ptr(hudProjection));
-			glUniformMatrix4fv(hudProg->getUniform("model"), 1, GL_FALSE, glm::value_ptr(model));
-			glUniform1f(hudProg->getUniform("healthPercent"), bossEnemy->getHitpoints() / BOSS_HP_MAX);
-			glUniform1f(hudProg->getUniform("BarStartX"), screenPos.x - (healthBarWidth / 2.0f));
-			glUniform1f(hudProg->getUniform("BarWidth"), healthBarWidth);
+			hudProg->setUniform(UniformId::projection, hudProjection);
+			hudProg->setUniform(UniformId::model, model);
+			hudProg->setUniform(UniformId::healthPercent, bossEnemy->getHitpoints() / BOSS_HP_MAX);
+			hudProg->setUniform(UniformId::BarStartX, screenPos.x - (healthBarWidth / 2.0f));
+			hudProg->setUniform(UniformId::BarWidth, healthBarWidth);
 			healthBar->Draw(hudProg);
 			hudProg->unbind();
 		}
@@ -3746,9 +3796,9 @@ public:
 		glm::mat4 proj = glm::ortho(0.0f, (float)screenWidth, 0.0f, (float)screenHeight, -1.0f, 1.0f);
 		glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0, 0, 0));
 		model = glm::scale(model, glm::vec3(screenWidth, screenHeight, 1.0f));
-		glUniformMatrix4fv(redFlashProg->getUniform("projection"), 1, GL_FALSE, value_ptr(proj));
-		glUniformMatrix4fv(redFlashProg->getUniform("model"), 1, GL_FALSE, value_ptr(model));
-		glUniform1f(redFlashProg->getUniform("alpha"), alpha); // Red color with alpha
+		redFlashProg->setUniform(UniformId::projection, proj);
+		redFlashProg->setUniform(UniformId::model, model);
+		redFlashProg->setUniform(UniformId::alpha, alpha); // Red color with alpha
 
 		healthBar->Draw(redFlashProg);
 		redFlashProg->unbind();
@@ -3777,14 +3827,23 @@ public:
 		shader->unbind();
 	}
 
-	void setCameraProjectionFromStack(shared_ptr<Program> curShade, shared_ptr<MatrixStack> projStack) {
-		curShade->bind();
-		glUniformMatrix4fv(curShade->getUniform("P"), 1, GL_FALSE, value_ptr(projStack->topMatrix()));
-	}
+	// Draw the cube model stretched over a world space box (occlusion proxy)
+	void drawOcclusionBox(shared_ptr<Program> shader, shared_ptr<MatrixStack> Model, const vec3& boxMin, const vec3& boxMax) {
+		if (!shader || !Model || !cube) return;
+
+		vec3 cubeMin = cube->getBoundingBoxMin();
+		vec3 cubeMax = cube->getBoundingBoxMax();
 
-	void setCameraViewFromStack(shared_ptr<Program> curShade, shared_ptr<MatrixStack> viewStack) {
-		curShade->bind();
-		glUniformMatrix4fv(curShade->getUniform("V"), 1, GL_FALSE, value_ptr(viewStack->topMatrix()));
+		shader->bind();
+		Model->pushMatrix();
+		Model->loadIdentity();
+		Model->translate(boxMin);
+		Model->scale((boxMax - boxMin) / (cubeMax - cubeMin));
+		Model->translate(-cubeMin);
+		setModel(shader, Model);
+		cube->Draw(shader);
+		Model->popMatrix();
+		shader->unbind();
 	}
 
 	// Draw the scene for shadow map generation (Draw only shadow-casting objects) (First Pass)
@@ -3823,6 +3882,7 @@ public:
 
 
 		drawPlayer(prog, Model, 0.0);
+		drawCrowd(prog);
 
 		// 4. Draw Falling/Interactable Books
 		drawBooks(prog, Model);
@@ -3871,29 +3931,12 @@ public:
 
 		drawBossRoom(prog, Model, true); // Draw the boss room
 
-		// disable color writes
-		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-		// disable depth writes
-		glDepthMask(GL_FALSE);
-
-		// begin occlusion query
-		glBeginQuery(GL_ANY_SAMPLES_PASSED, occlusionQueryID);
-
-		// Draw a small sphere at the player's position
-		drawOcclusionBoxAtPlayer(prog, Model);
-
-		glEndQuery(GL_ANY_SAMPLES_PASSED);
-
-		GLuint resultofQuery = 0;
-		glGetQueryObjectuiv(occlusionQueryID, GL_QUERY_RESULT, &resultofQuery);
-		visible = resultofQuery;
-
-		// re-enable color writes and depth writes
-		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-		glDepthMask(GL_TRUE);
+		// Test the camera sphere and chunk boxes against the static occluders drawn so far
+		issueOcclusionQueries(prog, Model);
 
 
 		drawPlayer(prog, Model, animTime);
+		drawCrowd(prog);
 
 		// 4. Draw Falling/Interactable Books
 		drawBooks(prog, Model);
@@ -3927,16 +3970,32 @@ public:
 		drawBossEnemy(prog, Model);
 	}
 
-	void occlusionQuery(const shared_ptr<Program>& shader, shared_ptr<MatrixStack>& Model) {
+	// Issue this frame's occlusion queries. Results are read back by occlusionPool a few
+	// frames later, so nothing here waits on the GPU.
+	void issueOcclusionQueries(const shared_ptr<Program>& shader, shared_ptr<MatrixStack>& Model) {
 		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE); // disable color writes
 		glDepthMask(GL_FALSE); // disable depth writes
-		glBeginQuery(GL_ANY_SAMPLES_PASSED, occlusionQueryID); // begin occlusion query
+
+		// Draw a small sphere at the player's position
+		occlusionPool.beginQuery(CAMERA_QUERY_SLOT);
 		drawOcclusionBoxAtPlayer(shader, Model);
-		glEndQuery(GL_ANY_SAMPLES_PASSED);
+		occlusionPool.endQuery();
+
+		if (Config::OCCLUSION_CULLING) {
+			for (size_t n = 0; n < occlusionNodes.size(); ++n) {
+				const OcclusionNode& node = occlusionNodes[n];
+				// Children of a hidden region are not tested until the region shows up again
+				if (node.parent >= 0 && occlusionCulled[node.parent]) continue;
+				if (eyeInsideBox(node)) continue;
 
-		GLuint resultofQuery = 0;
-		glGetQueryObjectuiv(occlusionQueryID, GL_QUERY_RESULT, &resultofQuery);
-		visible = resultofQuery;
+				vec3 center = 0.5f * (node.boxMin + node.boxMax);
+				if (ViewFrustCull(center, glm::length(node.boxMax - center), planes)) continue;
+
+				occlusionPool.beginQuery(node.slot);
+				drawOcclusionBox(shader, Model, node.boxMin, node.boxMax);
+				occlusionPool.endQuery();
+			}
+		}
 
 		// re-enable color writes and depth writes
 		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
@@ -3949,6 +4008,13 @@ public:
 		glfwGetFramebufferSize(windowManager->getHandle(), &width, &height);
 		float aspect = width / (float)height;
 
+		// Large textures still streaming in get their next chunks (never blocks)
+		TextureStreamer::update();
+
+		// Harvest occlusion results issued a few frames ago (never blocks)
+		occlusionPool.beginFrame();
+		visible = occlusionPool.isVisible(CAMERA_QUERY_SLOT) ? 1 : 0;
+
 		// --- Update Game Logic ---
 		charMove();
 		updateCameraVectors();
@@ -3964,6 +4030,12 @@ public:
 		BossEnemyShoot(frametime);
 		restartGeneration();
 
+		// Every animator's pose, evaluated in parallel into one palette buffer
+		// and uploaded in one go for all skinned draws
+		AnimationSystem::update(animTime);
+		crowdTime += animTime; // the baked crowd needs no update, only its clock
+		BonePalette::upload(AnimationSystem::buffer().data(), AnimationSystem::matrixCount());
+
 		// Create the matrix stacks
 		auto Projection = make_shared<MatrixStack>();
 		auto View = make_shared<MatrixStack>();
@@ -3989,11 +4061,11 @@ public:
 			// Create a stable orthographic projection that covers the scene
 			float size = Config::ORTHO_SIZE;
 			LO = glm::ortho(-size, size, -size, size, 1.0f, 200.0f);
-			glUniformMatrix4fv(DepthProg->getUniform("LP"), 1, GL_FALSE, value_ptr(LO));
+			DepthProg->setUniform(UniformId::LP, LO);
 
 			// Create a stable light view matrix
 			LV = glm::lookAt(lightPos, lightTarget, lightUp);
-			glUniformMatrix4fv(DepthProg->getUniform("LV"), 1, GL_FALSE, value_ptr(LV));
+			DepthProg->setUniform(UniformId::LV, LV);
 
 			CULL = false;
 			drawSceneForShadowMap(DepthProg); // Draw the scene from the lights perspective
@@ -4018,6 +4090,21 @@ public:
 		View->lookAt(eye, lookAt, up); // Use updated eye/lookAt
 
 		ExtractVFPlanes(Projection->topMatrix(), View->topMatrix(), planes); // Update frustum planes
+		updateOcclusionCulling();
+
+		// Camera and light data shared by every program, uploaded once
+		LSpace = LO * LV;
+		frameData.P = Projection->topMatrix();
+		frameData.V = View->topMatrix();
+		frameData.LV = LSpace;
+		frameData.lightDir = lightDir;
+		frameData.exposure = exposure;
+		frameData.lightColor = vec3(1.0f, 1.0f, 0.7f);
+		frameData.saturation = saturation;
+		frameData.cameraPos = eye;
+		uploadFrameData();
+		lodSelector.setView(eye, Projection->topMatrix(), height);
+		reportAnimationViews();
 
 		// ==============================
 		// Second Pass: Render to Screen
@@ -4025,16 +4112,16 @@ public:
 		if (Config::DEBUG_LIGHTING) { // Debugging light view from lights perspective
 			if (Config::DEBUG_GEOM) {
 				DepthProgDebug->bind();
-				glUniformMatrix4fv(DepthProg->getUniform("LP"), 1, GL_FALSE, value_ptr(LO));
-				glUniformMatrix4fv(DepthProg->getUniform("LV"), 1, GL_FALSE, value_ptr(LV));
+				DepthProgDebug->setUniform(UniformId::LP, LO);
+				DepthProgDebug->setUniform(UniformId::LV, LV);
 				drawSceneForShadowMap(DepthProgDebug); // Draw the scene from the lights perspective for debugging
 				DepthProgDebug->unbind();
 			}
 			else { // Draw the depth map texture to a quad for visualization
 				DebugProg->bind();
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, depthMap);
+				GLStateCache::bindTexture(0, depthMap);
 				glUniform1i(DebugProg->getUniform("texBuf"), 0);
+				GLStateCache::bindVertexArray(0); // keep the quad's attribute setup off the last mesh's VAO
 				glEnableVertexAttribArray(0); // Now we actually draw the quad
 				glBindBuffer(GL_ARRAY_BUFFER, quad_vertexbuffer);
 				glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
@@ -4045,20 +4132,8 @@ public:
 		}
 		else { // Render the scene like normal with shadow mapping
 			ShadowProg->bind();
-			// Setup shadow mapping
-			glActiveTexture(GL_TEXTURE10);
-			glBindTexture(GL_TEXTURE_2D, depthMap); // Bind shadow map texture
-			glUniform1i(ShadowProg->getUniform("shadowDepth"), 10); // Set uniform for shadow map
-			// Set light and camera uniforms
-			glUniform3f(ShadowProg->getUniform("lightDir"), lightDir.x, lightDir.y, lightDir.z); // Set light direction
-			glUniform3f(ShadowProg->getUniform("lightColor"), 1.0f, 1.0f, 0.7f);
-			glUniform3fv(ShadowProg->getUniform("cameraPos"), 1, glm::value_ptr(eye));
-			glUniform1f(ShadowProg->getUniform("exposure"), exposure);
-			glUniform1f(ShadowProg->getUniform("saturation"), saturation);
-			setCameraProjectionFromStack(ShadowProg, Projection);
-			setCameraViewFromStack(ShadowProg, View);
-			LSpace = LO * LV;
-			glUniformMatrix4fv(ShadowProg->getUniform("LV"), 1, GL_FALSE, value_ptr(LSpace)); // Set light space matrix
+			// Setup shadow mapping, camera and light data come from the FrameData block
+			GLStateCache::bindTexture(10, depthMap); // Bind shadow map texture
 			drawMainScene(ShadowProg, Model, animTime); // Draw the entire scene with shadows
 			ShadowProg->unbind();
 		}
@@ -4066,8 +4141,6 @@ public:
 		if (Config::PARTICLES && particleProg) {
 			particleProg->bind();
 			// glPointSize(10.0f); // Remove this line, size is now per-particle in shader
-			glUniformMatrix4fv(particleProg->getUniform("P"), 1, GL_FALSE, value_ptr(Projection->topMatrix()));
-			glUniformMatrix4fv(particleProg->getUniform("V"), 1, GL_FALSE, value_ptr(View->topMatrix()));
 			particleAlphaTex->bind(particleProg->getUniform("alphaTexture"));
 			drawParticles(particleSystem, particleProg, Model); // draw particles if full scene render
 			particleAlphaTex->unbind();
@@ -4107,8 +4180,9 @@ public:
 			//cout << "Drawing minimap" << endl;
 			glClear(GL_DEPTH_BUFFER_BIT);
 			glViewport(0, height - 350, 350, 350);
-			SetOrthoMatrix(ShadowProg);
-			SetTopView(ShadowProg); /*MINI MAP*/
+			SetOrthoMatrix();
+			SetTopView(); /*MINI MAP*/
+			uploadFrameData();
 			SetMaterial(ShadowProg, Material::brown);
 			//drawScene(prog2, CULL);
 			/* draws */
@@ -4134,8 +4208,30 @@ public:
 		View->popMatrix();
 
 		// Unbind any VAO or Program that might be lingering (belt-and-suspenders)
-		glBindVertexArray(0);
-		glUseProgram(0);
+		GLStateCache::bindVertexArray(0);
+		GLStateCache::useProgram(0);
+
+		if (Config::DEBUG_GL_STATE && ++glStatsFrames >= 300) {
+			long long issued = GLStateCache::issuedCalls();
+			long long skipped = GLStateCache::skippedCalls();
+			cout << "GL binds over " << glStatsFrames << " frames: " << issued << " issued, " << skipped
+				<< " skipped (" << (100.0 * skipped / std::max(1LL, issued + skipped)) << "% redundant), "
+				<< staticDraws.lastDrawCalls() << " static prop draws (" << staticDraws.lastTriangles()
+				<< " triangles) last flush, mesh arena "
+				<< AssimpMesh::arenaBytesUsed() / 1024 << " KB" << endl;
+			GLStateCache::resetStats();
+			glStatsFrames = 0;
+		}
+
+		if (Config::DEBUG_ANIMATION_LOD && ++animStatsFrames >= 300) {
+			AnimationSystem::Stats a = AnimationSystem::stats();
+			cout << "Animation over " << a.frames << " frames: " << a.evaluations << " full + "
+				<< a.reducedEvaluations << " reduced evaluations, " << a.blends << " blended, " << a.culled
+				<< " culled of " << a.animatorFrames << " animator frames; "
+				<< (a.evaluateMs + a.reducedMs + a.blendMs) << " ms spent, ~" << a.savedMs() << " ms saved" << endl;
+			AnimationSystem::resetStats();
+			animStatsFrames = 0;
+		}
 	}
 
 	void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -4350,7 +4446,6 @@ int main(int argc, char* argv[]) {
 	application->initMapGen();
 	application->initGeom(resourceDir);
 	application->initGround();
-	glGenQueries(1, &application->occlusionQueryID);
 
 	auto lastTime = chrono::high_resolution_clock::now();
 
@@ -0,0 +1,309 @@
+// animbench: headless benchmark of the animation runtime on the rigs in
+// resources/. Each FBX is loaded through Assimp (or its model cache) with no
+// GL context, then N characters play its clips for M frames, every pose
+// written into one palette buffer as AnimationSystem does.
+//
+//   animbench [--characters N] [--frames M] [--blend] [--verbose] [resources directory]
+//
+// Reports per rig the time per evaluated bone, heap allocations per frame and,
+// where Linux perf counters are available, L1D and last level cache misses
+// per frame. --blend crossfades every character to another clip of its rig
+// once a second, which exercises the blended path. --verbose keeps the load
+// logs of Animation.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "Animation.h"
+#include "Animator.h"
+#include "AssetRegistry.h"
+#include "AssimpGLMHelpers.h"
+#include "Config.h"
+
+// Every heap allocation of the process goes through here, so the benchmark
+// can count the ones made while evaluating
+static std::atomic<long long> allocations{ 0 };
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// One hardware counter of the calling thread, reads -1 where perf events are
+// missing or not permitted (see /proc/sys/kernel/perf_event_paranoid)
+class CacheCounter {
+public:
+    CacheCounter(uint32_t type, uint64_t config) {
+#ifdef __linux__
+        perf_event_attr attr = {};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+        (void)type;
+        (void)config;
+#endif
+    }
+    ~CacheCounter() {
+#ifdef __linux__
+        if (fd >= 0) {
+            close(fd);
+        }
+#endif
+    }
+
+    CacheCounter(const CacheCounter&) = delete;
+    CacheCounter& operator=(const CacheCounter&) = delete;
+
+    void start() {
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    long long stop() {
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            long long count = 0;
+            if (read(fd, &count, sizeof(count)) == (ssize_t)sizeof(count)) {
+                return count;
+            }
+        }
+#endif
+        return -1;
+    }
+
+private:
+    int fd = -1;
+};
+
+#ifdef __linux__
+static const uint32_t L1D_MISS_TYPE = PERF_TYPE_HW_CACHE;
+static const uint64_t L1D_MISS_CONFIG = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+static const uint32_t LLC_MISS_TYPE = PERF_TYPE_HARDWARE;
+static const uint64_t LLC_MISS_CONFIG = PERF_COUNT_HW_CACHE_MISSES;
+#else
+static const uint32_t L1D_MISS_TYPE = 0, LLC_MISS_TYPE = 0;
+static const uint64_t L1D_MISS_CONFIG = 0, LLC_MISS_CONFIG = 0;
+#endif
+
+struct Rig {
+    std::string name;
+    std::map<std::string, BoneInfo> boneInfo;
+    int boneCounter = 0;
+    std::vector<std::unique_ptr<Animation>> clips;
+};
+
+// Bone ids and offsets as AssimpModel assigns them, without building meshes
+static void readBoneInfo(const aiScene* scene, Rig& rig) {
+    for (unsigned int m = 0; m < scene->mNumMeshes; ++m) {
+        const aiMesh* mesh = scene->mMeshes[m];
+        for (unsigned int b = 0; b < mesh->mNumBones; ++b) {
+            std::string name = mesh->mBones[b]->mName.C_Str();
+            if (rig.boneInfo.find(name) == rig.boneInfo.end()) {
+                rig.boneInfo[name] = { rig.boneCounter++, AssimpGLMHelpers::ConvertMatrixToGLMFormat(mesh->mBones[b]->mOffsetMatrix) };
+            }
+        }
+    }
+}
+
+static bool loadRig(const std::string& path, Rig& rig) {
+    std::shared_ptr<ImportedScene> imported = AssetRegistry::scene(path);
+    if (!imported->scene()) {
+        return false;
+    }
+    readBoneInfo(imported->scene(), rig);
+    for (unsigned int i = 0; i < imported->animationCount(); ++i) {
+        auto clip = std::make_unique<Animation>(path, rig.boneInfo, rig.boneCounter, (int)i);
+        if (clip->GetDuration() > 0.0f && clip->GetSkeleton().boneSlotCount > 0) {
+            rig.clips.push_back(std::move(clip));
+        }
+    }
+    return !rig.clips.empty();
+}
+
+struct Result {
+    long long bones = 0; // evaluated, summed over every update
+    double seconds = 0.0;
+    long long allocations = 0;
+    long long l1dMisses = -1;
+    long long llcMisses = -1;
+};
+
+static Result run(const Rig& rig, int characters, int frames, bool blend) {
+    const float dt = 1.0f / 60.0f;
+    int stride = 0;
+    for (const auto& clip : rig.clips) {
+        stride = std::max(stride, clip->GetSkeleton().boneSlotCount);
+    }
+
+    // every character on its own clip and phase, so they don't share cache lines of one key
+    std::vector<std::unique_ptr<Animator>> animators;
+    std::vector<int> playing;
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> phase(0.0f, 1.0f);
+    for (int c = 0; c < characters; ++c) {
+        int clip = c % (int)rig.clips.size();
+        animators.push_back(std::make_unique<Animator>(rig.clips[clip].get()));
+        animators.back()->Advance(phase(rng));
+        playing.push_back(clip);
+    }
+    std::vector<glm::mat4> palette((size_t)characters * stride, glm::mat4(1.0f));
+
+    // one untimed frame grows the scratch buffers and the frame arena
+    for (int c = 0; c < characters; ++c) {
+        animators[c]->UpdateAnimation(dt, palette.data() + (size_t)c * stride);
+    }
+
+    CacheCounter l1d(L1D_MISS_TYPE, L1D_MISS_CONFIG);
+    CacheCounter llc(LLC_MISS_TYPE, LLC_MISS_CONFIG);
+    Result result;
+    long long allocationsBefore = allocations.load();
+    l1d.start();
+    llc.start();
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; ++f) {
+        if (blend && rig.clips.size() > 1 && f % 60 == 59) {
+            for (int c = 0; c < characters; ++c) {
+                playing[c] = (playing[c] + 1) % (int)rig.clips.size();
+                animators[c]->CrossFade(rig.clips[playing[c]].get(), 0.25f);
+            }
+        }
+        for (int c = 0; c < characters; ++c) {
+            result.bones += animators[c]->GetPaletteSize();
+            animators[c]->UpdateAnimation(dt, palette.data() + (size_t)c * stride);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    result.l1dMisses = l1d.stop();
+    result.llcMisses = llc.stop();
+    result.allocations = allocations.load() - allocationsBefore;
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int characters = 100;
+    int frames = 600;
+    bool blend = false;
+    bool verbose = false;
+    std::string resourceDir = "../resources";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--characters" && i + 1 < argc) {
+            characters = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--frames" && i + 1 < argc) {
+            frames = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--blend") {
+            blend = true;
+        }
+        else if (arg == "--verbose") {
+            verbose = true;
+        }
+        else if (!arg.empty() && arg[0] != '-') {
+            resourceDir = arg;
+        }
+        else {
+            std::cerr << "usage: animbench [--characters N] [--frames M] [--blend] [--verbose] [resources directory]"
+                << std::endl;
+            return 1;
+        }
+    }
+
+    const char* rigPaths[] = { "CatWizard/CatWizardAnimation2.fbx", "IceElemental/IceElem.fbx", "Vanguard/Vanguard.fbx", "wolf.fbx" };
+    std::vector<std::unique_ptr<Rig>> rigs;
+    for (const char* rigPath : rigPaths) {
+        auto rig = std::make_unique<Rig>();
+        rig->name = rigPath;
+        // Animation logs every bone it reads, keep that out of the table
+        std::streambuf* log = std::cout.rdbuf();
+        if (!verbose) {
+            std::cout.rdbuf(nullptr);
+        }
+        bool loaded = loadRig(resourceDir + "/" + rigPath, *rig);
+        std::cout.rdbuf(log);
+        std::cout.clear();
+        if (!loaded) {
+            std::cerr << rigPath << ": no animations loaded, skipped" << std::endl;
+            continue;
+        }
+        rigs.push_back(std::move(rig));
+    }
+    AssetRegistry::releaseImports();
+    if (rigs.empty()) {
+        std::cerr << "animbench: no rigs found under " << resourceDir << std::endl;
+        return 1;
+    }
+
+    std::cout << "animbench: " << characters << " characters x " << frames << " frames per rig"
+        << (blend ? ", crossfading every second" : "")
+        << " | SoA clips " << (Config::ANIMATION_SOA_CLIPS ? "on" : "off")
+        << ", compression " << (Config::ANIMATION_COMPRESSION ? "on" : "off")
+        << ", resample " << Config::ANIMATION_RESAMPLE_HZ << " Hz" << std::endl;
+    std::cout << std::left << std::setw(36) << "rig" << std::right << std::setw(6) << "clips" << std::setw(7) << "bones"
+        << std::setw(10) << "ns/bone" << std::setw(11) << "us/frame" << std::setw(14) << "allocs/frame"
+        << std::setw(14) << "L1D miss/fr" << std::setw(14) << "LLC miss/fr" << std::endl;
+
+    std::cout << std::fixed;
+    for (const auto& rig : rigs) {
+        Result r = run(*rig, characters, frames, blend);
+        auto perFrame = [&](long long count) {
+            std::ostringstream s;
+            if (count < 0) {
+                s << "n/a";
+            }
+            else {
+                s << std::fixed << std::setprecision(1) << (double)count / frames;
+            }
+            return s.str();
+        };
+        std::cout << std::left << std::setw(36) << rig->name << std::right << std::setw(6) << rig->clips.size()
+            << std::setw(7) << rig->clips.front()->GetSkeleton().boneSlotCount
+            << std::setw(10) << std::setprecision(2) << r.seconds * 1e9 / std::max(r.bones, 1LL)
+            << std::setw(11) << std::setprecision(1) << r.seconds * 1e6 / frames
+            << std::setw(14) << std::setprecision(2) << (double)r.allocations / frames
+            << std::setw(14) << perFrame(r.l1dMisses) << std::setw(14) << perFrame(r.llcMisses) << std::endl;
+    }
+    return 0;
+}
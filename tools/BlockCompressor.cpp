@@ -0,0 +1,281 @@
+#include "BlockCompressor.h"
+#include "Ktx2.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    struct Color {
+        float r, g, b;
+    };
+
+    uint16_t to565(const Color& c) {
+        int r = std::min(31, std::max(0, (int)std::lround(c.r * 31.0f / 255.0f)));
+        int g = std::min(63, std::max(0, (int)std::lround(c.g * 63.0f / 255.0f)));
+        int b = std::min(31, std::max(0, (int)std::lround(c.b * 31.0f / 255.0f)));
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    Color from565(uint16_t c) {
+        int r = (c >> 11) & 31;
+        int g = (c >> 5) & 63;
+        int b = c & 31;
+        return { (float)((r << 3) | (r >> 2)), (float)((g << 2) | (g >> 4)), (float)((b << 3) | (b >> 2)) };
+    }
+
+    float distance2(const Color& a, const Color& b) {
+        float dr = a.r - b.r, dg = a.g - b.g, db = a.b - b.b;
+        return dr * dr + dg * dg + db * db;
+    }
+
+    // 4-color palette of a c0 > c1 block
+    void palette(uint16_t c0, uint16_t c1, Color out[4]) {
+        out[0] = from565(c0);
+        out[1] = from565(c1);
+        out[2] = { (2 * out[0].r + out[1].r) / 3, (2 * out[0].g + out[1].g) / 3, (2 * out[0].b + out[1].b) / 3 };
+        out[3] = { (out[0].r + 2 * out[1].r) / 3, (out[0].g + 2 * out[1].g) / 3, (out[0].b + 2 * out[1].b) / 3 };
+    }
+
+    uint32_t pickIndices(const Color pixels[16], uint16_t c0, uint16_t c1) {
+        Color pal[4];
+        palette(c0, c1, pal);
+        uint32_t indices = 0;
+        for (int i = 0; i < 16; ++i) {
+            int best = 0;
+            float bestDistance = distance2(pixels[i], pal[0]);
+            for (int p = 1; p < 4; ++p) {
+                float d = distance2(pixels[i], pal[p]);
+                if (d < bestDistance) {
+                    bestDistance = d;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+        return indices;
+    }
+
+    // Least squares endpoints for the chosen indices, false when degenerate
+    bool refine(const Color pixels[16], uint32_t indices, Color& end0, Color& end1) {
+        static const float weight0[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        float aa = 0, bb = 0, ab = 0;
+        Color ax = { 0, 0, 0 }, bx = { 0, 0, 0 };
+        for (int i = 0; i < 16; ++i) {
+            float a = weight0[(indices >> (2 * i)) & 3];
+            float b = 1.0f - a;
+            aa += a * a;
+            bb += b * b;
+            ab += a * b;
+            ax = { ax.r + a * pixels[i].r, ax.g + a * pixels[i].g, ax.b + a * pixels[i].b };
+            bx = { bx.r + b * pixels[i].r, bx.g + b * pixels[i].g, bx.b + b * pixels[i].b };
+        }
+        float det = aa * bb - ab * ab;
+        if (std::fabs(det) < 1e-6f) {
+            return false;
+        }
+        float inv = 1.0f / det;
+        end0 = { (ax.r * bb - bx.r * ab) * inv, (ax.g * bb - bx.g * ab) * inv, (ax.b * bb - bx.b * ab) * inv };
+        end1 = { (bx.r * aa - ax.r * ab) * inv, (bx.g * aa - ax.g * ab) * inv, (bx.b * aa - ax.b * ab) * inv };
+        return true;
+    }
+
+    float blockError(const Color pixels[16], uint16_t c0, uint16_t c1, uint32_t indices) {
+        Color pal[4];
+        palette(c0, c1, pal);
+        float error = 0.0f;
+        for (int i = 0; i < 16; ++i) {
+            error += distance2(pixels[i], pal[(indices >> (2 * i)) & 3]);
+        }
+        return error;
+    }
+
+    void writeColorBlock(uint16_t c0, uint16_t c1, uint32_t indices, unsigned char out[8]) {
+        out[0] = (unsigned char)(c0 & 0xFF);
+        out[1] = (unsigned char)(c0 >> 8);
+        out[2] = (unsigned char)(c1 & 0xFF);
+        out[3] = (unsigned char)(c1 >> 8);
+        for (int i = 0; i < 4; ++i) {
+            out[4 + i] = (unsigned char)(indices >> (8 * i));
+        }
+    }
+}
+
+void BlockCompressor::encodeBC1(const unsigned char rgba[64], unsigned char out[8]) {
+    Color pixels[16];
+    Color mean = { 0, 0, 0 };
+    for (int i = 0; i < 16; ++i) {
+        pixels[i] = { (float)rgba[i * 4], (float)rgba[i * 4 + 1], (float)rgba[i * 4 + 2] };
+        mean = { mean.r + pixels[i].r / 16, mean.g + pixels[i].g / 16, mean.b + pixels[i].b / 16 };
+    }
+
+    // principal axis of the block's colors by power iteration
+    float cov[6] = { 0, 0, 0, 0, 0, 0 };
+    for (const Color& p : pixels) {
+        float r = p.r - mean.r, g = p.g - mean.g, b = p.b - mean.b;
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+    Color axis = { 1, 1, 1 };
+    for (int i = 0; i < 8; ++i) {
+        Color next = { cov[0] * axis.r + cov[1] * axis.g + cov[2] * axis.b,
+                       cov[1] * axis.r + cov[3] * axis.g + cov[4] * axis.b,
+                       cov[2] * axis.r + cov[4] * axis.g + cov[5] * axis.b };
+        float length = std::sqrt(next.r * next.r + next.g * next.g + next.b * next.b);
+        if (length < 1e-6f) {
+            break; // flat block
+        }
+        axis = { next.r / length, next.g / length, next.b / length };
+    }
+
+    float tMin = 0.0f, tMax = 0.0f;
+    for (const Color& p : pixels) {
+        float t = (p.r - mean.r) * axis.r + (p.g - mean.g) * axis.g + (p.b - mean.b) * axis.b;
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+    // pull the endpoints in a little, the extremes are rarely worth hitting exactly
+    float inset = (tMax - tMin) / 16.0f;
+    tMin += inset;
+    tMax -= inset;
+    Color end0 = { mean.r + axis.r * tMax, mean.g + axis.g * tMax, mean.b + axis.b * tMax };
+    Color end1 = { mean.r + axis.r * tMin, mean.g + axis.g * tMin, mean.b + axis.b * tMin };
+
+    uint16_t c0 = to565(end0), c1 = to565(end1);
+    if (c0 == c1) {
+        writeColorBlock(c0, c1, 0, out);
+        return;
+    }
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+    uint32_t indices = pickIndices(pixels, c0, c1);
+
+    // one refinement pass, kept only if it actually helps
+    Color refined0, refined1;
+    if (refine(pixels, indices, refined0, refined1)) {
+        uint16_t r0 = to565(refined0), r1 = to565(refined1);
+        if (r0 != r1) {
+            if (r0 < r1) {
+                std::swap(r0, r1);
+            }
+            uint32_t refinedIndices = pickIndices(pixels, r0, r1);
+            if (blockError(pixels, r0, r1, refinedIndices) < blockError(pixels, c0, c1, indices)) {
+                c0 = r0;
+                c1 = r1;
+                indices = refinedIndices;
+            }
+        }
+    }
+    writeColorBlock(c0, c1, indices, out);
+}
+
+void BlockCompressor::encodeBC4(const unsigned char values[16], unsigned char out[8]) {
+    unsigned char lo = 255, hi = 0;
+    for (int i = 0; i < 16; ++i) {
+        lo = std::min(lo, values[i]);
+        hi = std::max(hi, values[i]);
+    }
+    out[0] = hi;
+    out[1] = lo;
+
+    // hi > lo selects the 8 level mode: hi, lo, then 6 steps between them
+    int levels[8] = { hi, lo };
+    for (int i = 2; i < 8; ++i) {
+        levels[i] = ((8 - i) * hi + (i - 1) * lo + 3) / 7;
+    }
+
+    uint64_t indices = 0;
+    if (hi != lo) {
+        for (int i = 0; i < 16; ++i) {
+            int best = 0;
+            int bestDistance = 256;
+            for (int l = 0; l < 8; ++l) {
+                int d = std::abs(values[i] - levels[l]);
+                if (d < bestDistance) {
+                    bestDistance = d;
+                    best = l;
+                }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; ++i) {
+        out[2 + i] = (unsigned char)(indices >> (8 * i));
+    }
+}
+
+void BlockCompressor::encodeBC3(const unsigned char rgba[64], unsigned char out[16]) {
+    unsigned char alpha[16];
+    for (int i = 0; i < 16; ++i) {
+        alpha[i] = rgba[i * 4 + 3];
+    }
+    encodeBC4(alpha, out);
+    encodeBC1(rgba, out + 8);
+}
+
+void BlockCompressor::decodeBC1(const unsigned char in[8], unsigned char rgba[64]) {
+    uint16_t c0 = (uint16_t)(in[0] | (in[1] << 8));
+    uint16_t c1 = (uint16_t)(in[2] | (in[3] << 8));
+    uint32_t indices = (uint32_t)in[4] | ((uint32_t)in[5] << 8) | ((uint32_t)in[6] << 16) | ((uint32_t)in[7] << 24);
+    Color pal[4];
+    palette(c0, c1, pal);
+    for (int i = 0; i < 16; ++i) {
+        const Color& c = pal[(indices >> (2 * i)) & 3];
+        rgba[i * 4] = (unsigned char)std::lround(c.r);
+        rgba[i * 4 + 1] = (unsigned char)std::lround(c.g);
+        rgba[i * 4 + 2] = (unsigned char)std::lround(c.b);
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+std::vector<unsigned char> BlockCompressor::compress(const unsigned char* rgba, int width, int height, uint32_t vkFormat) {
+    size_t blockSize = Ktx2::blockBytes(vkFormat);
+    int blocksX = (width + 3) / 4;
+    int blocksY = (height + 3) / 4;
+    std::vector<unsigned char> out((size_t)blocksX * blocksY * blockSize);
+
+    unsigned char block[64];
+    unsigned char red[16];
+    for (int by = 0; by < blocksY; ++by) {
+        for (int bx = 0; bx < blocksX; ++bx) {
+            for (int y = 0; y < 4; ++y) {
+                int sy = std::min(by * 4 + y, height - 1);
+                for (int x = 0; x < 4; ++x) {
+                    int sx = std::min(bx * 4 + x, width - 1);
+                    std::memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+                    red[y * 4 + x] = block[(y * 4 + x) * 4];
+                }
+            }
+            unsigned char* dst = out.data() + ((size_t)by * blocksX + bx) * blockSize;
+            if (vkFormat == Ktx2::BC4_UNORM) {
+                encodeBC4(red, dst);
+            }
+            else if (blockSize == 16) {
+                encodeBC3(block, dst);
+            }
+            else {
+                encodeBC1(block, dst);
+            }
+        }
+    }
+    return out;
+}
+
+std::vector<unsigned char> BlockCompressor::downsample(const unsigned char* rgba, int width, int height) {
+    int w = std::max(1, width / 2);
+    int h = std::max(1, height / 2);
+    std::vector<unsigned char> out((size_t)w * h * 4);
+    for (int y = 0; y < h; ++y) {
+        int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+        for (int x = 0; x < w; ++x) {
+            int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            for (int c = 0; c < 4; ++c) {
+                int sum = rgba[((size_t)y0 * width + x0) * 4 + c] + rgba[((size_t)y0 * width + x1) * 4 + c]
+                        + rgba[((size_t)y1 * width + x0) * 4 + c] + rgba[((size_t)y1 * width + x1) * 4 + c];
+                out[((size_t)y * w + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return out;
+}
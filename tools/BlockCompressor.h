@@ -0,0 +1,25 @@
+#ifndef BLOCK_COMPRESSOR_H
+#define BLOCK_COMPRESSOR_H
+
+#include <cstdint>
+#include <vector>
+
+// CPU encoders for the BCn formats texconv writes. Quality is roughly what
+// the old DXT compressors shipped: principal axis endpoints with one least
+// squares refinement for color, min/max endpoints for the 8 level channels.
+namespace BlockCompressor {
+    // One 4x4 block, pixels in rows, RGBA8
+    void encodeBC1(const unsigned char rgba[64], unsigned char out[8]);
+    void encodeBC3(const unsigned char rgba[64], unsigned char out[16]);
+    // Single channel block (BC4, and the alpha half of BC3)
+    void encodeBC4(const unsigned char values[16], unsigned char out[8]);
+
+    void decodeBC1(const unsigned char in[8], unsigned char rgba[64]);
+
+    // Whole level, edge blocks repeat the last row/column. vkFormat is a Ktx2::Format.
+    std::vector<unsigned char> compress(const unsigned char* rgba, int width, int height, uint32_t vkFormat);
+    // Next mip level, 2x2 box filter
+    std::vector<unsigned char> downsample(const unsigned char* rgba, int width, int height);
+}
+
+#endif // BLOCK_COMPRESSOR_H
@@ -0,0 +1,157 @@
+// texconv: offline converter from the source images in resources/ to block
+// compressed KTX2 files (<image>.ktx2) with a precomputed mip chain. The game
+// loads those instead of the source image when they are up to date, see
+// TextureCache::decode.
+//
+//   texconv [--force] <image or directory>...
+//
+// Directories are walked recursively. Opaque images become BC1, images with
+// alpha BC3, single channel images BC4.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "BlockCompressor.h"
+#include "Ktx2.h"
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+
+static bool isSourceImage(const fs::path& path) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".bmp" || ext == ".tga";
+}
+
+struct Totals {
+    std::mutex mutex;
+    size_t converted = 0;
+    size_t skipped = 0;
+    size_t failed = 0;
+    size_t bytesBefore = 0; // RGBA8 with mips, what the runtime path uploads
+    size_t bytesAfter = 0;
+};
+
+static void convert(const std::string& source, Totals& totals) {
+    int width, height, channels;
+    unsigned char* pixels = stbi_load(source.c_str(), &width, &height, &channels, 4);
+    if (!pixels) {
+        std::lock_guard<std::mutex> lock(totals.mutex);
+        std::cerr << source << ": " << stbi_failure_reason() << std::endl;
+        totals.failed++;
+        return;
+    }
+
+    bool hasAlpha = false;
+    if (channels == 2 || channels == 4) {
+        for (size_t i = 0; i < (size_t)width * height && !hasAlpha; ++i) {
+            hasAlpha = pixels[i * 4 + 3] != 255;
+        }
+    }
+
+    Ktx2::Image image;
+    image.vkFormat = channels == 1 ? Ktx2::BC4_UNORM : hasAlpha ? Ktx2::BC3_UNORM : Ktx2::BC1_RGB_UNORM;
+    image.width = width;
+    image.height = height;
+    image.flippedY = true; // same row order as the runtime's stb_image loads
+
+    std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * 4);
+    stbi_image_free(pixels);
+
+    size_t before = 0;
+    int w = width, h = height;
+    while (true) {
+        std::vector<unsigned char> blocks = BlockCompressor::compress(level.data(), w, h, image.vkFormat);
+        Ktx2::Level l;
+        l.offset = image.data.size();
+        l.size = blocks.size();
+        image.data.insert(image.data.end(), blocks.begin(), blocks.end());
+        image.levels.push_back(l);
+        before += (size_t)w * h * 4;
+
+        if (w == 1 && h == 1) {
+            break;
+        }
+        level = BlockCompressor::downsample(level.data(), w, h);
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+    }
+
+    bool written = Ktx2::write(Ktx2::pathFor(source), image);
+
+    std::lock_guard<std::mutex> lock(totals.mutex);
+    if (!written) {
+        std::cerr << source << ": could not write " << Ktx2::pathFor(source) << std::endl;
+        totals.failed++;
+        return;
+    }
+    const char* name = image.vkFormat == Ktx2::BC4_UNORM ? "BC4" : image.vkFormat == Ktx2::BC3_UNORM ? "BC3" : "BC1";
+    std::cout << source << ": " << width << "x" << height << " " << name << ", " << image.levels.size() << " levels, "
+        << before / 1024 << " KB -> " << image.data.size() / 1024 << " KB" << std::endl;
+    totals.converted++;
+    totals.bytesBefore += before;
+    totals.bytesAfter += image.data.size();
+}
+
+int main(int argc, char** argv) {
+    bool force = false;
+    std::vector<std::string> sources;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--force") {
+            force = true;
+            continue;
+        }
+        std::error_code ec;
+        if (fs::is_directory(arg, ec)) {
+            for (const auto& entry : fs::recursive_directory_iterator(arg, ec)) {
+                if (entry.is_regular_file() && isSourceImage(entry.path())) {
+                    sources.push_back(entry.path().generic_string());
+                }
+            }
+        }
+        else if (fs::is_regular_file(arg, ec)) {
+            sources.push_back(arg);
+        }
+        else {
+            std::cerr << arg << ": no such file or directory" << std::endl;
+        }
+    }
+    if (sources.empty()) {
+        std::cerr << "usage: texconv [--force] <image or directory>..." << std::endl;
+        return 1;
+    }
+
+    // same orientation the game loads images with, see Texture::init
+    stbi_set_flip_vertically_on_load(true);
+
+    Totals totals;
+    {
+        ThreadPool pool;
+        for (const auto& source : sources) {
+            if (!force && Ktx2::upToDate(source)) {
+                totals.skipped++;
+                continue;
+            }
+            pool.submit([&totals, source] { convert(source, totals); });
+        }
+    } // joins the workers
+
+    std::cout << "texconv: " << totals.converted << " converted, " << totals.skipped << " up to date, "
+        << totals.failed << " failed";
+    if (totals.bytesAfter > 0) {
+        std::cout << ", " << totals.bytesBefore / (1024 * 1024) << " MB -> " << totals.bytesAfter / (1024 * 1024)
+            << " MB (" << (double)totals.bytesBefore / totals.bytesAfter << "x)";
+    }
+    std::cout << std::endl;
+    return totals.failed ? 1 : 0;
+}